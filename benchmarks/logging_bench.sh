@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# Wall-clock benchmark of the console logging: runs the [Example-10-Large] configuration with Cmdenv
+#	- "all": every log statement printed (express mode off, log level trace), as with the former std::cout calls
+#	- "filtered": the default run, log statements filtered at runtime (express mode, cmdenv-log-level = info)
+#	- "compiled-out": with a second build whose debug and trace statements are compiled out
+#	  (CFLAGS += -DCOMPILETIME_LOGLEVEL=omnetpp::LOGLEVEL_INFO), filtered at runtime like the default run
+# and prints the best wall-clock time of each over the repetitions. The console output goes to a file (LOG_OUT,
+# /dev/null by default), so the terminal does not dominate the measurement.
+#
+# Usage (from the repository root):
+#	benchmarks/logging_bench.sh <simulation> [<simulation built with COMPILETIME_LOGLEVEL=LOGLEVEL_INFO>] [repetitions]
+#
+set -e
+
+if [ $# -lt 1 ]; then
+	echo "Usage: $0 <simulation> [<simulation with debug logs compiled out>] [repetitions]" >&2
+	exit 1
+fi
+
+SIM=$1
+SIM_INFO=${2:-}
+REPETITIONS=${3:-3}
+CONFIG=${CONFIG:-Example-10-Large}
+LOG_OUT=${LOG_OUT:-/dev/null}
+
+# Best wall-clock time (s) of a run over the repetitions
+run() {
+	best=""
+	i=0
+	while [ $i -lt "$REPETITIONS" ]; do
+		start=$(date +%s.%N)
+		if ! "$@" -u Cmdenv -c "$CONFIG" -r 0 -n network omnetpp.ini > "$LOG_OUT" 2>&1; then
+			echo "$1 failed (output in $LOG_OUT)" >&2
+			exit 1
+		fi
+		end=$(date +%s.%N)
+		best=$(echo "$start $end $best" | awk '{ t = $2 - $1; if ($3 == "" || t < $3) print t; else print $3 }')
+		i=$((i + 1))
+	done
+	echo "$best"
+}
+
+ALL=$(run "$SIM" --cmdenv-express-mode=false --cmdenv-log-level=trace)
+FILTERED=$(run "$SIM")
+printf "%-14s %10s\n" "logging" "wall (s)"
+printf "%-14s %10.3f\n" "all" "$ALL"
+printf "%-14s %10.3f\n" "filtered" "$FILTERED"
+if [ -n "$SIM_INFO" ]; then
+	COMPILED_OUT=$(run "$SIM_INFO")
+	printf "%-14s %10.3f\n" "compiled-out" "$COMPILED_OUT"
+fi
+echo "$CONFIG, best of $REPETITIONS run(s)"
@@ -0,0 +1,163 @@
+/*
+* Benchmark of the payload encodings (modules/Libraries/PayloadCodec.h):
+* compression ratio, encode and decode throughput on the value distributions of the simulation.
+*
+* Build and run (from the repository root):
+*	g++ -O2 -std=c++17 -I modules/Libraries benchmarks/payload_codec_bench.cpp -o payload_codec_bench
+*	./payload_codec_bench [input CSV file] [column]
+*/
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "PayloadCodec.h"
+
+struct Distribution {
+	std::string name;
+	std::vector<std::vector<int>> arrays; // Encoded one at a time, like message payloads
+};
+
+// Arrays of random size, as generated by the Leader for each worker (or chunk)
+static Distribution uniform(const std::string& name, int arrays, int size, int low, int high, std::mt19937& rng) {
+	Distribution distribution{name, {}};
+	std::uniform_int_distribution<int> value(low, high);
+	for(int a = 0; a < arrays; a++) {
+		std::vector<int> array(size);
+		for(int& v : array) {
+			v = value(rng);
+		}
+		distribution.arrays.push_back(array);
+	}
+	return distribution;
+}
+
+// Values after a map (e.g. "mul 4, add 10"), as in partial result vectors
+static Distribution mapped(const Distribution& input, int factor, int offset) {
+	Distribution distribution{input.name + " after mul " + std::to_string(factor) + ", add " + std::to_string(offset), input.arrays};
+	for(auto& array : distribution.arrays) {
+		for(int& v : array) {
+			v = v * factor + offset;
+		}
+	}
+	return distribution;
+}
+
+static Distribution sorted(const Distribution& input) {
+	Distribution distribution{input.name + ", sorted", input.arrays};
+	for(auto& array : distribution.arrays) {
+		std::sort(array.begin(), array.end());
+	}
+	return distribution;
+}
+
+// Values of a CSV column, split in arrays of the given size (input chunks)
+static Distribution csvColumn(const std::string& fileName, int column, size_t size) {
+	Distribution distribution{fileName + " column " + std::to_string(column), {}};
+	std::ifstream file(fileName);
+	std::string line;
+	std::vector<int> array;
+	while(std::getline(file, line)) {
+		std::stringstream lineStream(line);
+		std::string field;
+		for(int i = 0; i <= column && std::getline(lineStream, field, ','); i++);
+		try {
+			array.push_back(std::stoi(field));
+		} catch(const std::exception&) {
+			continue; // Header
+		}
+		if(array.size() == size) {
+			distribution.arrays.push_back(array);
+			array.clear();
+		}
+	}
+	if(!array.empty()) {
+		distribution.arrays.push_back(array);
+	}
+	return distribution;
+}
+
+static void run(const Distribution& distribution) {
+	size_t values = 0;
+	for(const auto& array : distribution.arrays) {
+		values += array.size();
+	}
+	if(values == 0) {
+		std::cout << distribution.name << ": no values\n";
+		return;
+	}
+
+	std::cout << "\n" << distribution.name << " (" << distribution.arrays.size() << " arrays, " << values << " values)\n";
+	std::cout << std::left << std::setw(20) << "  scheme" << std::right << std::setw(12) << "bytes/value" << std::setw(10) << "ratio"
+	          << std::setw(14) << "encode MB/s" << std::setw(14) << "decode MB/s" << "  round trip\n";
+
+	const PayloadCodec::Scheme schemes[] = {PayloadCodec::RAW, PayloadCodec::DELTA_VARINT, PayloadCodec::FRAME_OF_REFERENCE};
+	const char* names[] = {"raw", "delta varint", "frame of reference"};
+	const int repetitions = std::max<size_t>(1, 2000000 / values);
+
+	for(int s = 0; s < 3; s++) {
+		std::vector<std::vector<uint8_t>> encoded(distribution.arrays.size());
+		size_t bytes = 0;
+
+		auto start = std::chrono::steady_clock::now();
+		for(int r = 0; r < repetitions; r++) {
+			for(size_t a = 0; a < distribution.arrays.size(); a++) {
+				encoded[a] = PayloadCodec::encode(distribution.arrays[a], schemes[s]);
+			}
+		}
+		double encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		bool roundTrip = true;
+		start = std::chrono::steady_clock::now();
+		for(int r = 0; r < repetitions; r++) {
+			for(size_t a = 0; a < encoded.size(); a++) {
+				std::vector<int> decoded = PayloadCodec::decode(encoded[a]);
+				roundTrip = roundTrip && (decoded == distribution.arrays[a]);
+			}
+		}
+		double decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		for(size_t a = 0; a < encoded.size(); a++) {
+			bytes += encoded[a].size();
+			roundTrip = roundTrip && (encoded[a].size() == PayloadCodec::encodedSize(distribution.arrays[a].data(), distribution.arrays[a].size(), schemes[s]));
+		}
+
+		double inputMB = 4.0 * values * repetitions / 1e6;
+		std::cout << "  " << std::left << std::setw(18) << names[s] << std::right << std::fixed << std::setprecision(3)
+		          << std::setw(12) << (double)bytes / values << std::setw(10) << 4.0 * values / bytes
+		          << std::setprecision(1) << std::setw(14) << inputMB / encodeSeconds << std::setw(14) << inputMB / decodeSeconds
+		          << "  " << (roundTrip ? "ok" : "FAILED") << "\n";
+	}
+
+	// Size chosen by the "auto" byte-length accounting
+	size_t autoBytes = 0;
+	for(const auto& array : distribution.arrays) {
+		autoBytes += PayloadCodec::payloadSize(array.data(), array.size(), ENCODING_AUTO);
+	}
+	std::cout << "  " << std::left << std::setw(18) << "auto" << std::right << std::setprecision(3)
+	          << std::setw(12) << (double)autoBytes / values << std::setw(10) << 4.0 * values / autoBytes << "\n";
+}
+
+int main(int argc, char** argv) {
+	std::mt19937 rng(42);
+
+	// The Leader's random job: 50-60 values in [1, 100] per worker, sent in chunks of 20 (setupChunkSize)
+	Distribution chunks = uniform("Random job, chunks of 20 values in [1, 100]", 5000, 20, 1, 100, rng);
+	Distribution workers = uniform("Random job, 55 values in [1, 100] per worker", 2000, 55, 1, 100, rng);
+	run(chunks);
+	run(workers);
+	run(mapped(workers, 4, 10));
+	run(sorted(mapped(workers, 4, 10)));
+	run(uniform("Full int range (worst case)", 2000, 55, INT32_MIN, INT32_MAX, rng));
+
+	// Submitted job input, as streamed to the workers
+	std::string fileName = argc > 1 ? argv[1] : "jobs/input_1.csv";
+	int column = argc > 2 ? std::stoi(argv[2]) : 1;
+	run(csvColumn(fileName, column, 20));
+	return 0;
+}
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""
+Throughput benchmark of the simulator itself, separate from the simulated completion time of the jobs: runs the
+[Bench-*] configurations of omnetpp.ini (MapReduceNet, small/medium/large, with and without failures) headless with
+Cmdenv, and reports for each one the events executed, the wall-clock time, the events per second, the wall-clock time
+per simulated second and the peak resident memory of the simulation process.
+
+    python3 benchmarks/sim_bench.py <simulation> [--scenarios Bench-Small,...] [--repetitions 3]
+                                    [--csv bench.csv] [--baseline previous.csv] [--tolerance 0.1]
+
+Each scenario runs --repetitions times and the fastest run is kept (memory: the largest peak). The table printed,
+and the --csv file, have a fixed set of columns in a fixed order, so the results of two builds can be diffed; with
+--baseline (a --csv file of an earlier build), scenarios whose events per second dropped, or whose peak memory grew,
+by more than --tolerance are reported as regressions and the exit status is 1.
+Run it from the repository root.
+
+Limitation: only checked against a stand-in executable printing a Cmdenv-like last line, not against a real build
+of the simulation; the end-of-simulation parsing (EVENT_RE, TIME_RE) and the Cmdenv options are untested with OMNeT++.
+"""
+
+import argparse
+import csv
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+SCENARIOS = ["Bench-Small", "Bench-Small-Fail", "Bench-Medium", "Bench-Medium-Fail", "Bench-Large", "Bench-Large-Fail"]
+COLUMNS = ["scenario", "events", "simTime", "wallTime", "eventsPerSec", "wallPerSimSec", "peakRssKB"]
+
+# Last line of a Cmdenv run, e.g. "<!> No more events, simulation completed -- at t=12.5s, event #48213"
+# (older versions: "No more events -- simulation ended at event #48213, t=12.5.")
+EVENT_RE = re.compile(r"event #(\d+)", re.IGNORECASE)
+TIME_RE = re.compile(r"\bt=([0-9.eE+-]+)")
+
+
+def run_once(simulation, scenario, extra):
+    """Runs a scenario: returns (events, simulated time (s), wall-clock time (s), peak RSS (KB))."""
+    command = [simulation, "-u", "Cmdenv", "-c", scenario, "-r", "0", "-n", "network",
+               "--cmdenv-express-mode=true", "--cmdenv-performance-display=false"] + extra + ["omnetpp.ini"]
+    with tempfile.TemporaryFile(mode="w+") as output:
+        start = time.perf_counter()
+        process = subprocess.Popen(command, stdout=output, stderr=subprocess.STDOUT)
+        _, status, usage = os.wait4(process.pid, 0)
+        wall = time.perf_counter() - start
+        process.returncode = os.waitstatus_to_exitcode(status)
+        output.seek(0)
+        text = output.read()
+    if process.returncode != 0:
+        raise SystemExit("%s failed (exit status %d):\n%s" % (scenario, process.returncode, text[-2000:]))
+
+    events = sim_time = None
+    for line in text.splitlines():
+        if "<!>" in line or "simulation ended" in line:
+            event_match = EVENT_RE.findall(line)
+            time_match = TIME_RE.findall(line)
+            if event_match:
+                events = int(event_match[-1])
+            if time_match:
+                sim_time = float(time_match[-1])
+    if events is None or sim_time is None:
+        raise SystemExit("%s: no end of simulation line in the output of Cmdenv" % scenario)
+    return events, sim_time, wall, usage.ru_maxrss
+
+
+def measure(simulation, scenario, repetitions, extra):
+    """Returns the row of a scenario: its fastest run, with the largest peak memory."""
+    runs = [run_once(simulation, scenario, extra) for _ in range(repetitions)]
+    events, sim_time, wall, _ = min(runs, key=lambda run: run[2])
+    return {
+        "scenario": scenario,
+        "events": events,
+        "simTime": "%.6f" % sim_time,
+        "wallTime": "%.3f" % wall,
+        "eventsPerSec": "%.0f" % (events / wall if wall > 0 else 0),
+        "wallPerSimSec": "%.6f" % (wall / sim_time if sim_time > 0 else 0),
+        "peakRssKB": max(run[3] for run in runs),
+    }
+
+
+def regressions(rows, baseline_path, tolerance):
+    """Returns the regressions of the rows from the baseline: events per second or peak memory beyond tolerance."""
+    with open(baseline_path, newline="") as file:
+        baseline = {row["scenario"]: row for row in csv.DictReader(file)}
+    found = []
+    for row in rows:
+        previous = baseline.get(row["scenario"])
+        if previous is None:
+            continue
+        if float(row["eventsPerSec"]) < float(previous["eventsPerSec"]) * (1 - tolerance):
+            found.append("%s: %s events/s, was %s" % (row["scenario"], row["eventsPerSec"], previous["eventsPerSec"]))
+        if float(row["peakRssKB"]) > float(previous["peakRssKB"]) * (1 + tolerance):
+            found.append("%s: peak RSS %s KB, was %s" % (row["scenario"], row["peakRssKB"], previous["peakRssKB"]))
+    return found
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Throughput benchmark of the simulator (Cmdenv)")
+    parser.add_argument("simulation", help="simulation executable")
+    parser.add_argument("--scenarios", default=",".join(SCENARIOS), help="configurations to run, comma-separated")
+    parser.add_argument("--repetitions", type=int, default=3, help="runs of each scenario (the fastest is kept)")
+    parser.add_argument("--csv", help="write the results to this file")
+    parser.add_argument("--baseline", help="results of an earlier build (--csv file) to compare with")
+    parser.add_argument("--tolerance", type=float, default=0.1, help="relative change reported as a regression")
+    parser.add_argument("extra", nargs="*", help="further options of the simulation, after --")
+    args = parser.parse_args()
+
+    rows = []
+    print("".join("%-18s" % column if i == 0 else "%14s" % column for i, column in enumerate(COLUMNS)))
+    for scenario in args.scenarios.split(","):
+        row = measure(args.simulation, scenario.strip(), args.repetitions, args.extra)
+        rows.append(row)
+        print("".join("%-18s" % row[column] if i == 0 else "%14s" % row[column] for i, column in enumerate(COLUMNS)))
+        sys.stdout.flush()
+
+    if args.csv:
+        with open(args.csv, "w", newline="") as file:
+            writer = csv.DictWriter(file, fieldnames=COLUMNS)
+            writer.writeheader()
+            writer.writerows(rows)
+
+    if args.baseline:
+        found = regressions(rows, args.baseline, args.tolerance)
+        for regression in found:
+            print("REGRESSION " + regression)
+        if found:
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,7 +1,10 @@
+#pragma once
+
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <omnetpp.h>
 
 class BatchLoader {
 private:
@@ -9,6 +12,7 @@ private:
 	std::string fileProgressName;
 	std::streampos filePosition;
 	int batchSize;
+	int batchesLoaded; // Number of batches read so far, used as batch index
 	bool finished;
 
 	void loadProgress() {
@@ -21,6 +25,11 @@ private:
 				// Casting is needed due to compiler restrictions
 				filePosition = static_cast<std::streampos>(tmp);
 			}
+			int batches;
+			progressFile >> batches;
+			if(!progressFile.fail()){ // Batch counter (missing in older progress files)
+				batchesLoaded = batches;
+			}
 			progressFile.close();
 		}
 	}
@@ -36,24 +45,24 @@ private:
 		return value;
 	}
 public:
-	BatchLoader() : fileName(""), fileProgressName(""), batchSize(0), filePosition(0) {
+	BatchLoader() : fileName(""), fileProgressName(""), batchSize(0), filePosition(0), batchesLoaded(0) {
 	}
 
 	BatchLoader(const std::string& fileName, const std::string& fileProgressName, int batchSize) 
-	: fileName(fileName), fileProgressName(fileProgressName), batchSize(batchSize), filePosition(0) {
+	: fileName(fileName), fileProgressName(fileProgressName), batchSize(batchSize), filePosition(0), batchesLoaded(0) {
 		loadProgress(); // Load progress previous to crash
 	}
 
 	std::vector<int> loadBatch() {
 		std::ifstream file(fileName, std::ios::binary);
 		if(!file.is_open()){
-			std::cerr << "Failed to open file: " << fileName << "\n";
+			EV_ERROR_C("BatchLoader") << "Failed to open file: " << fileName << "\n";
 			return {};
 		}
 		file.seekg(filePosition); // Move to the last processed batch
 
 		if (!file) {
-		    std::cerr << "Failed to seek to position: " << filePosition << "\n";
+		    EV_ERROR_C("BatchLoader") << "Failed to seek to position: " << filePosition << "\n";
 		    return {};
 		}
 
@@ -65,24 +74,55 @@ public:
 			// Extract and store the value part of the key-value pair
 			int value = extractValue(line);
 			batchValues.push_back(value);
-			std::cout << value << " ";
+			EV_TRACE_C("BatchLoader") << value << " ";
 			linesRead++;
 		}
-		std::cout << "\n";
+		EV_TRACE_C("BatchLoader") << "\n";
 
+		// tellg() fails once EOF is reached, so keep the position of the end of the file
+		if(file.eof()) {
+			file.clear();
+			file.seekg(0, std::ios::end);
+		}
 		filePosition = file.tellg();
 
+		if(!batchValues.empty()) {
+			batchesLoaded++;
+		}
+
 		file.close();
 		return batchValues;
 	}
 
+	/*
+	* Skips the specified number of batches without returning their values.
+	* Used to position a loader over another worker's input (speculative execution).
+	*/
+	void skipBatches(int numBatches) {
+		for(int i = 0; i < numBatches; i++) {
+			if(loadBatch().empty()) {
+				return;
+			}
+		}
+	}
+
+	// Returns the number of batches read from the file so far
+	int getBatchesLoaded() const {
+		return batchesLoaded;
+	}
+
+	// Returns the position in the file of the next batch
+	std::streampos getFilePosition() const {
+		return filePosition;
+	}
+
 	void saveProgress() {
 		// Load Worker's progress file
 		std::ofstream progressFile(fileProgressName);
 		if(progressFile.is_open()){
 			// Update saved position
 			long long tmp = static_cast<long long>(filePosition);
-			progressFile << tmp;
+			progressFile << tmp << ' ' << batchesLoaded;
 			progressFile.close();
 		}
 	}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <map>
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <utility>
+#include <stdexcept>
+#include <algorithm>
+
+// Simulated time of an operation kind: a fixed part per invocation and a part per item it elaborates
+struct OperationCost {
+	double fixed = 0; // s per invocation (per step of a batch, per reduce, per batch loaded, ...)
+	double perItem = 0; // s per item (tuple)
+	double cv = 0; // Coefficient of variation of the sampled time (0: deterministic)
+	double speed = 1; // Relative speed of the node on this kind (0.5 = two times slower)
+};
+
+/*
+* Cost model of the operations of a worker, by kind ("map", "filter", "changekey", "reduce", "load", ...):
+* an invocation on n items takes (fixed + n * perItem) / speed on average, log-normally distributed around it.
+* The fixed part is what batching amortizes, the per-item part what fusion and vectorization reduce.
+*/
+class CostModel {
+private:
+	std::map<std::string, OperationCost> costs;
+
+public:
+	void set(const std::string& kind, double fixed, double perItem, double cv) {
+		OperationCost& cost = costs[kind];
+		cost.fixed = fixed;
+		cost.perItem = perItem;
+		cost.cv = cv;
+	}
+
+	// Multiplies the speed of the node on a kind ("*": every kind)
+	void scaleSpeed(const std::string& kind, double factor) {
+		if(kind == "*") {
+			for(auto& entry : costs) {
+				entry.second.speed *= factor;
+			}
+			return;
+		}
+		costs[kind].speed *= factor;
+	}
+
+	const OperationCost& get(const std::string& kind) const {
+		static const OperationCost none;
+		auto it = costs.find(kind);
+		return it != costs.end() ? it->second : none;
+	}
+
+	/*
+	* Returns the mean time of an invocation (s).
+	*
+	* Parameters:
+	*	- kind: kind of the operation
+	*	- items: items elaborated by the invocation
+	*	- fixed: whether the fixed part is charged (false: the invocation continues one already charged)
+	*/
+	double mean(const std::string& kind, long items, bool fixed = true) const {
+		const OperationCost& cost = get(kind);
+		return ((fixed ? cost.fixed : 0) + items * cost.perItem) / cost.speed;
+	}
+
+	// Mean time per item of a kind (s), with the fixed part spread over the items of a batch
+	double perItem(const std::string& kind, int batchSize) const {
+		return mean(kind, batchSize) / std::max(batchSize, 1);
+	}
+
+	/*
+	* Returns the (mu, sigma) parameters of the log-normal distribution of the specified mean and coefficient
+	* of variation: they are those of the underlying normal distribution, not the mean and stddev of the samples.
+	*/
+	static std::pair<double, double> lognormalParams(double mean, double cv) {
+		double sigma = std::sqrt(std::log(cv * cv + 1));
+		double mu = std::log(mean) - sigma * sigma / 2;
+		return std::make_pair(mu, sigma);
+	}
+
+	/*
+	* Parses the speed factors of a node by kind, e.g. "map:2, filter:2, load:0.5", into the model.
+	* Throws std::invalid_argument if an entry is malformed.
+	*/
+	void parseSpeeds(const std::string& speeds) {
+		std::istringstream entries(speeds);
+		std::string entry;
+		while(std::getline(entries, entry, ',')) {
+			size_t first = entry.find_first_not_of(" \t");
+			if(first == std::string::npos) {
+				continue;
+			}
+			size_t colon = entry.find(':');
+			if(colon == std::string::npos) {
+				throw std::invalid_argument("Speed factor without kind: \"" + entry + "\"");
+			}
+			std::string kind = entry.substr(first, colon - first);
+			kind.erase(kind.find_last_not_of(" \t") + 1);
+			double factor;
+			try {
+				factor = std::stod(entry.substr(colon + 1));
+			} catch(const std::exception&) {
+				throw std::invalid_argument("Invalid speed factor: \"" + entry + "\"");
+			}
+			if(kind.empty() || !(factor > 0)) {
+				throw std::invalid_argument("Invalid speed factor: \"" + entry + "\"");
+			}
+			scaleSpeed(kind, factor);
+		}
+	}
+};
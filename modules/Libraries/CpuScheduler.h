@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+/*
+* Weighted sharing of the processor of a worker node between the jobs it runs (generalized processor sharing):
+* a job gets weight / (sum of the weights of the jobs with an operation in progress) of the processor.
+* An operation is stretched by the share of its job when it starts, and keeps the job busy until it ends.
+* With equal weights, the processor is shared fairly.
+*/
+class CpuScheduler {
+private:
+	std::vector<double> weights;
+	std::vector<double> busyUntil; // End of the operation in progress of each job
+	std::vector<double> requestedTime; // Processor time of the operations of each job, on a dedicated processor
+	std::vector<double> sharedTime; // Time the same operations took on the shared processor
+
+public:
+	virtual ~CpuScheduler() {
+	}
+
+	void setWeights(const std::vector<double>& jobWeights) {
+		weights = jobWeights;
+		busyUntil.assign(weights.size(), -1);
+		requestedTime.assign(weights.size(), 0);
+		sharedTime.assign(weights.size(), 0);
+	}
+
+	/*
+	* Returns the duration of an operation of a job on the shared processor.
+	*
+	* Parameters:
+	*	- job: job running the operation
+	*	- now: start of the operation
+	*	- duration: duration of the operation on a dedicated processor
+	*/
+	double share(int job, double now, double duration) {
+		if(job < 0 || job >= static_cast<int>(weights.size())) {
+			return duration;
+		}
+		double busyWeight = weights[job];
+		for(size_t j = 0; j < weights.size(); j++) {
+			if(static_cast<int>(j) != job && busyUntil[j] >= now) {
+				busyWeight += weights[j];
+			}
+		}
+		double shared = duration * busyWeight / weights[job];
+		busyUntil[job] = std::max(busyUntil[job], now + shared);
+		requestedTime[job] += duration;
+		sharedTime[job] += shared;
+		return shared;
+	}
+
+	int getJobs() const {
+		return weights.size();
+	}
+
+	double getWeight(int job) const {
+		return weights[job];
+	}
+
+	double getRequestedTime(int job) const {
+		return requestedTime[job];
+	}
+
+	double getSharedTime(int job) const {
+		return sharedTime[job];
+	}
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+/*
+* Streams the values of one or more input CSV files, one chunk of lines at a time,
+* so that the Leader never holds the whole dataset in memory.
+* The value of each record is read from the specified column; lines whose column
+* is not an integer (e.g. headers) are skipped and counted.
+*/
+class InputReader {
+private:
+	std::vector<std::string> fileNames;
+	size_t currentFile;
+	std::ifstream file;
+	int column;
+	int chunkSize;
+	long long recordsRead;
+	long long linesSkipped;
+
+	// Opens the next file of the list, returns false when all files have been read
+	bool openNextFile() {
+		if(file.is_open()) {
+			file.close();
+		}
+		while(currentFile < fileNames.size()) {
+			file.open(fileNames[currentFile++], std::ios::binary);
+			if(file.is_open()) {
+				return true;
+			}
+			throw std::runtime_error("Can't open input file: " + fileNames[currentFile - 1]);
+		}
+		return false;
+	}
+
+	// Extracts the integer in the configured column, returns false if missing or not an integer
+	bool extractValue(const std::string& line, int& value) const {
+		std::stringstream lineStream(line);
+		std::string field;
+		for(int i = 0; i <= column; i++) {
+			if(!std::getline(lineStream, field, ',')) {
+				return false;
+			}
+		}
+		size_t parsed = 0;
+		try {
+			value = std::stoi(field, &parsed);
+		} catch(const std::exception&) {
+			return false;
+		}
+		// Allow trailing spaces/carriage returns only
+		return field.find_first_not_of(" \t\r", parsed) == std::string::npos;
+	}
+
+public:
+	/*
+	* Parameters:
+	*	- fileNames: input files, read in order
+	*	- column: index of the value column (0-based)
+	*	- chunkSize: maximum number of lines per chunk (more only while all of them are skipped)
+	*/
+	InputReader(const std::vector<std::string>& fileNames, int column, int chunkSize)
+	: fileNames(fileNames), currentFile(0), column(column), chunkSize(chunkSize), recordsRead(0), linesSkipped(0) {
+		openNextFile();
+	}
+
+	/*
+	* Reads the next chunk of values, across file boundaries.
+	* If every line of the chunk is skipped, reading continues until at least
+	* one value is read or the input ends.
+	*
+	* Returns:
+	*	- Up to chunkSize values, empty only when all the input has been read
+	*/
+	std::vector<int> nextChunk() {
+		std::vector<int> chunk;
+		std::string line;
+		int linesRead = 0;
+
+		while((linesRead < chunkSize || chunk.empty()) && file.is_open()) {
+			if(!std::getline(file, line)) {
+				openNextFile();
+				continue;
+			}
+			linesRead++;
+
+			int value;
+			if(extractValue(line, value)) {
+				chunk.push_back(value);
+				recordsRead++;
+			} else {
+				linesSkipped++;
+			}
+		}
+		return chunk;
+	}
+
+	long long getRecordsRead() const {
+		return recordsRead;
+	}
+
+	long long getLinesSkipped() const {
+		return linesSkipped;
+	}
+
+	/*
+	* Splits a list of file names separated by spaces or commas.
+	*/
+	static std::vector<std::string> splitFileList(const std::string& list) {
+		std::vector<std::string> names;
+		std::string name;
+		for(char c : list) {
+			if(c == ',' || c == ' ' || c == '\t') {
+				if(!name.empty()) names.push_back(name);
+				name.clear();
+			} else {
+				name += c;
+			}
+		}
+		if(!name.empty()) names.push_back(name);
+		return names;
+	}
+};
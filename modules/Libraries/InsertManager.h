@@ -1,3 +1,5 @@
+#pragma once
+
 #include <iostream>
 #include <map>
 #include <fstream>
@@ -5,6 +7,9 @@
 #include <sstream>
 #include <vector>
 #include <filesystem>
+#include <omnetpp.h>
+
+#include "TupleTracer.h"
 
 namespace fs = std::filesystem;
 
@@ -14,11 +19,18 @@ private:
     std::map<int, std::vector<int>> previousData; // Structure with previously requested batch (step, [values])
     std::map<int, std::vector<int>> insertedData; // Structure with inserted data (step, [values])
     std::map<int, int> senderReqMap; // Keep track of elaborated reqIDs from different senders
+    std::map<int, int> committedBatches; // Highest local batch committed by each origin (speculative execution)
+
+    // Traces of the traced inserted data (in memory only): the i-th trace of a step belongs to its i-th value,
+    // values past the last trace of their step are not traced
+    std::map<int, std::vector<TupleTrace>> insertedTraces;
+    std::map<int, std::vector<TupleTrace>> batchTraces; // Traces of the batch returned by getBatch
     
     //Backup information
     std::string insertFilename;
     std::string previousBatchFilename;
     std::string requestFilename;
+    std::string commitFilename;
     
     // Auxiliary information
     int currentBatchSize;
@@ -31,25 +43,40 @@ private:
         currentBatchSize = 0;
     }
 
+    // Moves the traces of the first values of a step, taken in the batch, to the batch traces
+    void takeTraces(int scheduleStep, int count) {
+        auto it = insertedTraces.find(scheduleStep);
+        if (it == insertedTraces.end()) {
+            return;
+        }
+        std::vector<TupleTrace>& traces = it->second;
+        int taken = std::min(count, static_cast<int>(traces.size()));
+        batchTraces[scheduleStep].assign(traces.begin(), traces.begin() + taken);
+        traces.erase(traces.begin(), traces.begin() + taken);
+        if (traces.empty()) {
+            insertedTraces.erase(it);
+        }
+    }
+
     /*
     * Saves the currently requested batch to a temporary file
     */
     void saveCurrentBatch() {
         std::ofstream tempFile(previousBatchFilename);
         if (!tempFile.is_open()) {
-            std::cout << "Error opening temp file for writing." << std::endl;
+            EV_ERROR_C("InsertManager") << "Error opening temp file for writing." << "\n";
             return;
         }
 
-        std::cout << "[CK] Saving: ";
+        EV_DEBUG_C("InsertManager") << "[CK] Saving: ";
 
         for (const auto& stepPair : previousData) {
             for (const int value : stepPair.second) {
                 tempFile << stepPair.first << ',' << value << std::endl;
-                std::cout << stepPair.first << ", " << value << " | ";
+                EV_DEBUG_C("InsertManager") << stepPair.first << ", " << value << " | ";
             }
         }
-        std::cout << "\n";
+        EV_DEBUG_C("InsertManager") << "\n";
         tempFile.close();
     }
 
@@ -60,7 +87,7 @@ private:
     void updateInsertFile() {
         std::ofstream insertFile(insertFilename, std::ofstream::trunc);
         if (!insertFile.is_open()) {
-            std::cout << "Error opening insert file for writing.\n";
+            EV_ERROR_C("InsertManager") << "Error opening insert file for writing.\n";
             return;
         }
 
@@ -78,7 +105,7 @@ private:
     void appendData(int step, int value) {
         std::ofstream insertFile(insertFilename, std::ios::app);
         if (!insertFile.is_open()) {
-            std::cout << "Error opening insert file for writing.\n";
+            EV_ERROR_C("InsertManager") << "Error opening insert file for writing.\n";
             return;
         }
 
@@ -94,7 +121,7 @@ private:
     void updateReqFile() {
         std::ofstream reqFile(requestFilename);
         if (!reqFile.is_open()) {
-            std::cout << "Error opening request file for writing.\n";
+            EV_ERROR_C("InsertManager") << "Error opening request file for writing.\n";
             return;
         }
 
@@ -104,6 +131,48 @@ private:
         reqFile.close();
     }
 
+    /*
+    * Updates the committed batches file
+    */
+    void updateCommitFile() {
+        std::ofstream commitFile(commitFilename);
+        if (!commitFile.is_open()) {
+            EV_ERROR_C("InsertManager") << "Error opening commit file for writing.\n";
+            return;
+        }
+
+        for (const auto& commitPair : committedBatches) {
+            commitFile << commitPair.first << ',' << commitPair.second << "\n";
+        }
+        commitFile.close();
+    }
+
+    /*
+    * Loads the committed batches file, if any (line format: "originID,batchIndex")
+    */
+    void loadCommits() {
+        std::ifstream commitFile(commitFilename, std::ios::binary);
+        if (!commitFile.is_open()) {
+            return;
+        }
+
+        std::string line;
+        while (std::getline(commitFile, line)) {
+            std::istringstream iss(line);
+            std::string part;
+            std::vector<int> parts;
+
+            while (std::getline(iss, part, ',')) {
+                parts.push_back(std::stoi(part));
+            }
+
+            if (parts.size() == 2) {
+                committedBatches[parts[0]] = parts[1];
+            }
+        }
+        commitFile.close();
+    }
+
     /*
     * Loads all data from the files:
     *  - Requests information
@@ -117,7 +186,7 @@ private:
         if(fs::exists(previousBatchFilename)) {
             std::ifstream previousDataFile(previousBatchFilename, std::ios::binary);
             if (!previousDataFile.is_open()) {
-                std::cout << "Error opening temp data file for reading.\n";
+                EV_ERROR_C("InsertManager") << "Error opening temp data file for reading.\n";
                 return;
             }
 
@@ -142,14 +211,14 @@ private:
             for(int i = 0; i < previousData.size(); i++) {
                 currentBatchSize += previousData[i].size(); // This remains 0 if we load no data
             }
-            std::cout << "Read previous file - size " << currentBatchSize << "\n";
+            EV_DEBUG_C("InsertManager") << "Read previous file - size " << currentBatchSize << "\n";
             printScheduledData();
         }
 
         // Inserted Data
         std::ifstream insertFile(insertFilename, std::ios::binary);
         if (!insertFile.is_open()) {
-            std::cout << "Error opening insert file for reading.\n";
+            EV_ERROR_C("InsertManager") << "Error opening insert file for reading.\n";
             return;
         }
 
@@ -171,13 +240,13 @@ private:
         }
         insertFile.close();
 
-        std::cout << "Loaded:\n";
+        EV_DEBUG_C("InsertManager") << "Loaded:\n";
         printInsertedData();
 
         // Request Log File
         std::ifstream reqFile(requestFilename, std::ios::binary);
         if (!reqFile.is_open()) {
-            std::cout << "Error opening request file for reading.\n";
+            EV_ERROR_C("InsertManager") << "Error opening request file for reading.\n";
             return;
         }
 
@@ -202,21 +271,30 @@ private:
 
 
 public:
-    InsertManager() : insertFilename(""), requestFilename(""), previousBatchFilename(""), batchSize(0) {
-        std::cout << "WARNING: Using default InsertManager constructor - missing filenames and BatchSize\n";
+    InsertManager() : insertFilename(""), requestFilename(""), commitFilename(""), previousBatchFilename(""), batchSize(0) {
+        EV_WARN_C("InsertManager") << "Using default InsertManager constructor - missing filenames and BatchSize\n";
     }
 
-    InsertManager(const std::string& insertFilename, const std::string& requestFilename, const std::string& previousBatchFilename, int batchSize)
-        : insertFilename(insertFilename), requestFilename(requestFilename), previousBatchFilename(previousBatchFilename), batchSize(batchSize) {
+    /*
+    * Parameters:
+    *  - insertFilename: File of the inserted data not yet elaborated
+    *  - requestFilename: File of the last request ID seen from each sender
+    *  - commitFilename: File of the last batch committed by each origin (speculative execution)
+    *  - previousBatchFilename: Temp file of the batch in progress
+    *  - batchSize: Maximum number of values per batch
+    */
+    InsertManager(const std::string& insertFilename, const std::string& requestFilename, const std::string& commitFilename, const std::string& previousBatchFilename, int batchSize)
+        : insertFilename(insertFilename), requestFilename(requestFilename), commitFilename(commitFilename), previousBatchFilename(previousBatchFilename), batchSize(batchSize) {
             currentBatchSize = 0;
+        loadCommits();
         if (fs::exists(insertFilename) && fs::exists(requestFilename)) {
             loadData();
         } else {
             if (!fs::exists(insertFilename)) {
-                std::cout << "Insert file does not exist, starting with an empty dataset.\n";
+                EV_DEBUG_C("InsertManager") << "Insert file does not exist, starting with an empty dataset.\n";
             }
             if (!fs::exists(requestFilename)) {
-                std::cout << "Request file does not exist, starting with an empty request log.\n" ;
+                EV_DEBUG_C("InsertManager") << "Request file does not exist, starting with an empty request log.\n" ;
             }
         }
     }
@@ -229,11 +307,12 @@ public:
     */
     std::map<int, std::vector<int>> getBatch() {
         std::map<int, std::vector<int>> batch;
+        batchTraces.clear();
 
         // If a previous batch was reloaded, return this
         if(currentBatchSize > 0) {
             batch = previousData;
-            std::cout << "Previous data: \n";
+            EV_DEBUG_C("InsertManager") << "Previous data: \n";
             printScheduledData();
             return batch;
         }
@@ -250,6 +329,7 @@ public:
             // Add these values to the batch
             std::vector<int> stepBatch(values.begin(), values.begin() + valuesToAdd);
             batch.insert({scheduleStep, stepBatch});
+            takeTraces(scheduleStep, valuesToAdd);
             
             // Adjust the batch size
             currentBatchSize += valuesToAdd;
@@ -271,7 +351,7 @@ public:
         // Remove current batch by overwriting insert file
         updateInsertFile();
 
-        std::cout << "Current data: \n";
+        EV_DEBUG_C("InsertManager") << "Current data: \n";
         printScheduledData();
         return batch;
     }
@@ -288,25 +368,115 @@ public:
     *  - reqID: Request ID of the exchange, used to check for duplicate values
     *  - scheduleStep: The step of the schedule at which this data point should be inserted
     *  - value: Value of the data point to insert
+    *  - trace: Trace of the data point, if it is traced
+    *
+    * Returns:
+    *  - false if the request is a duplicate
     */
-    void insertValue(int senderID, int reqID, int scheduleStep, int value) {
+    bool insertValue(int senderID, int reqID, int scheduleStep, int value, const TupleTrace& trace = TupleTrace()) {
         auto map_it = senderReqMap.find(senderID);
         // If we have already received something from this sender, and the last request had ID greater than
         // the current reqID, we can reject this because it is a duplicate.
         if (map_it != senderReqMap.end() && map_it->second >= reqID) {
-            std::cout << "DEBUG: Ignoring already inserted data: " << value << " From " << senderID << " With reqID: " << reqID << "\n";
-            return;
+            EV_TRACE_C("InsertManager") << "Ignoring already inserted data: " << value << " From " << senderID << " With reqID: " << reqID << "\n";
+            return false;
         }
         
         // Update the last seen reqID to the current one
         senderReqMap[senderID] = reqID;
         // Push the value in the insertedData map
         insertedData[scheduleStep].push_back(value);
-        std::cout << "DEBUG: Inserted " << value << " From " << senderID << " With reqID: " << reqID << " At scheduleStep: " << scheduleStep << "\n";
+        if (trace.traced()) {
+            std::vector<TupleTrace>& traces = insertedTraces[scheduleStep];
+            traces.resize(insertedData[scheduleStep].size() - 1);
+            traces.push_back(trace);
+        }
+        EV_TRACE_C("InsertManager") << "Inserted " << value << " From " << senderID << " With reqID: " << reqID << " At scheduleStep: " << scheduleStep << "\n";
 
         // Update files by appending value and updating last request seen
         appendData(scheduleStep, value);
         updateReqFile();
+        return true;
+    }
+
+    /*
+    * Commits a batch of local data of the specified origin worker.
+    * Batches are committed in increasing order by every producer (the owner and its speculative copy),
+    * so the highest committed index per origin is enough to recognize a batch that was already committed.
+    * Batch indexes are kept apart from the request IDs of the inserts, which are a different sequence.
+    *
+    * Parameters:
+    *  - originID: ID of the worker owning the batch
+    *  - batchIndex: Index of the batch in the origin's input
+    *
+    * Returns:
+    *  - true if this is the first commit of the batch, false if it must be discarded
+    */
+    bool commitBatch(int originID, int batchIndex) {
+        if (isCommitted(originID, batchIndex)) {
+            EV_DEBUG_C("InsertManager") << "Discarding already committed batch " << batchIndex << " of worker " << originID << "\n";
+            return false;
+        }
+        committedBatches[originID] = batchIndex;
+        updateCommitFile();
+        return true;
+    }
+
+    // Returns whether the specified batch of the origin worker has already been committed
+    bool isCommitted(int originID, int batchIndex) {
+        auto map_it = committedBatches.find(originID);
+        return map_it != committedBatches.end() && map_it->second >= batchIndex;
+    }
+
+    // Returns the last batch committed for the specified origin (-1 if none)
+    int getLastCommitted(int originID) {
+        auto map_it = committedBatches.find(originID);
+        return map_it != committedBatches.end() ? map_it->second : -1;
+    }
+
+    /*
+    * Returns the batch that was in progress before a crash, if any, without fetching new data.
+    * Used when replaying the ChangeKey batch of a failed worker.
+    */
+    std::map<int, std::vector<int>> getPreviousBatch() {
+        if(currentBatchSize > 0) {
+            return previousData;
+        }
+        return {};
+    }
+
+    // Returns the last request ID seen from the specified sender (-1 if none)
+    int getLastRequest(int senderID) {
+        auto map_it = senderReqMap.find(senderID);
+        return map_it != senderReqMap.end() ? map_it->second : -1;
+    }
+
+    /*
+    * Takes over the pending inserted data and the request log of another InsertManager (of a failed worker).
+    * The request IDs are merged keeping the highest per sender, so that re-sent inserts already received by
+    * the failed worker are still recognized as duplicates. The inserted data of the other InsertManager is cleared.
+    * Its committed batches are not merged: they are those of the failed worker's own input, elaborated from its files.
+    *
+    * Parameters:
+    *  - other: InsertManager of the failed worker
+    */
+    void absorb(InsertManager& other) {
+        for (auto& stepPair : other.insertedData) {
+            for (const int value : stepPair.second) {
+                insertedData[stepPair.first].push_back(value);
+                appendData(stepPair.first, value);
+            }
+        }
+        other.insertedData.clear();
+        other.updateInsertFile();
+
+        for (const auto& reqPair : other.senderReqMap) {
+            auto map_it = senderReqMap.find(reqPair.first);
+            if (map_it == senderReqMap.end() || map_it->second < reqPair.second) {
+                senderReqMap[reqPair.first] = reqPair.second;
+            }
+        }
+        updateReqFile();
     }
 
     // Clears the temp file after successfully elaborating the current batch of changekey data
@@ -333,23 +503,40 @@ public:
         return true;
     }
 
+    /*
+    * Returns the traces of the batch returned by the last getBatch, by schedule step.
+    * A step may have fewer traces than values: the values past its last trace are not traced.
+    */
+    const std::map<int, std::vector<TupleTrace>>& getBatchTraces() const {
+        return batchTraces;
+    }
+
+    // Returns the number of inserted values waiting to be loaded in a batch
+    long getBacklog() const {
+        long backlog = 0;
+        for (const auto& pair : insertedData) {
+            backlog += pair.second.size();
+        }
+        return backlog;
+    }
+
     void printScheduledData(){
         for(int i = 0; i<previousData.size(); i++){
-            std::cout << "Step " << i << ": ";
+            EV_DEBUG_C("InsertManager") << "Step " << i << ": ";
             for(int j = 0; j < previousData[i].size(); j++){
-                std::cout << previousData[i][j] << " ";
+                EV_DEBUG_C("InsertManager") << previousData[i][j] << " ";
             }
-        std::cout << "\n";
+        EV_DEBUG_C("InsertManager") << "\n";
         }
     }
 
     void printInsertedData(){
         for(int i = 0; i<insertedData.size(); i++){
-            std::cout << "Step " << i << ": ";
+            EV_DEBUG_C("InsertManager") << "Step " << i << ": ";
             for(int j = 0; j < previousData[i].size(); j++){
-                std::cout << previousData[i][j] << " ";
+                EV_DEBUG_C("InsertManager") << previousData[i][j] << " ";
             }
-        std::cout << "\n";
+        EV_DEBUG_C("InsertManager") << "\n";
         }
     }
 };
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+// Job of a multi-job run: program file ("random": random program and data), submission time, processor weight
+struct JobSpec {
+	std::string programFile;
+	double submitTime;
+	double weight;
+};
+
+/*
+* Parses a job queue: "<program>[@<time>][*<weight>]" entries separated by commas or spaces,
+* e.g. "jobs/example_program.json@0s*2, random@5s". Jobs are submitted at 0s, with weight 1, by default.
+* The position of a job in the queue is its job ID.
+*/
+inline std::vector<JobSpec> parseJobQueue(const std::string& queue) {
+	std::string list = queue;
+	std::replace(list.begin(), list.end(), ',', ' ');
+	std::istringstream iss(list);
+	std::vector<JobSpec> jobs;
+	std::string entry;
+	while(iss >> entry) {
+		JobSpec job{entry, 0, 1};
+		size_t star = job.programFile.find('*');
+		if(star != std::string::npos) {
+			job.weight = std::stod(job.programFile.substr(star + 1));
+			job.programFile.erase(star);
+		}
+		size_t at = job.programFile.find('@');
+		if(at != std::string::npos) {
+			std::string time = job.programFile.substr(at + 1);
+			if(!time.empty() && time.back() == 's') {
+				time.pop_back();
+			}
+			job.submitTime = std::stod(time);
+			job.programFile.erase(at);
+		}
+		if(job.programFile.empty() || job.weight <= 0 || job.submitTime < 0) {
+			throw std::invalid_argument(entry);
+		}
+		if(job.programFile == "random") {
+			job.programFile.clear();
+		}
+		jobs.push_back(job);
+	}
+	return jobs;
+}
+
+// Leader of one job of the queue, started by the JobManager
+class JobLeader {
+public:
+	virtual ~JobLeader() {
+	}
+
+	/*
+	* Starts the job: distributes its input and program to the workers.
+	*
+	* Parameters:
+	*	- programFile: JSON program to run (random program and data if empty)
+	*/
+	virtual void startJob(const std::string& programFile) = 0;
+};
+
+// Notified by the Leaders of the jobs when their job completes
+class JobListener {
+public:
+	virtual ~JobListener() {
+	}
+
+	virtual void jobFinished(int jobId) = 0;
+};
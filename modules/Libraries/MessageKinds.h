@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <omnetpp.h>
+
+#include "StreamingHistogram.h"
+
+/*
+* Kinds of the messages exchanged by the Leader and the Workers.
+* The kind is set when a message is created, and indexes the dispatch table of the receiver.
+* Kind 0 is left to the self-messages (timers), which are recognized by pointer.
+*/
+enum MessageKind : short {
+	MSG_SETUP = 1,
+	MSG_SCHEDULE,
+	MSG_DATA_INSERT,
+	MSG_FINISH_LOCAL,
+	MSG_CHECK_CK_ACK,
+	MSG_RESTART,
+	MSG_PING,
+	MSG_FINISH_SIM,
+	MSG_SPECULATE,
+	MSG_SPECULATIVE_COMMIT,
+	MSG_REASSIGN,
+	MSG_SETUP_CREDIT,
+	MSG_MEMBERSHIP,
+	MSG_INSERT_CREDIT,
+	MSG_STREAM_TUPLES,
+	MSG_LEAVE,
+	MSG_KIND_COUNT
+};
+
+inline const char* messageKindName(int kind) {
+	static const char* names[MSG_KIND_COUNT] = {
+		"unknown", "Setup", "Schedule", "DataInsert", "FinishLocalElaboration", "CheckChangeKeyAck", "Restart",
+		"Ping", "FinishSim", "Speculate", "SpeculativeCommit", "Reassign", "SetupCredit", "Membership", "InsertCredit",
+		"StreamTuples", "Leave"
+	};
+	return (kind > 0 && kind < MSG_KIND_COUNT) ? names[kind] : names[0];
+}
+
+// Whether the kind indexes the dispatch table
+inline bool isValidMessageKind(int kind) {
+	return kind > 0 && kind < MSG_KIND_COUNT;
+}
+
+/*
+* Per-kind statistics of the received messages: count, bytes, and the distribution of the latency
+* between sending (the timestamp set by the sender) and handling: queueing, transmission and propagation on every hop.
+*/
+class MessageStats {
+private:
+	struct KindStats {
+		long long count = 0;
+		long long bytes = 0;
+		StreamingHistogram latency; // s
+	};
+	std::array<KindStats, MSG_KIND_COUNT> stats;
+
+public:
+	// Records a received message (bytes are only known for packets)
+	void record(omnetpp::cMessage* msg) {
+		KindStats& entry = stats[isValidMessageKind(msg->getKind()) ? msg->getKind() : 0];
+		entry.count++;
+		if(msg->isPacket()) {
+			entry.bytes += static_cast<omnetpp::cPacket*>(msg)->getByteLength();
+		}
+		entry.latency.collect(SIMTIME_DBL(omnetpp::simTime() - msg->getTimestamp()));
+	}
+
+	long long getCount(int kind) const {
+		return stats[kind].count;
+	}
+
+	/*
+	* Records the scalars of every received kind on the module, e.g. "DataInsert:count":
+	* count, bytes, mean, median, 99th percentile and max latency
+	*/
+	void recordScalars(omnetpp::cComponent* module) const {
+		for(int kind = 0; kind < MSG_KIND_COUNT; kind++) {
+			const KindStats& entry = stats[kind];
+			if(entry.count == 0) {
+				continue;
+			}
+			std::string prefix = std::string(messageKindName(kind)) + ":";
+			module->recordScalar((prefix + "count").c_str(), entry.count);
+			module->recordScalar((prefix + "bytes").c_str(), entry.bytes, "B");
+			module->recordScalar((prefix + "meanLatency").c_str(), entry.latency.getMean(), "s");
+			module->recordScalar((prefix + "p50Latency").c_str(), entry.latency.quantile(0.5), "s");
+			module->recordScalar((prefix + "p99Latency").c_str(), entry.latency.quantile(0.99), "s");
+			module->recordScalar((prefix + "maxLatency").c_str(), entry.latency.getMax(), "s");
+		}
+	}
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <omnetpp.h>
+
+/*
+* Pool of recycled messages of a single type, for the high-frequency exchanges (DataInsert/ACK, ping, FinishLocalElaboration).
+* A received message is released to the pool of its receiver instead of being deleted, and the next message of the
+* same type sent by the module is taken from the pool: in steady state, no message is allocated.
+* Released messages are reset to their default field values; the pool keeps at most 'capacity' of them.
+* Acquired messages get the kind of the pool.
+*/
+template <typename T>
+class MessagePool {
+private:
+	std::vector<T*> freeMessages;
+	short kind;
+	size_t capacity;
+	long long allocations; // Messages created by acquire()
+	long long reuses; // Messages recycled by acquire()
+
+public:
+	MessagePool(short kind, size_t capacity = 64) : kind(kind), capacity(capacity), allocations(0), reuses(0) {
+	}
+
+	~MessagePool() {
+		clear();
+	}
+
+	// Returns a message with default field values, recycled if available
+	T* acquire() {
+		T* msg;
+		if(freeMessages.empty()) {
+			allocations++;
+			msg = new T();
+		} else {
+			msg = freeMessages.back();
+			freeMessages.pop_back();
+			reuses++;
+		}
+		msg->setKind(kind);
+		return msg;
+	}
+
+	// Takes back a message owned by the module (received, or never sent)
+	void release(T* msg) {
+		if(freeMessages.size() >= capacity) {
+			delete msg;
+			return;
+		}
+		*msg = T(); // Reset the fields
+		freeMessages.push_back(msg);
+	}
+
+	// Deletes the pooled messages
+	void clear() {
+		for(T* msg : freeMessages) {
+			delete msg;
+		}
+		freeMessages.clear();
+	}
+
+	long long getAllocations() const {
+		return allocations;
+	}
+
+	long long getReuses() const {
+		return reuses;
+	}
+};
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "setup_m.h"
+#include "schedule_m.h"
+#include "datainsert_m.h"
+#include "finishLocalElaboration_m.h"
+#include "checkChangeKeyAck_m.h"
+#include "restart_m.h"
+#include "ping_m.h"
+#include "finishSim_m.h"
+#include "speculate_m.h"
+#include "speculativeCommit_m.h"
+#include "reassign_m.h"
+#include "setupCredit_m.h"
+#include "membership_m.h"
+#include "insertCredit_m.h"
+#include "streamTuples_m.h"
+#include "leave_m.h"
+
+#include "MessageKinds.h"
+#include "PayloadCodec.h"
+
+// Wire sizes: addresses, kind, hop count and job ID of every message, then 4 bytes per int, 8 per time, 1 per bool
+#define MESSAGE_HEADER_BYTES 16
+#define INT_BYTES 4
+#define TIME_BYTES 8
+#define BOOL_BYTES 1
+
+/*
+* Bytes of an int array of a message, with the specified encoding: the sizes of PayloadCodec::payloadSize,
+* computed in one pass over the values without copying them.
+*
+* Parameters:
+*	- count: number of values
+*	- valueAt: accessor of the i-th value
+*	- encoding: payload encoding (ENCODING_RAW: 4 bytes per value)
+*/
+template <typename Accessor>
+int64_t arrayBytes(size_t count, Accessor valueAt, PayloadEncoding encoding) {
+	if(encoding == ENCODING_RAW) {
+		return INT_BYTES * count;
+	}
+
+	// Delta varint body, and the range of the values for the frame of reference
+	int64_t varintBody = 0;
+	int64_t previous = 0;
+	int64_t lo = 0;
+	int64_t hi = 0;
+	for(size_t i = 0; i < count; i++) {
+		int64_t value = valueAt(i);
+		varintBody += PayloadCodec::varintSize(PayloadCodec::zigzag(value - previous));
+		previous = value;
+		lo = (i == 0) ? value : std::min(lo, value);
+		hi = (i == 0) ? value : std::max(hi, value);
+	}
+	int width = 0;
+	for(uint64_t range = static_cast<uint64_t>(hi - lo); range > 0; range >>= 1) {
+		width++;
+	}
+
+	int64_t header = 1 + PayloadCodec::varintSize(count);
+	int64_t varint = header + varintBody;
+	int64_t packed = header + PayloadCodec::varintSize(PayloadCodec::zigzag(lo)) + 1 + (count * width + 7) / 8;
+	if(encoding == ENCODING_VARINT) {
+		return varint;
+	}
+	if(encoding == ENCODING_FOR) {
+		return packed;
+	}
+	return std::min({header + static_cast<int64_t>(4 * count), varint, packed});
+}
+
+// Bytes of an int field: 4, or a zig-zag varint when payloads are encoded
+inline int64_t fieldBytes(int value, PayloadEncoding encoding) {
+	return encoding == ENCODING_RAW ? INT_BYTES : PayloadCodec::varintSize(PayloadCodec::zigzag(value));
+}
+
+// Bytes of a string array: characters plus a terminator per string
+template <typename T>
+int64_t scheduleBytes(const T* msg) {
+	int64_t bytes = 0;
+	for(size_t i = 0; i < msg->getScheduleArraySize(); i++) {
+		bytes += std::strlen(msg->getSchedule(i)) + 1;
+	}
+	return bytes;
+}
+
+/*
+* Returns the wire size of a message, from its kind and payload (arrays and strings included).
+* The data-carrying payloads (input data, partial vectors, ChangeKey inserts and speculative commits)
+* are counted with their encoded size; control fields and schedules are always counted raw.
+*/
+inline int64_t messageByteLength(const RoutedMessage* msg, PayloadEncoding encoding = ENCODING_RAW) {
+	int64_t payload = 0;
+	switch(msg->getKind()) {
+		case MSG_SETUP: {
+			const SetupMessage* setup = static_cast<const SetupMessage*>(msg);
+			payload = 2 * INT_BYTES + 2 * BOOL_BYTES;
+			payload += arrayBytes(setup->getDataArraySize(), [setup](size_t i) { return setup->getData(i); }, encoding);
+			break;
+		}
+		case MSG_SCHEDULE: {
+			const ScheduleMessage* schedule = static_cast<const ScheduleMessage*>(msg);
+			payload = INT_BYTES * (1 + schedule->getParametersArraySize() + schedule->getUpperBoundsArraySize() + schedule->getMembersArraySize()) + scheduleBytes(schedule);
+			payload += INT_BYTES * (schedule->getStageOfStepArraySize() + schedule->getStageOfWorkerArraySize());
+			break;
+		}
+		case MSG_DATA_INSERT: {
+			const DataInsertMessage* insert = static_cast<const DataInsertMessage*>(msg);
+			payload = fieldBytes(insert->getDestID(), encoding) + fieldBytes(insert->getSenderID(), encoding) + fieldBytes(insert->getReqID(), encoding);
+			payload += fieldBytes(insert->getData(), encoding) + fieldBytes(insert->getScheduleStep(), encoding) + BOOL_BYTES;
+			if(insert->getTraceOrigin() >= 0) {
+				payload += 2 * TIME_BYTES + INT_BYTES; // Trace of a sampled data point
+			}
+			if(insert->getReplayPhase() >= 0) {
+				payload += BOOL_BYTES; // Phase of the failure of the sender, while it recovers
+			}
+			break;
+		}
+		case MSG_FINISH_LOCAL:
+			payload = 3 * INT_BYTES;
+			break;
+		case MSG_CHECK_CK_ACK: {
+			const CheckChangeKeyAckMessage* ack = static_cast<const CheckChangeKeyAckMessage*>(msg);
+			payload = 4 * INT_BYTES;
+			payload += arrayBytes(ack->getPartialVectorArraySize(), [ack](size_t i) { return ack->getPartialVector(i); }, encoding);
+			break;
+		}
+		case MSG_RESTART: {
+			const RestartMessage* restart = static_cast<const RestartMessage*>(msg);
+			payload = INT_BYTES * (1 + restart->getParametersArraySize() + restart->getUpperBoundsArraySize() + restart->getKeyOwnersArraySize() + restart->getMembersArraySize());
+			payload += INT_BYTES * (restart->getStageOfStepArraySize() + restart->getStageOfWorkerArraySize());
+			payload += scheduleBytes(restart) + BOOL_BYTES;
+			break;
+		}
+		case MSG_PING:
+			payload = 2 * INT_BYTES;
+			break;
+		case MSG_FINISH_SIM:
+			payload = INT_BYTES;
+			break;
+		case MSG_SPECULATE:
+			payload = 3 * INT_BYTES + BOOL_BYTES;
+			break;
+		case MSG_SPECULATIVE_COMMIT: {
+			const SpeculativeCommitMessage* commit = static_cast<const SpeculativeCommitMessage*>(msg);
+			payload = 3 * INT_BYTES;
+			payload += arrayBytes(commit->getResultsArraySize(), [commit](size_t i) { return commit->getResults(i); }, encoding);
+			payload += arrayBytes(commit->getRoutedKeysArraySize(), [commit](size_t i) { return commit->getRoutedKeys(i); }, encoding);
+			payload += arrayBytes(commit->getRoutedStepsArraySize(), [commit](size_t i) { return commit->getRoutedSteps(i); }, encoding);
+			payload += arrayBytes(commit->getRoutedValuesArraySize(), [commit](size_t i) { return commit->getRoutedValues(i); }, encoding);
+			break;
+		}
+		case MSG_REASSIGN:
+			payload = 2 * INT_BYTES;
+			break;
+		case MSG_LEAVE:
+			payload = INT_BYTES;
+			break;
+		case MSG_SETUP_CREDIT:
+			payload = 2 * INT_BYTES;
+			break;
+		case MSG_INSERT_CREDIT:
+			payload = INT_BYTES + BOOL_BYTES;
+			break;
+		case MSG_MEMBERSHIP:
+			payload = INT_BYTES * static_cast<const MembershipMessage*>(msg)->getMembersArraySize();
+			break;
+		case MSG_STREAM_TUPLES: {
+			const StreamTuplesMessage* tuples = static_cast<const StreamTuplesMessage*>(msg);
+			payload = TIME_BYTES * (1 + tuples->getEventTimesArraySize()) + BOOL_BYTES;
+			payload += arrayBytes(tuples->getValuesArraySize(), [tuples](size_t i) { return tuples->getValues(i); }, encoding);
+			break;
+		}
+	}
+	return MESSAGE_HEADER_BYTES + payload;
+}
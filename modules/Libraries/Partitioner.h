@@ -0,0 +1,132 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+/*
+* Partitioners of the changekey operator, selected per operator by its parameter:
+*	- modulo (0): value % (members / localityProbability), mapped to the members in order; values beyond the last member
+*	  keep their current key (the original routing; every membership change reshuffles the keys)
+*	- hash (1): multiplicative (Fibonacci) hash of the value, scaled to the number of keys
+*	- ring (2): consistent-hash ring with virtual nodes per key: when a key joins or leaves, only the values
+*	  of the ring segments it takes or gives away change key
+*	- range (3): [rangeMin, rangeMax] split in equal contiguous ranges, one per key (out-of-range values are clamped)
+* Keys are the workers' IDs; the worker currently owning each key is tracked separately (keyOwner).
+*/
+enum PartitionerType {
+	PARTITIONER_MODULO = 0,
+	PARTITIONER_HASH = 1,
+	PARTITIONER_RING = 2,
+	PARTITIONER_RANGE = 3
+};
+
+class Partitioner {
+private:
+	float localityProbability;
+	int virtualNodes;
+	int rangeMin;
+	int rangeMax;
+	std::vector<int> members; // Keys of the hash, ring and range partitioners
+	std::vector<std::pair<uint32_t, int>> ring; // Virtual node hash, key
+
+	// 32-bit finalizer (murmur3 fmix32)
+	static uint32_t mix(uint32_t h) {
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+	void buildRing() {
+		ring.clear();
+		for(int key : members) {
+			for(int v = 0; v < virtualNodes; v++) {
+				ring.push_back({mix(static_cast<uint32_t>(key) * 0x9e3779b1u + mix(v + 1)), key});
+			}
+		}
+		std::sort(ring.begin(), ring.end());
+	}
+
+public:
+	/*
+	* Parameters:
+	*	- numKeys: number of keys, the initial members are the keys 0 .. numKeys - 1
+	*	- localityProbability: fraction of the modulo range mapped to keys (changeKeyProbability)
+	*	- virtualNodes: virtual nodes per key on the ring
+	*	- rangeMin, rangeMax: value domain of the range partitioner
+	*/
+	Partitioner(int numKeys = 1, float localityProbability = 1, int virtualNodes = 64, int rangeMin = 0, int rangeMax = 100)
+	: localityProbability(localityProbability), virtualNodes(std::max(virtualNodes, 1)),
+	  rangeMin(rangeMin), rangeMax(std::max(rangeMin, rangeMax)) {
+		for(int key = 0; key < numKeys; key++) {
+			members.push_back(key);
+		}
+		buildRing();
+	}
+
+	static int parseName(const std::string& name) {
+		if(name == "modulo") return PARTITIONER_MODULO;
+		if(name == "hash") return PARTITIONER_HASH;
+		if(name == "ring") return PARTITIONER_RING;
+		if(name == "range") return PARTITIONER_RANGE;
+		throw std::runtime_error("Unknown partitioner '" + name + "' (modulo, hash, ring, range)");
+	}
+
+	static const char* name(int type) {
+		static const char* names[] = {"modulo", "hash", "ring", "range"};
+		return (type >= 0 && type <= PARTITIONER_RANGE) ? names[type] : "unknown";
+	}
+
+	/*
+	* Replaces the keys values are distributed over (workers joining or leaving the job).
+	* On the ring, only the values of the segments of the added/removed keys move.
+	*/
+	void setMembers(const std::vector<int>& keys) {
+		members = keys;
+		std::sort(members.begin(), members.end());
+		buildRing();
+	}
+
+	const std::vector<int>& getMembers() const {
+		return members;
+	}
+
+	/*
+	* Returns the key of a value, or -1 if the value keeps its current key (modulo partitioner only).
+	*
+	* Parameters:
+	*	- type: partitioner (PartitionerType)
+	*	- value: value to route
+	*/
+	int partition(int type, int value) const {
+		if(members.empty()) {
+			return -1;
+		}
+		if(type == PARTITIONER_MODULO) {
+			int numKeys = members.size();
+			int ckValue = value % (static_cast<int>((1 / localityProbability) * numKeys));
+			return (ckValue >= numKeys || ckValue < 0) ? -1 : members[ckValue];
+		}
+		if(type == PARTITIONER_HASH) {
+			uint32_t h = static_cast<uint32_t>(value) * 2654435761u;
+			return members[(static_cast<uint64_t>(h) * members.size()) >> 32];
+		}
+		if(type == PARTITIONER_RING) {
+			uint32_t h = mix(static_cast<uint32_t>(value));
+			auto it = std::lower_bound(ring.begin(), ring.end(), std::make_pair(h, -1));
+			return (it == ring.end()) ? ring.front().second : it->second;
+		}
+		if(type == PARTITIONER_RANGE) {
+			long long clamped = std::min(std::max(value, rangeMin), rangeMax);
+			long long span = (long long)rangeMax - rangeMin + 1;
+			return members[((clamped - rangeMin) * (long long)members.size()) / span];
+		}
+		throw std::runtime_error("Unknown partitioner type " + std::to_string(type));
+	}
+};
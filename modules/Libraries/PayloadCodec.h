@@ -0,0 +1,237 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+// Encoding of the integer arrays carried by messages ("auto" picks the smallest encoding of each array)
+enum PayloadEncoding {
+	ENCODING_RAW,
+	ENCODING_VARINT,
+	ENCODING_FOR,
+	ENCODING_AUTO
+};
+
+/*
+* Encode/decode kernels for integer arrays:
+*	- Delta + zig-zag varint: each value is stored as the zig-zag encoded difference from the previous one,
+*	  7 bits per byte (sorted or slowly varying arrays shrink to ~1 byte per value)
+*	- Frame of reference: each value is stored as its offset from the minimum, bit-packed with the width
+*	  of the largest offset (arrays of values in a narrow range shrink to a few bits per value)
+* Encoded format: scheme byte, varint count, then the scheme's body:
+*	- varint: one varint per value
+*	- frame of reference: zig-zag varint minimum, bit width byte, packed offsets (LSB first)
+*/
+class PayloadCodec {
+public:
+	enum Scheme : uint8_t {
+		RAW = 0,
+		DELTA_VARINT = 1,
+		FRAME_OF_REFERENCE = 2
+	};
+
+	static PayloadEncoding parseEncoding(const std::string& name) {
+		if(name == "raw") return ENCODING_RAW;
+		if(name == "varint") return ENCODING_VARINT;
+		if(name == "for") return ENCODING_FOR;
+		if(name == "auto") return ENCODING_AUTO;
+		throw std::runtime_error("Unknown payload encoding: " + name);
+	}
+
+	static uint64_t zigzag(int64_t value) {
+		return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+	}
+
+	static int64_t unzigzag(uint64_t value) {
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+
+	static size_t varintSize(uint64_t value) {
+		size_t size = 1;
+		while(value >= 0x80) {
+			value >>= 7;
+			size++;
+		}
+		return size;
+	}
+
+	static void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+		while(value >= 0x80) {
+			out.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	static uint64_t getVarint(const std::vector<uint8_t>& in, size_t& pos) {
+		uint64_t value = 0;
+		int shift = 0;
+		while(true) {
+			if(pos >= in.size() || shift > 63) {
+				throw std::runtime_error("Truncated varint in payload");
+			}
+			uint8_t byte = in[pos++];
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if((byte & 0x80) == 0) {
+				return value;
+			}
+			shift += 7;
+		}
+	}
+
+	// Bits needed for the largest offset from the minimum
+	static int bitWidth(const int* values, size_t count, int64_t& minimum) {
+		if(count == 0) {
+			minimum = 0;
+			return 0;
+		}
+		int64_t lo = *std::min_element(values, values + count);
+		int64_t hi = *std::max_element(values, values + count);
+		minimum = lo;
+		uint64_t range = static_cast<uint64_t>(hi - lo);
+		int width = 0;
+		while(range > 0) {
+			range >>= 1;
+			width++;
+		}
+		return width;
+	}
+
+	/*
+	* Returns the encoded size in bytes, without encoding (used for byte-length accounting).
+	*/
+	static size_t encodedSize(const int* values, size_t count, Scheme scheme) {
+		size_t header = 1 + varintSize(count);
+		if(scheme == RAW) {
+			return header + 4 * count;
+		}
+		if(scheme == DELTA_VARINT) {
+			size_t size = header;
+			int64_t previous = 0;
+			for(size_t i = 0; i < count; i++) {
+				size += varintSize(zigzag(values[i] - previous));
+				previous = values[i];
+			}
+			return size;
+		}
+		int64_t minimum;
+		int width = bitWidth(values, count, minimum);
+		return header + varintSize(zigzag(minimum)) + 1 + (count * width + 7) / 8;
+	}
+
+	// Returns the scheme with the smallest encoding of the values
+	static Scheme bestScheme(const int* values, size_t count) {
+		size_t varint = encodedSize(values, count, DELTA_VARINT);
+		size_t packed = encodedSize(values, count, FRAME_OF_REFERENCE);
+		size_t raw = encodedSize(values, count, RAW);
+		if(raw <= varint && raw <= packed) return RAW;
+		return varint <= packed ? DELTA_VARINT : FRAME_OF_REFERENCE;
+	}
+
+	/*
+	* Returns the size of an array encoded with the specified encoding.
+	* ENCODING_RAW is the plain array (4 bytes per value, no header).
+	*/
+	static size_t payloadSize(const int* values, size_t count, PayloadEncoding encoding) {
+		switch(encoding) {
+			case ENCODING_VARINT: return encodedSize(values, count, DELTA_VARINT);
+			case ENCODING_FOR: return encodedSize(values, count, FRAME_OF_REFERENCE);
+			case ENCODING_AUTO: return encodedSize(values, count, bestScheme(values, count));
+			default: return 4 * count;
+		}
+	}
+
+	static std::vector<uint8_t> encode(const std::vector<int>& values, Scheme scheme) {
+		std::vector<uint8_t> out;
+		out.reserve(encodedSize(values.data(), values.size(), scheme));
+		out.push_back(scheme);
+		putVarint(out, values.size());
+
+		if(scheme == RAW) {
+			for(int value : values) {
+				uint32_t bits = static_cast<uint32_t>(value);
+				for(int b = 0; b < 4; b++) {
+					out.push_back(static_cast<uint8_t>(bits >> (8 * b)));
+				}
+			}
+		} else if(scheme == DELTA_VARINT) {
+			int64_t previous = 0;
+			for(int value : values) {
+				putVarint(out, zigzag(value - previous));
+				previous = value;
+			}
+		} else {
+			int64_t minimum;
+			int width = bitWidth(values.data(), values.size(), minimum);
+			putVarint(out, zigzag(minimum));
+			out.push_back(static_cast<uint8_t>(width));
+			uint64_t buffer = 0;
+			int buffered = 0;
+			for(int value : values) {
+				buffer |= static_cast<uint64_t>(value - minimum) << buffered;
+				buffered += width;
+				while(buffered >= 8) {
+					out.push_back(static_cast<uint8_t>(buffer));
+					buffer >>= 8;
+					buffered -= 8;
+				}
+			}
+			if(buffered > 0) {
+				out.push_back(static_cast<uint8_t>(buffer));
+			}
+		}
+		return out;
+	}
+
+	static std::vector<int> decode(const std::vector<uint8_t>& in) {
+		if(in.empty()) {
+			throw std::runtime_error("Empty payload");
+		}
+		size_t pos = 1;
+		size_t count = getVarint(in, pos);
+		std::vector<int> values;
+		values.reserve(count);
+
+		if(in[0] == RAW) {
+			if(in.size() < pos + 4 * count) {
+				throw std::runtime_error("Truncated raw payload");
+			}
+			for(size_t i = 0; i < count; i++, pos += 4) {
+				uint32_t bits = in[pos] | (in[pos + 1] << 8) | (in[pos + 2] << 16) | (static_cast<uint32_t>(in[pos + 3]) << 24);
+				values.push_back(static_cast<int>(bits));
+			}
+		} else if(in[0] == DELTA_VARINT) {
+			int64_t previous = 0;
+			for(size_t i = 0; i < count; i++) {
+				previous += unzigzag(getVarint(in, pos));
+				values.push_back(static_cast<int>(previous));
+			}
+		} else if(in[0] == FRAME_OF_REFERENCE) {
+			int64_t minimum = unzigzag(getVarint(in, pos));
+			if(pos >= in.size()) {
+				throw std::runtime_error("Truncated frame-of-reference payload");
+			}
+			int width = in[pos++];
+			uint64_t mask = (width == 64) ? ~0ULL : ((1ULL << width) - 1);
+			uint64_t buffer = 0;
+			int buffered = 0;
+			for(size_t i = 0; i < count; i++) {
+				while(buffered < width) {
+					if(pos >= in.size()) {
+						throw std::runtime_error("Truncated frame-of-reference payload");
+					}
+					buffer |= static_cast<uint64_t>(in[pos++]) << buffered;
+					buffered += 8;
+				}
+				values.push_back(static_cast<int>(minimum + static_cast<int64_t>(buffer & mask)));
+				buffer >>= width;
+				buffered -= width;
+			}
+		} else {
+			throw std::runtime_error("Unknown payload scheme");
+		}
+		return values;
+	}
+};
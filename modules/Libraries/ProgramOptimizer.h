@@ -0,0 +1,207 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <climits>
+#include <algorithm>
+
+/*
+* Rule-based logical optimizer of dataflow programs (schedule + parameters).
+* The rewrites preserve the result under integer semantics (as long as the original program does not overflow):
+*	- Filters are pushed ahead of add/sub and positive mul, rewriting their threshold, so that tuples are dropped earlier
+*	- Adjacent filters are merged into a single "range" predicate: parameter <= value <= upperBound
+*	- Consecutive add/sub are folded, and no-op maps (add 0, sub 0, mul 1, div 1) are removed
+* Operators never cross a changekey (or the final reduce): the values seen at each changekey, and so the
+* routing of the tuples, are left unchanged.
+*/
+class ProgramOptimizer {
+private:
+	std::vector<std::string> schedule;
+	std::vector<int> parameters;
+	std::vector<int> upperBounds;
+	int rewrites;
+
+	static bool isFilter(const std::string& op) {
+		return op == "gt" || op == "lt" || op == "ge" || op == "le" || op == "range";
+	}
+
+	static bool isBoundary(const std::string& op) {
+		return op == "changekey" || op == "reduce";
+	}
+
+	static long long floorDiv(long long a, long long b) {
+		long long q = a / b;
+		return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+	}
+
+	static long long ceilDiv(long long a, long long b) {
+		return -floorDiv(-a, b);
+	}
+
+	static bool fitsInt(long long value) {
+		return value >= INT_MIN && value <= INT_MAX;
+	}
+
+	// Converts a filter to inclusive [lower, upper] bounds, false if it can't be represented
+	static bool toRange(const std::string& op, int parameter, int upperBound, long long& lower, long long& upper) {
+		lower = INT_MIN;
+		upper = INT_MAX;
+		if(op == "gt") lower = (long long)parameter + 1;
+		else if(op == "ge") lower = parameter;
+		else if(op == "lt") upper = (long long)parameter - 1;
+		else if(op == "le") upper = parameter;
+		else if(op == "range") {
+			lower = parameter;
+			upper = upperBound;
+		}
+		return fitsInt(lower) && fitsInt(upper);
+	}
+
+	/*
+	* Rewrites the filter at position i so that it can run before the map at position i - 1.
+	* Returns false if the map is not invertible exactly, or the new threshold overflows.
+	*/
+	bool pushThroughMap(size_t i) {
+		const std::string& map = schedule[i - 1];
+		long long c = parameters[i - 1];
+
+		long long lower, upper;
+		if(!toRange(schedule[i], parameters[i], upperBounds[i], lower, upper)) {
+			return false;
+		}
+		bool lowerBounded = (lower != INT_MIN);
+		bool upperBounded = (upper != INT_MAX);
+
+		// Bounds on the value before the map: lower <= map(x) <= upper
+		if(map == "add" || map == "sub") {
+			long long shift = (map == "add") ? c : -c;
+			if(lowerBounded) lower -= shift;
+			if(upperBounded) upper -= shift;
+		} else if(map == "mul" && c > 0) {
+			if(lowerBounded) lower = ceilDiv(lower, c);
+			if(upperBounded) upper = floorDiv(upper, c);
+		} else {
+			return false;
+		}
+		if((lowerBounded && !fitsInt(lower)) || (upperBounded && !fitsInt(upper))) {
+			return false;
+		}
+
+		// Keep the simplest form of the filter
+		if(lowerBounded && upperBounded) {
+			schedule[i] = "range";
+			parameters[i] = lower;
+			upperBounds[i] = upper;
+		} else if(lowerBounded) {
+			schedule[i] = "ge";
+			parameters[i] = lower;
+			upperBounds[i] = 0;
+		} else {
+			schedule[i] = "le";
+			parameters[i] = upper;
+			upperBounds[i] = 0;
+		}
+
+		std::swap(schedule[i], schedule[i - 1]);
+		std::swap(parameters[i], parameters[i - 1]);
+		std::swap(upperBounds[i], upperBounds[i - 1]);
+		return true;
+	}
+
+	// Merges the adjacent filters at positions i - 1 and i
+	bool mergeFilters(size_t i) {
+		long long lower1, upper1, lower2, upper2;
+		if(!toRange(schedule[i - 1], parameters[i - 1], upperBounds[i - 1], lower1, upper1) ||
+		   !toRange(schedule[i], parameters[i], upperBounds[i], lower2, upper2)) {
+			return false;
+		}
+		schedule[i - 1] = "range";
+		parameters[i - 1] = std::max(lower1, lower2);
+		upperBounds[i - 1] = std::min(upper1, upper2);
+		erase(i);
+		return true;
+	}
+
+	// Folds the consecutive add/sub at positions i - 1 and i into one add
+	bool foldShifts(size_t i) {
+		long long first = (schedule[i - 1] == "add") ? parameters[i - 1] : -(long long)parameters[i - 1];
+		long long second = (schedule[i] == "add") ? parameters[i] : -(long long)parameters[i];
+		if(!fitsInt(first + second)) {
+			return false;
+		}
+		schedule[i - 1] = "add";
+		parameters[i - 1] = first + second;
+		erase(i);
+		return true;
+	}
+
+	static bool isNoOp(const std::string& op, int parameter) {
+		return ((op == "add" || op == "sub") && parameter == 0) || ((op == "mul" || op == "div") && parameter == 1);
+	}
+
+	void erase(size_t i) {
+		schedule.erase(schedule.begin() + i);
+		parameters.erase(parameters.begin() + i);
+		upperBounds.erase(upperBounds.begin() + i);
+	}
+
+	// Applies the first rewrite found, returns false at the fixpoint
+	bool rewriteOnce() {
+		for(size_t i = 0; i < schedule.size(); i++) {
+			if(isNoOp(schedule[i], parameters[i])) {
+				erase(i);
+				return true;
+			}
+			if(i == 0 || isBoundary(schedule[i]) || isBoundary(schedule[i - 1])) {
+				continue;
+			}
+			const std::string& previous = schedule[i - 1];
+			if(isFilter(schedule[i]) && isFilter(previous) && mergeFilters(i)) {
+				return true;
+			}
+			if(isFilter(schedule[i]) && !isFilter(previous) && pushThroughMap(i)) {
+				return true;
+			}
+			if((schedule[i] == "add" || schedule[i] == "sub") && (previous == "add" || previous == "sub") && foldShifts(i)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+public:
+	/*
+	* Parameters:
+	*	- schedule, parameters: the program to optimize
+	*/
+	ProgramOptimizer(const std::vector<std::string>& schedule, const std::vector<int>& parameters)
+	: schedule(schedule), parameters(parameters), upperBounds(schedule.size(), 0), rewrites(0) {
+	}
+
+	/*
+	* Rewrites the program until no rule applies.
+	* Every rewrite either removes an operator or moves a filter earlier, so the process terminates.
+	*/
+	void optimize() {
+		while(rewriteOnce()) {
+			rewrites++;
+		}
+	}
+
+	const std::vector<std::string>& getSchedule() const {
+		return schedule;
+	}
+
+	const std::vector<int>& getParameters() const {
+		return parameters;
+	}
+
+	// Upper bound of each "range" operator (0 for the other operators)
+	const std::vector<int>& getUpperBounds() const {
+		return upperBounds;
+	}
+
+	int getRewrites() const {
+		return rewrites;
+	}
+};
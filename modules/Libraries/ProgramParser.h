@@ -0,0 +1,279 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+/*
+* Dataflow program submitted to the Leader:
+*	- operators: schedule of operations (add, sub, mul, div, gt, lt, ge, le, changekey, reduce)
+*	- parameters: parameter of each operation (0 for changekey/reduce)
+*	- partitioners: partitioner named by each changekey ("" for the other operations, or to use the default)
+*	- partitions: number of workers the input is distributed to (0, when not given: all workers)
+*/
+struct DataflowProgram {
+	std::vector<std::string> operators;
+	std::vector<int> parameters;
+	std::vector<std::string> partitioners;
+	int partitions = 0;
+};
+
+/*
+* Parser of the JSON program files, e.g.:
+*	{
+*		"partitions": 4,
+*		"operators": [
+*			{"op": "gt", "param": 15},
+*			{"op": "changekey", "partitioner": "ring"},
+*			{"op": "mul", "param": 4},
+*			{"op": "reduce"}
+*		]
+*	}
+* Malformed files and invalid programs raise a std::runtime_error describing the problem.
+*/
+class ProgramParser {
+private:
+	// Minimal JSON value: only what program files need
+	struct JsonValue {
+		enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+		bool boolean = false;
+		double number = 0;
+		std::string string;
+		std::vector<JsonValue> array;
+		std::vector<std::pair<std::string, JsonValue>> object;
+
+		const JsonValue* find(const std::string& key) const {
+			for(const auto& member : object) {
+				if(member.first == key) {
+					return &member.second;
+				}
+			}
+			return nullptr;
+		}
+	};
+
+	std::string text;
+	size_t pos;
+
+	[[noreturn]] void fail(const std::string& what) const {
+		// Report the line of the error
+		int line = 1;
+		for(size_t i = 0; i < pos && i < text.size(); i++) {
+			if(text[i] == '\n') line++;
+		}
+		throw std::runtime_error("Program file, line " + std::to_string(line) + ": " + what);
+	}
+
+	void skipSpaces() {
+		while(pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+			pos++;
+		}
+	}
+
+	void expect(char c) {
+		skipSpaces();
+		if(pos >= text.size() || text[pos] != c) {
+			fail(std::string("expected '") + c + "'");
+		}
+		pos++;
+	}
+
+	bool consumeWord(const std::string& word) {
+		if(text.compare(pos, word.size(), word) == 0) {
+			pos += word.size();
+			return true;
+		}
+		return false;
+	}
+
+	std::string parseString() {
+		expect('"');
+		std::string result;
+		while(pos < text.size() && text[pos] != '"') {
+			char c = text[pos++];
+			if(c == '\\') {
+				if(pos >= text.size()) fail("unterminated string");
+				char escaped = text[pos++];
+				switch(escaped) {
+					case 'n': result += '\n'; break;
+					case 't': result += '\t'; break;
+					case 'r': result += '\r'; break;
+					case 'b': result += '\b'; break;
+					case 'f': result += '\f'; break;
+					case 'u': fail("unicode escapes are not supported");
+					default: result += escaped; // \" \\ \/
+				}
+			} else {
+				result += c;
+			}
+		}
+		if(pos >= text.size()) fail("unterminated string");
+		pos++; // Closing quote
+		return result;
+	}
+
+	JsonValue parseValue() {
+		skipSpaces();
+		if(pos >= text.size()) fail("unexpected end of file");
+
+		JsonValue value;
+		char c = text[pos];
+		if(c == '{') {
+			value.type = JsonValue::Object;
+			pos++;
+			skipSpaces();
+			if(pos < text.size() && text[pos] == '}') {
+				pos++;
+				return value;
+			}
+			do {
+				std::string key = parseString();
+				expect(':');
+				value.object.push_back({key, parseValue()});
+				skipSpaces();
+			} while(pos < text.size() && text[pos] == ',' && ++pos);
+			expect('}');
+		} else if(c == '[') {
+			value.type = JsonValue::Array;
+			pos++;
+			skipSpaces();
+			if(pos < text.size() && text[pos] == ']') {
+				pos++;
+				return value;
+			}
+			do {
+				value.array.push_back(parseValue());
+				skipSpaces();
+			} while(pos < text.size() && text[pos] == ',' && ++pos);
+			expect(']');
+		} else if(c == '"') {
+			value.type = JsonValue::String;
+			value.string = parseString();
+		} else if(consumeWord("true")) {
+			value.type = JsonValue::Bool;
+			value.boolean = true;
+		} else if(consumeWord("false")) {
+			value.type = JsonValue::Bool;
+		} else if(consumeWord("null")) {
+			value.type = JsonValue::Null;
+		} else {
+			const char* begin = text.c_str() + pos;
+			char* end = nullptr;
+			value.type = JsonValue::Number;
+			value.number = std::strtod(begin, &end);
+			if(end == begin) fail("unexpected character '" + std::string(1, c) + "'");
+			pos += end - begin;
+		}
+		return value;
+	}
+
+	static bool needsParameter(const std::string& op) {
+		return op == "add" || op == "sub" || op == "mul" || op == "div" || op == "gt" || op == "lt" || op == "ge" || op == "le";
+	}
+
+	// Converts a number to int: non-finite, fractional and out-of-range values are rejected
+	static int toInt(const JsonValue& value, const std::string& field) {
+		if(value.type != JsonValue::Number || !std::isfinite(value.number) || value.number != std::floor(value.number)) {
+			throw std::runtime_error("Program file: '" + field + "' must be an integer");
+		}
+		if(value.number < std::numeric_limits<int>::min() || value.number > std::numeric_limits<int>::max()) {
+			throw std::runtime_error("Program file: '" + field + "' is out of the integer range");
+		}
+		return static_cast<int>(value.number);
+	}
+
+	// Builds and validates the program from the parsed document
+	static DataflowProgram buildProgram(const JsonValue& root) {
+		if(root.type != JsonValue::Object) {
+			throw std::runtime_error("Program file: the root must be an object");
+		}
+
+		DataflowProgram program;
+		if(const JsonValue* partitions = root.find("partitions")) {
+			program.partitions = toInt(*partitions, "partitions");
+			if(program.partitions <= 0) {
+				throw std::runtime_error("Program file: 'partitions' must be positive");
+			}
+		}
+
+		const JsonValue* operators = root.find("operators");
+		if(operators == nullptr || operators->type != JsonValue::Array || operators->array.empty()) {
+			throw std::runtime_error("Program file: 'operators' must be a non-empty array");
+		}
+
+		for(size_t i = 0; i < operators->array.size(); i++) {
+			const JsonValue& entry = operators->array[i];
+			const JsonValue* op = entry.find("op");
+			if(entry.type != JsonValue::Object || op == nullptr || op->type != JsonValue::String) {
+				throw std::runtime_error("Program file: operator " + std::to_string(i) + " has no 'op' name");
+			}
+
+			const std::string& name = op->string;
+			const JsonValue* param = entry.find("param");
+			int parameter = 0;
+			if(needsParameter(name)) {
+				if(param == nullptr) {
+					throw std::runtime_error("Program file: operator " + std::to_string(i) + " (" + name + ") needs a 'param'");
+				}
+				parameter = toInt(*param, "param");
+			} else if(name != "changekey" && name != "reduce") {
+				throw std::runtime_error("Program file: unknown operator '" + name + "'");
+			}
+
+			std::string partitioner;
+			if(const JsonValue* partitionerName = entry.find("partitioner")) {
+				if(name != "changekey" || partitionerName->type != JsonValue::String) {
+					throw std::runtime_error("Program file: operator " + std::to_string(i) + ": 'partitioner' must be a name, on changekey only");
+				}
+				partitioner = partitionerName->string;
+			}
+
+			if(name == "div" && parameter == 0) {
+				throw std::runtime_error("Program file: operator " + std::to_string(i) + " divides by zero");
+			}
+			if(name == "reduce" && i != operators->array.size() - 1) {
+				throw std::runtime_error("Program file: reduce is only allowed as the last operator");
+			}
+
+			program.operators.push_back(name);
+			program.parameters.push_back(parameter);
+			program.partitioners.push_back(partitioner);
+		}
+		return program;
+	}
+
+public:
+	ProgramParser() : pos(0) {
+	}
+
+	/*
+	* Parses a program from its JSON text.
+	*/
+	DataflowProgram parse(const std::string& json) {
+		text = json;
+		pos = 0;
+		JsonValue root = parseValue();
+		skipSpaces();
+		if(pos != text.size()) fail("unexpected content after the program");
+		return buildProgram(root);
+	}
+
+	/*
+	* Parses a program from a JSON file.
+	*/
+	DataflowProgram parseFile(const std::string& fileName) {
+		std::ifstream file(fileName, std::ios::binary);
+		if(!file.is_open()) {
+			throw std::runtime_error("Can't open program file: " + fileName);
+		}
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+		return parse(buffer.str());
+	}
+};
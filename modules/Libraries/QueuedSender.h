@@ -0,0 +1,137 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <omnetpp.h>
+
+// Kind of the self-messages that end a transmission on a busy gate
+#define TRANSMIT_TIMER_KIND -1
+
+/*
+* Base of the modules sending over rate-limited channels (datarate channels):
+* a packet sent while the channel of its gate is busy waits in the FIFO queue of the gate,
+* and is transmitted as soon as the channel is free. Gates without a datarate channel send immediately.
+* The length of the queues and the queueing delays are emitted on the "linkQueueLength" and "queueingDelay" signals
+* (declared by every module using it).
+*/
+class QueuedSender : public omnetpp::cSimpleModule {
+private:
+	struct GateQueue {
+		int gateIndex;
+		std::deque<std::pair<omnetpp::cPacket*, omnetpp::simtime_t>> packets; // Packet, enqueue time
+		omnetpp::cMessage* timer;
+	};
+	std::vector<GateQueue*> gateQueues; // Indexed by output gate, created on first use
+
+	long long queuedPackets; // Packets that had to wait for the channel
+	omnetpp::simtime_t totalQueueingDelay;
+	size_t peakQueueLength;
+
+	GateQueue* queueOf(int gateIndex) {
+		if(gateIndex >= gateQueues.size()) {
+			gateQueues.resize(gateIndex + 1, nullptr);
+		}
+		if(gateQueues[gateIndex] == nullptr) {
+			GateQueue* queue = new GateQueue();
+			queue->gateIndex = gateIndex;
+			queue->timer = new omnetpp::cMessage("TransmitQueue", TRANSMIT_TIMER_KIND);
+			queue->timer->setContextPointer(queue);
+			gateQueues[gateIndex] = queue;
+		}
+		return gateQueues[gateIndex];
+	}
+
+	static omnetpp::simsignal_t linkQueueLengthSignal() {
+		static omnetpp::simsignal_t signal = registerSignal("linkQueueLength");
+		return signal;
+	}
+
+	static omnetpp::simsignal_t queueingDelaySignal() {
+		static omnetpp::simsignal_t signal = registerSignal("queueingDelay");
+		return signal;
+	}
+
+	// Sends the packets at the front of the queue while the channel is free
+	void transmitQueued(GateQueue* queue) {
+		omnetpp::cChannel* channel = gate("out", queue->gateIndex)->findTransmissionChannel();
+		while(!queue->packets.empty() && (channel == nullptr || !channel->isBusy())) {
+			omnetpp::simtime_t delay = omnetpp::simTime() - queue->packets.front().second;
+			totalQueueingDelay += delay;
+			emit(queueingDelaySignal(), delay);
+			send(queue->packets.front().first, "out", queue->gateIndex);
+			queue->packets.pop_front();
+		}
+		emit(linkQueueLengthSignal(), (long)queue->packets.size());
+		if(!queue->packets.empty()) {
+			scheduleAt(channel->getTransmissionFinishTime(), queue->timer);
+		}
+	}
+
+protected:
+	QueuedSender() : queuedPackets(0), totalQueueingDelay(0), peakQueueLength(0) {
+	}
+
+	virtual ~QueuedSender() {
+		for(GateQueue* queue : gateQueues) {
+			if(queue == nullptr) continue;
+			for(auto& entry : queue->packets) {
+				delete entry.first;
+			}
+			cancelAndDelete(queue->timer);
+			delete queue;
+		}
+	}
+
+	/*
+	* Sends a packet on the output gate, or queues it behind the packets waiting for the channel.
+	*
+	* Parameters:
+	*	- packet: Packet to send
+	*	- gateIndex: Index of the "out" gate
+	*/
+	void sendQueued(omnetpp::cPacket* packet, int gateIndex) {
+		omnetpp::cChannel* channel = gate("out", gateIndex)->findTransmissionChannel();
+		bool queueEmpty = gateIndex >= gateQueues.size() || gateQueues[gateIndex] == nullptr || gateQueues[gateIndex]->packets.empty();
+		if(queueEmpty && (channel == nullptr || !channel->isBusy())) {
+			send(packet, "out", gateIndex);
+			return;
+		}
+
+		GateQueue* queue = queueOf(gateIndex);
+		queue->packets.push_back({packet, omnetpp::simTime()});
+		queuedPackets++;
+		peakQueueLength = std::max(peakQueueLength, queue->packets.size());
+		emit(linkQueueLengthSignal(), (long)queue->packets.size());
+		if(!queue->timer->isScheduled()) {
+			scheduleAt(channel->getTransmissionFinishTime(), queue->timer);
+		}
+	}
+
+	/*
+	* Handles the end of a transmission on a busy gate.
+	*
+	* Returns:
+	*	- true if the message was a transmit timer (and has been handled)
+	*/
+	bool handleTransmitTimer(omnetpp::cMessage* msg) {
+		if(!msg->isSelfMessage() || msg->getKind() != TRANSMIT_TIMER_KIND) {
+			return false;
+		}
+		transmitQueued(static_cast<GateQueue*>(msg->getContextPointer()));
+		return true;
+	}
+
+	long long getQueuedPackets() const {
+		return queuedPackets;
+	}
+
+	omnetpp::simtime_t getTotalQueueingDelay() const {
+		return totalQueueingDelay;
+	}
+
+	size_t getPeakQueueLength() const {
+		return peakQueueLength;
+	}
+};
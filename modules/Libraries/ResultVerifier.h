@@ -0,0 +1,274 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <queue>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+
+/*
+* Order-independent digest of a multiset of values: count, sum, and sum of a 64-bit mix of each value.
+* Two equal multisets always have equal digests; different ones collide with negligible probability.
+*/
+struct MultisetDigest {
+	long long count = 0;
+	long long sum = 0;
+	uint64_t hash = 0;
+
+	// splitmix64 finalizer
+	static uint64_t mix(int value) {
+		uint64_t z = static_cast<uint64_t>(static_cast<int64_t>(value)) + 0x9e3779b97f4a7c15ULL;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	void add(int value) {
+		count++;
+		sum += value;
+		hash += mix(value);
+	}
+
+	void merge(const MultisetDigest& other) {
+		count += other.count;
+		sum += other.sum;
+		hash += other.hash;
+	}
+
+	bool operator==(const MultisetDigest& other) const {
+		return count == other.count && sum == other.sum && hash == other.hash;
+	}
+};
+
+/*
+* External sort of a stream of values bounded by runSize values in memory:
+* values are collected in sorted runs on disk, then merged with one open file per run.
+*/
+class ExternalSorter {
+private:
+	std::string prefix;
+	size_t runSize;
+	std::vector<int> buffer;
+	std::vector<std::string> runFiles;
+
+	// Merge state
+	std::vector<std::unique_ptr<std::ifstream>> runs;
+	std::priority_queue<std::pair<int, size_t>, std::vector<std::pair<int, size_t>>, std::greater<std::pair<int, size_t>>> heads;
+
+	void flushRun() {
+		if(buffer.empty()) {
+			return;
+		}
+		std::sort(buffer.begin(), buffer.end());
+		std::string runFile = prefix + "_run" + std::to_string(runFiles.size()) + ".csv";
+		std::ofstream file(runFile);
+		for(int value : buffer) {
+			file << value << '\n';
+		}
+		file.close();
+		runFiles.push_back(runFile);
+		buffer.clear();
+	}
+
+	void pushHead(size_t run) {
+		int value;
+		if(*runs[run] >> value) {
+			heads.push({value, run});
+		}
+	}
+
+public:
+	/*
+	* Parameters:
+	*	- prefix: path prefix of the run files
+	*	- runSize: maximum number of values sorted in memory
+	*/
+	ExternalSorter(const std::string& prefix, size_t runSize) : prefix(prefix), runSize(std::max<size_t>(runSize, 1)) {
+	}
+
+	~ExternalSorter() {
+		clear();
+	}
+
+	void add(int value) {
+		buffer.push_back(value);
+		if(buffer.size() >= runSize) {
+			flushRun();
+		}
+	}
+
+	// Spills the values of a file (one value per line) as sorted runs
+	void addFile(const std::string& fileName) {
+		std::ifstream file(fileName);
+		int value;
+		while(file >> value) {
+			add(value);
+		}
+	}
+
+	// Starts the merge of the runs, values are then returned in order by next()
+	void startMerge() {
+		flushRun();
+		runs.clear();
+		heads = {};
+		for(size_t i = 0; i < runFiles.size(); i++) {
+			runs.push_back(std::unique_ptr<std::ifstream>(new std::ifstream(runFiles[i])));
+			pushHead(i);
+		}
+	}
+
+	// Returns false when all values have been returned
+	bool next(int& value) {
+		if(heads.empty()) {
+			return false;
+		}
+		value = heads.top().first;
+		size_t run = heads.top().second;
+		heads.pop();
+		pushHead(run);
+		return true;
+	}
+
+	// Removes the run files
+	void clear() {
+		runs.clear();
+		heads = {};
+		for(const auto& runFile : runFiles) {
+			std::error_code ec;
+			std::filesystem::remove(runFile, ec);
+		}
+		runFiles.clear();
+		buffer.clear();
+	}
+};
+
+/*
+* Verifies the results of a job without holding them in memory:
+*	- "hash": the expected values and the latest result of each worker are reduced to multiset digests, updated as they arrive
+*	- "exact": the expected values and the workers' results are spilled to disk, externally sorted and compared value by value
+*/
+class ResultVerifier {
+private:
+	bool exact;
+	std::string folder;
+	size_t runSize;
+
+	MultisetDigest expected;
+	std::vector<MultisetDigest> workerDigests;
+	ExternalSorter expectedSorter;
+
+	std::string workerFile(int worker) const {
+		return folder + "worker_" + std::to_string(worker) + ".csv";
+	}
+
+public:
+	/*
+	* Parameters:
+	*	- exact: whether to spill the values for an exact comparison
+	*	- folder: folder of the spill files
+	*	- numWorkers: number of workers reporting results
+	*	- runSize: maximum number of values held in memory by the exact comparison
+	*/
+	ResultVerifier(bool exact, const std::string& folder, int numWorkers, size_t runSize)
+	: exact(exact), folder(folder), runSize(runSize), workerDigests(numWorkers), expectedSorter(folder + "expected", runSize) {
+		if(exact) {
+			std::filesystem::create_directories(folder);
+		}
+	}
+
+	// Adds a value of the expected result
+	void addExpected(int value) {
+		expected.add(value);
+		if(exact) {
+			expectedSorter.add(value);
+		}
+	}
+
+	/*
+	* Replaces the result reported by a worker (each report carries the whole partial result of the worker).
+	*
+	* Parameters:
+	*	- worker: ID of the worker
+	*	- count: number of values
+	*	- valueAt: accessor of the i-th value
+	*/
+	template <typename Accessor>
+	void setWorkerResult(int worker, int count, Accessor valueAt) {
+		MultisetDigest digest;
+		std::ofstream file;
+		if(exact) {
+			file.open(workerFile(worker), std::ios::trunc);
+		}
+		for(int i = 0; i < count; i++) {
+			int value = valueAt(i);
+			digest.add(value);
+			if(exact) {
+				file << value << '\n';
+			}
+		}
+		workerDigests[worker] = digest;
+	}
+
+	// Drops the result of a worker (e.g. folded into another worker's result)
+	void clearWorkerResult(int worker) {
+		setWorkerResult(worker, 0, [](int) { return 0; });
+	}
+
+	/*
+	* Compares the workers' results with the expected result.
+	*
+	* Parameters:
+	*	- report: filled with a description of the outcome
+	*
+	* Returns:
+	*	- true if the results match
+	*/
+	bool verify(std::string& report) {
+		MultisetDigest actual;
+		for(const auto& digest : workerDigests) {
+			actual.merge(digest);
+		}
+
+		std::ostringstream out;
+		out << "expected " << expected.count << " values (sum " << expected.sum << "), received " << actual.count << " values (sum " << actual.sum << ")";
+		if(!exact) {
+			out << (expected == actual ? ", digests match" : ", digests differ");
+			report = out.str();
+			return expected == actual;
+		}
+
+		// Exact comparison: merge the sorted runs of both sides
+		ExternalSorter actualSorter(folder + "actual", runSize);
+		for(int i = 0; i < workerDigests.size(); i++) {
+			actualSorter.addFile(workerFile(i));
+		}
+		expectedSorter.startMerge();
+		actualSorter.startMerge();
+
+		long long position = 0;
+		int expectedValue, actualValue;
+		bool hasExpected = expectedSorter.next(expectedValue);
+		bool hasActual = actualSorter.next(actualValue);
+		while(hasExpected && hasActual && expectedValue == actualValue) {
+			position++;
+			hasExpected = expectedSorter.next(expectedValue);
+			hasActual = actualSorter.next(actualValue);
+		}
+
+		bool match = !hasExpected && !hasActual;
+		if(!match) {
+			out << ", first difference at sorted position " << position << ": expected ";
+			out << (hasExpected ? std::to_string(expectedValue) : std::string("nothing")) << ", received ";
+			out << (hasActual ? std::to_string(actualValue) : std::string("nothing"));
+		} else {
+			out << ", all values match";
+		}
+		report = out.str();
+		actualSorter.clear();
+		return match;
+	}
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <stdexcept>
+
+// Network addresses: the Leader is address 0, worker i is address i + 1
+#define LEADER_ADDRESS 0
+
+inline int workerAddress(int workerId) {
+	return workerId + 1;
+}
+
+inline int addressToWorker(int address) {
+	return address - 1;
+}
+
+/*
+* Routing layer of the Leader and the Workers: maps a destination address to an output gate.
+*	- "mesh": every node has a direct link to every other node.
+*	  The Leader's gate i leads to worker i; a worker's gate 0 leads to the Leader, followed by the other workers in order.
+*	- "star", "rack": every node has a single link (gate 0) to its switch, which routes by destination address.
+*	- "node": job module of a worker or leader node running several jobs, with a single link (gate 0) to the
+*	  dispatcher of the node, which routes with the node's address and the network topology.
+*/
+class Router {
+private:
+	bool mesh;
+	int selfAddress;
+
+public:
+	Router() : mesh(true), selfAddress(LEADER_ADDRESS) {
+	}
+
+	/*
+	* Parameters:
+	*	- topology: "mesh", "star", "rack" or "node"
+	*	- selfAddress: address of the node using the router
+	*/
+	Router(const std::string& topology, int selfAddress) : mesh(topology == "mesh"), selfAddress(selfAddress) {
+		if(topology != "mesh" && topology != "star" && topology != "rack" && topology != "node") {
+			throw std::runtime_error("Unknown topology: " + topology);
+		}
+	}
+
+	// Returns the output gate index towards the destination address
+	int outputGate(int destAddress) const {
+		if(!mesh) {
+			return 0;
+		}
+		if(selfAddress == LEADER_ADDRESS) {
+			return addressToWorker(destAddress);
+		}
+		if(destAddress == LEADER_ADDRESS) {
+			return 0;
+		}
+		// Links to the other workers follow the Leader's link, skipping this worker
+		return (destAddress < selfAddress) ? destAddress : destAddress - 1;
+	}
+
+	/*
+	* Returns the output port of a switch towards the destination address.
+	*
+	* Parameters:
+	*	- role: "star" (port 0 to the Leader, port i + 1 to worker i),
+	*	  "spine" (port 0 to the Leader, port r + 1 to rack r),
+	*	  "tor" (port 0 up to the spine, port j + 1 to the j-th worker of the rack)
+	*	- rack: index of the rack of a "tor" switch
+	*	- workersPerRack: number of workers per rack
+	*	- destAddress: destination address of the message
+	*/
+	static int switchPort(const std::string& role, int rack, int workersPerRack, int destAddress) {
+		if(role == "star") {
+			return destAddress;
+		}
+		if(destAddress == LEADER_ADDRESS) {
+			return 0;
+		}
+		int worker = addressToWorker(destAddress);
+		if(role == "spine") {
+			return 1 + worker / workersPerRack;
+		}
+		if(worker / workersPerRack == rack) {
+			return 1 + worker % workersPerRack;
+		}
+		return 0;
+	}
+};
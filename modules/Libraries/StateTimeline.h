@@ -0,0 +1,199 @@
+#pragma once
+
+#include <map>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+
+// States of a worker in its timeline
+enum WorkerState {
+	STATE_IDLE, // Nothing to elaborate: waiting for ChangeKey data, or for the termination protocol
+	STATE_PROCESSING, // Applying the operators (and the final phase of the elaboration)
+	STATE_LOADING, // Loading a batch
+	STATE_WAITING_INSERT, // Blocked on the ACK of a DataInsert (peer: the receiver)
+	STATE_WAITING_CREDIT, // ChangeKeys to send, but no insert credits
+	STATE_WAITING_INPUT, // Local data exhausted before the end of the input
+	STATE_RESTARTING, // Reloading its state after a failure
+	STATE_FAILED, // Crashed, or partition reassigned
+	STATE_FINISHED, // End of the job
+	STATE_COUNT
+};
+
+inline const char* workerStateName(int state) {
+	static const char* names[STATE_COUNT] = {"idle", "processing", "loading", "waitingInsert", "waitingCredit", "waitingInput", "restarting", "failed", "finished"};
+	return state >= 0 && state < STATE_COUNT ? names[state] : "unknown";
+}
+
+// Interval of a timeline in a single state
+struct StateSegment {
+	double start;
+	double end;
+	int state;
+	int peer; // Worker waited for (STATE_WAITING_INSERT), else -1
+};
+
+/*
+* State timeline of a worker: one segment per change of state, consecutive entries in the same state are merged.
+* The current state is open until the next change (or the end of the timeline).
+*/
+class StateTimeline {
+private:
+	std::vector<StateSegment> segments; // Closed segments
+	int state;
+	int peer;
+	double since;
+
+public:
+	StateTimeline() : state(STATE_IDLE), peer(-1), since(0) {}
+
+	/*
+	* Enters a state, closing the current one.
+	*
+	* Parameters:
+	*	- newState: state entered
+	*	- now: time of the change (s)
+	*	- newPeer: worker waited for, -1 if none
+	*/
+	void enter(int newState, double now, int newPeer = -1) {
+		if(newState == state && newPeer == peer) {
+			return;
+		}
+		if(now > since) {
+			segments.push_back({since, now, state, peer});
+		}
+		state = newState;
+		peer = newPeer;
+		since = now;
+	}
+
+	// Returns the segments up to the specified time (s), the current state included
+	std::vector<StateSegment> getSegments(double now) const {
+		std::vector<StateSegment> all = segments;
+		if(now > since) {
+			all.push_back({since, now, state, peer});
+		}
+		return all;
+	}
+
+	// Returns the time spent in each state up to the specified time (s)
+	std::vector<double> timeInStates(double now) const {
+		std::vector<double> times(STATE_COUNT, 0);
+		for(const StateSegment& segment : getSegments(now)) {
+			times[segment.state] += segment.end - segment.start;
+		}
+		return times;
+	}
+
+	size_t getSize() const {
+		return segments.size() + 1;
+	}
+};
+
+// Module exposing the state timeline of a worker to the Leader, at the end of the run
+class TimelineSource {
+public:
+	virtual ~TimelineSource() {
+	}
+
+	virtual const StateTimeline& getTimeline() const = 0;
+};
+
+// Share of the critical path of a job spent by a worker in a state (waiting for peer)
+struct CriticalPathEntry {
+	int worker;
+	int state;
+	int peer;
+	double time;
+};
+
+/*
+* Critical path of a job through the timelines of its workers, walked back from the end of the job:
+* the time of the worker on the path is charged to its state, and a worker that has nothing to do (idle, finished,
+* failed) hands the path over to a worker busy at that time (the one busy the longest before it), as its work is
+* what the idle worker waits for. With no worker busy, the time back to the last busy worker is charged to the
+* state of the current worker.
+* Returns the entries by decreasing time.
+*
+* Parameters:
+*	- timelines: segments of each worker, sorted by time
+*	- start, end: bounds of the job (s)
+*/
+inline std::vector<CriticalPathEntry> criticalPath(const std::vector<std::vector<StateSegment>>& timelines, double start, double end) {
+	auto busy = [](int state) { return state != STATE_IDLE && state != STATE_FINISHED && state != STATE_FAILED; };
+
+	// Segment of a worker covering the instant just before t
+	auto segmentAt = [&timelines](int worker, double t) -> const StateSegment* {
+		const std::vector<StateSegment>& segments = timelines[worker];
+		auto it = std::lower_bound(segments.begin(), segments.end(), t, [](const StateSegment& segment, double time) { return segment.end < time; });
+		if(it == segments.end() || it->start >= t) {
+			return nullptr;
+		}
+		return &*it;
+	};
+
+	// The path ends on the worker busy the latest
+	int current = -1;
+	double latest = start;
+	std::vector<std::pair<double, int>> busyEnds; // End of every busy segment, and its worker
+	for(int w = 0; w < (int)timelines.size(); w++) {
+		for(const StateSegment& segment : timelines[w]) {
+			if(!busy(segment.state)) {
+				continue;
+			}
+			busyEnds.push_back({segment.end, w});
+			if(std::min(segment.end, end) > latest) {
+				latest = std::min(segment.end, end);
+				current = w;
+			}
+		}
+	}
+	std::sort(busyEnds.begin(), busyEnds.end());
+	if(current == -1) {
+		return {};
+	}
+
+	std::map<std::tuple<int, int, int>, double> charged;
+	double t = end;
+	while(t > start) {
+		const StateSegment* segment = segmentAt(current, t);
+		if(segment == nullptr || !busy(segment->state)) {
+			// Hand over to the worker busy the longest before t
+			int next = -1;
+			double earliest = t;
+			for(int w = 0; w < (int)timelines.size(); w++) {
+				const StateSegment* other = (w == current) ? nullptr : segmentAt(w, t);
+				if(other != nullptr && busy(other->state) && other->start < earliest) {
+					earliest = other->start;
+					next = w;
+				}
+			}
+			if(next != -1) {
+				current = next;
+				continue;
+			}
+		}
+		double from = (segment != nullptr) ? std::max(segment->start, start) : start;
+		if(segment == nullptr || !busy(segment->state)) {
+			// Nobody busy: the idle time goes back to the end of the last busy segment of the others
+			auto it = std::lower_bound(busyEnds.begin(), busyEnds.end(), std::make_pair(t, -1));
+			while(it != busyEnds.begin()) {
+				--it;
+				if(it->second != current) {
+					from = std::max(from, it->first);
+					break;
+				}
+			}
+		}
+		int state = (segment != nullptr) ? segment->state : STATE_IDLE;
+		int peer = (segment != nullptr) ? segment->peer : -1;
+		charged[std::make_tuple(current, state, peer)] += t - from;
+		t = from;
+	}
+
+	std::vector<CriticalPathEntry> entries;
+	for(const auto& entry : charged) {
+		entries.push_back({std::get<0>(entry.first), std::get<1>(entry.first), std::get<2>(entry.first), entry.second});
+	}
+	std::sort(entries.begin(), entries.end(), [](const CriticalPathEntry& a, const CriticalPathEntry& b) { return a.time > b.time; });
+	return entries;
+}
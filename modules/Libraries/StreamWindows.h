@@ -0,0 +1,222 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+// Slice of the stream processed at a time: the panes of a window are combined into its result
+struct StreamPane {
+	long long index;
+	std::vector<int> values;
+	double arrivalSum = 0; // Sum of the arrival times of the tuples (s)
+	double lastArrival = 0;
+};
+
+// Result of a window, with its latency from the closing of the window to the emission of the result
+struct WindowResult {
+	long long index;
+	double start; // Window bounds: event time (s), or tuple sequence numbers of count windows
+	double end;
+	long long tuples;
+	long long result;
+	long long expected;
+	double latency; // From the end of the window (time windows) or its last tuple (count windows)
+	double tupleLatency; // Mean, from the arrival of each tuple
+};
+
+/*
+* Tumbling and sliding windows over a stream of tuples, by event time or by tuple count.
+* The stream is cut in panes, the greatest slices shared by all the windows (gcd of size and slide):
+* each pane is reduced once, and the result of a window is the sum of the reduce of its panes.
+*	- time windows: a pane is closed once the watermark passes its end; tuples of a closed pane are late, and dropped
+*	- count windows: a pane is closed once it holds its tuples (in arrival order)
+* Panes are handed out in order, and their results must be completed in the same order.
+*/
+class StreamWindows {
+private:
+	struct PaneResult {
+		long long tuples;
+		long long result;
+		long long expected;
+		double arrivalSum;
+		double lastArrival;
+	};
+
+	bool countWindows;
+	double size;
+	double slide;
+	long long paneLength; // ms (time windows) or tuples (count windows)
+	long long windowPanes; // Panes per window
+	long long slidePanes; // Panes between the starts of consecutive windows
+
+	std::map<long long, StreamPane> openPanes;
+	std::deque<StreamPane> closedPanes;
+	long long nextPane; // First pane not closed yet
+	long long tuples; // Tuples received (sequence number of the next one)
+	long long lateTuples;
+	std::map<long long, PaneResult> completed; // Panes still part of a window to emit
+
+	// Length in pane units: ms of time windows, tuples of count windows
+	long long units(double length) const {
+		return std::llround(countWindows ? length : length * 1000);
+	}
+
+	StreamPane& pane(long long index) {
+		StreamPane& pane = openPanes[index];
+		pane.index = index;
+		return pane;
+	}
+
+	void close(long long index) {
+		auto it = openPanes.find(index);
+		if(it == openPanes.end()) {
+			closedPanes.push_back(StreamPane{index});
+		} else {
+			closedPanes.push_back(std::move(it->second));
+			openPanes.erase(it);
+		}
+	}
+
+public:
+	/*
+	* Parameters:
+	*	- countWindows: windows of a number of tuples, instead of a duration of event time
+	*	- size: length of a window (s, or tuples)
+	*	- slide: distance between the starts of consecutive windows (0: tumbling windows)
+	*/
+	StreamWindows(bool countWindows = false, double size = 1, double slide = 0)
+	: countWindows(countWindows), size(size), slide(slide > 0 ? slide : size), nextPane(0), tuples(0), lateTuples(0) {
+		long long sizeUnits = units(this->size);
+		long long slideUnits = units(this->slide);
+		if(sizeUnits <= 0 || slideUnits <= 0) {
+			throw std::runtime_error(countWindows ? "Count windows need at least one tuple" : "Time windows need at least 1 ms");
+		}
+		paneLength = std::gcd(sizeUnits, slideUnits);
+		windowPanes = sizeUnits / paneLength;
+		slidePanes = slideUnits / paneLength;
+	}
+
+	/*
+	* Adds a tuple of the stream to its pane.
+	*
+	* Parameters:
+	*	- value: value of the tuple
+	*	- eventTime: event time of the tuple (s, ignored by count windows)
+	*	- arrival: arrival time of the tuple (s)
+	*
+	* Returns:
+	*	- false if the tuple is late (its pane is already closed), and dropped
+	*/
+	bool add(int value, double eventTime, double arrival) {
+		long long index = countWindows ? tuples / paneLength : (long long)std::floor(eventTime * 1000 / paneLength);
+		tuples++;
+		if(index < nextPane) {
+			lateTuples++;
+			return false;
+		}
+		StreamPane& target = pane(index);
+		target.values.push_back(value);
+		target.arrivalSum += arrival;
+		target.lastArrival = arrival;
+
+		// A count pane is complete with its last tuple
+		while(countWindows && openPanes.count(nextPane) && openPanes[nextPane].values.size() == paneLength) {
+			close(nextPane++);
+		}
+		return true;
+	}
+
+	// Closes the time panes that end at or before the watermark (s)
+	void advanceWatermark(double watermark) {
+		if(countWindows) {
+			return;
+		}
+		while((nextPane + 1) * paneLength <= watermark * 1000) {
+			close(nextPane++);
+		}
+	}
+
+	// End of the stream: closes every pane holding tuples, the empty ones in between included
+	void closeAll() {
+		while(!openPanes.empty()) {
+			close(nextPane++);
+		}
+	}
+
+	bool hasClosedPane() const {
+		return !closedPanes.empty();
+	}
+
+	// Removes the next closed pane, in stream order
+	StreamPane nextClosedPane() {
+		StreamPane next = std::move(closedPanes.front());
+		closedPanes.pop_front();
+		return next;
+	}
+
+	/*
+	* Records the reduce of a pane, and returns the windows that it completes.
+	*
+	* Parameters:
+	*	- pane: the pane, as handed out by nextClosedPane
+	*	- result, expected: reduce of the pane computed by the workers, and by the reference program
+	*	- now: emission time of the results (s)
+	*/
+	std::vector<WindowResult> completePane(const StreamPane& pane, long long result, long long expected, double now) {
+		completed[pane.index] = PaneResult{(long long)pane.values.size(), result, expected, pane.arrivalSum, pane.lastArrival};
+
+		// The window that ends with this pane, if any: windows start on multiples of the slide
+		std::vector<WindowResult> windows;
+		long long first = pane.index + 1 - windowPanes;
+		if(first >= 0 && first % slidePanes == 0) {
+			WindowResult window{first / slidePanes, 0, 0, 0, 0, 0, 0, 0};
+			double arrivalSum = 0;
+			double lastArrival = 0;
+			for(long long i = first; i <= pane.index; i++) {
+				auto it = completed.find(i);
+				if(it == completed.end()) {
+					continue;
+				}
+				window.tuples += it->second.tuples;
+				window.result += it->second.result;
+				window.expected += it->second.expected;
+				arrivalSum += it->second.arrivalSum;
+				if(it->second.tuples > 0) {
+					lastArrival = it->second.lastArrival;
+				}
+			}
+			double unit = countWindows ? 1 : 0.001;
+			window.start = first * paneLength * unit;
+			window.end = (pane.index + 1) * paneLength * unit;
+			window.latency = now - (countWindows ? lastArrival : window.end);
+			window.tupleLatency = window.tuples > 0 ? now - arrivalSum / window.tuples : 0;
+			windows.push_back(window);
+		}
+
+		// Panes before the next window are no longer needed
+		if(first >= 0) {
+			long long keepFrom = (first / slidePanes + 1) * slidePanes;
+			completed.erase(completed.begin(), completed.lower_bound(keepFrom));
+		}
+		return windows;
+	}
+
+	long long getPaneLength() const {
+		return paneLength;
+	}
+
+	long long getTuples() const {
+		return tuples;
+	}
+
+	long long getLateTuples() const {
+		return lateTuples;
+	}
+
+	bool isCountWindows() const {
+		return countWindows;
+	}
+};
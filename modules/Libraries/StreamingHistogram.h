@@ -0,0 +1,94 @@
+#pragma once
+
+#include <map>
+#include <cmath>
+#include <algorithm>
+
+/*
+* Histogram of non-negative values in logarithmic buckets: SUB_BUCKETS buckets per power of two, created as values
+* fall in them. Memory is bounded by the range of the values, not their number, and quantiles are estimated
+* within the width of a bucket (about 3% of the value).
+*/
+class StreamingHistogram {
+public:
+	static const int SUB_BUCKETS = 16;
+
+private:
+	std::map<int, long long> buckets; // Bucket key (exponent * SUB_BUCKETS + sub-bucket), values
+	long long zeros; // Values <= 0
+	long long count;
+	double sum;
+	double minimum;
+	double maximum;
+
+	static int key(double value) {
+		int exponent;
+		double mantissa = std::frexp(value, &exponent); // [0.5, 1)
+		int sub = std::min(static_cast<int>((mantissa - 0.5) * 2 * SUB_BUCKETS), SUB_BUCKETS - 1);
+		return exponent * SUB_BUCKETS + sub;
+	}
+
+	static double lowerBound(int key) {
+		int exponent = (key >= 0) ? key / SUB_BUCKETS : -((-key + SUB_BUCKETS - 1) / SUB_BUCKETS);
+		int sub = key - exponent * SUB_BUCKETS;
+		return std::ldexp(0.5 + 0.5 * sub / SUB_BUCKETS, exponent);
+	}
+
+public:
+	StreamingHistogram() : zeros(0), count(0), sum(0), minimum(0), maximum(0) {}
+
+	void collect(double value) {
+		if(count == 0 || value < minimum) minimum = value;
+		if(count == 0 || value > maximum) maximum = value;
+		count++;
+		sum += value;
+		if(value <= 0) {
+			zeros++;
+			return;
+		}
+		buckets[key(value)]++;
+	}
+
+	/*
+	* Returns the estimated q-quantile: the middle of the bucket holding it, within [min, max].
+	*
+	* Parameters:
+	*	- q: quantile, in [0, 1]
+	*/
+	double quantile(double q) const {
+		if(count == 0) {
+			return 0;
+		}
+		long long rank = static_cast<long long>(std::ceil(q * count));
+		rank = std::max(rank, 1LL);
+		if(rank <= zeros) {
+			return minimum;
+		}
+		long long seen = zeros;
+		for(const auto& bucket : buckets) {
+			seen += bucket.second;
+			if(seen >= rank) {
+				double middle = (lowerBound(bucket.first) + lowerBound(bucket.first + 1)) / 2;
+				return std::min(std::max(middle, minimum), maximum);
+			}
+		}
+		return maximum;
+	}
+
+	long long getCount() const {
+		return count;
+	}
+
+	double getMean() const {
+		return count > 0 ? sum / count : 0;
+	}
+
+	double getMax() const {
+		return maximum;
+	}
+
+	// Buckets in use (the memory of the histogram)
+	size_t getBuckets() const {
+		return buckets.size() + 1;
+	}
+};
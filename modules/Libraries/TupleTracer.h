@@ -0,0 +1,134 @@
+#pragma once
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+// Trace of a sampled tuple, carried with it through the steps of the workers and its ChangeKey hops
+struct TupleTrace {
+	double origin = -1; // Time the tuple was read from the input (s), -1: not traced
+	int hops = 0; // ChangeKey hops: times the tuple went through the backlog of a receiver (possibly the sender itself)
+	double backlogWait = 0; // Time spent in the ChangeKey backlogs (s)
+	double enqueued = 0; // Time the tuple entered its current backlog (s)
+
+	bool traced() const {
+		return origin >= 0;
+	}
+
+	// Trace of the tuple entering the backlog of a ChangeKey receiver at the specified time (s)
+	TupleTrace enterBacklog(double now) const {
+		TupleTrace next = *this;
+		next.hops++;
+		next.enqueued = now;
+		return next;
+	}
+
+	// Loaded from the backlog at the specified time (s): returns the time waited in it
+	double leaveBacklog(double now) {
+		backlogWait += now - enqueued;
+		return now - enqueued;
+	}
+};
+
+/*
+* Traces of the tuples of the batch in elaboration, in queues parallel to the schedule steps of the worker:
+* every tuple taken from (or pushed to) a step must be taken from (or forwarded to) the same step of the tracer.
+* Tuples without a trace (not sampled, recovered from the files, speculative or reassigned batches) are
+* represented by an untraced entry, or are missing at the back of a queue.
+* The traces of the tuples that reached the result of the batch are kept until the batch is persisted.
+* A disabled tracer (sampling 0) holds nothing.
+*/
+class TupleTracer {
+private:
+	double sampling;
+	std::map<int, std::deque<TupleTrace>> steps;
+	std::vector<TupleTrace> completed;
+
+public:
+	/*
+	* Parameters:
+	*	- sampling: fraction of the input tuples traced (0: no tracing, 1: every tuple)
+	*/
+	TupleTracer(double sampling = 0) : sampling(sampling) {}
+
+	bool isEnabled() const {
+		return sampling > 0;
+	}
+
+	double getSampling() const {
+		return sampling;
+	}
+
+	/*
+	* Appends the traces of tuples added to a step.
+	*
+	* Parameters:
+	*	- step: schedule step of the tuples
+	*	- count: tuples added to the step
+	*	- traces: traces of the first tuples added (the following ones are not traced)
+	*/
+	void append(int step, size_t count, const std::vector<TupleTrace>& traces = {}) {
+		if(!isEnabled()) {
+			return;
+		}
+		std::deque<TupleTrace>& queue = steps[step];
+		queue.insert(queue.end(), traces.begin(), traces.begin() + std::min(count, traces.size()));
+		queue.resize(queue.size() + count - std::min(count, traces.size()));
+	}
+
+	// Removes the trace of the tuple at the front of a step
+	TupleTrace take(int step) {
+		auto it = steps.find(step);
+		if(it == steps.end() || it->second.empty()) {
+			return TupleTrace();
+		}
+		TupleTrace trace = it->second.front();
+		it->second.pop_front();
+		return trace;
+	}
+
+	// Moves the trace of a tuple to the back of a step
+	void forward(int step, const TupleTrace& trace) {
+		if(isEnabled()) {
+			steps[step].push_back(trace);
+		}
+	}
+
+	// The tuple reached the result of the batch
+	void complete(const TupleTrace& trace) {
+		if(trace.traced()) {
+			completed.push_back(trace);
+		}
+	}
+
+	// Every tuple of a step reached the result of the batch (reduce, or ChangeKey at the last step)
+	void completeStep(int step) {
+		auto it = steps.find(step);
+		if(it == steps.end()) {
+			return;
+		}
+		for(const TupleTrace& trace : it->second) {
+			complete(trace);
+		}
+		steps.erase(it);
+	}
+
+	// Drops the traces of a step, and of the tuples that reached the result (batch not committed)
+	void discard(int step) {
+		steps.erase(step);
+		completed.clear();
+	}
+
+	// Removes the traces of the tuples that reached the result, once it is persisted
+	std::vector<TupleTrace> takeCompleted() {
+		std::vector<TupleTrace> traces;
+		traces.swap(completed);
+		return traces;
+	}
+
+	void clear() {
+		steps.clear();
+		completed.clear();
+	}
+};
@@ -0,0 +1,138 @@
+#include <string>
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <stdexcept>
+#include <omnetpp.h>
+
+#include "JobQueue.h"
+
+using namespace omnetpp;
+
+/*
+* Job queue of a LeaderNode: submits each job of the queue at its submission time, and starts it
+* on its Leader (job[i]) while fewer than maxConcurrentJobs jobs run; the others wait in FIFO order.
+* Reports the latency of each job (submission to completion) and the throughput of the cluster in jobs/hour.
+*/
+class JobManager : public cSimpleModule, public JobListener{
+private:
+	std::vector<JobSpec> jobs;
+	int maxConcurrentJobs; // 0: all the submitted jobs run concurrently
+	std::deque<int> waitingJobs;
+	int runningJobs;
+	int jobsFinished;
+
+	std::vector<simtime_t> startTimes;
+	std::vector<simtime_t> finishTimes;
+
+	void startWaitingJobs();
+
+protected:
+	virtual void initialize() override;
+	virtual void handleMessage(cMessage *msg) override;
+	virtual void finish() override;
+
+public:
+	virtual void jobFinished(int jobId) override;
+};
+
+Define_Module(JobManager);
+
+void JobManager::initialize(){
+	try {
+		jobs = parseJobQueue(par("jobQueue").stdstringValue());
+	} catch(const std::logic_error& e) {
+		throw cRuntimeError("Invalid job queue entry '%s' (expected <program>[@<time>][*<weight>])", e.what());
+	}
+	int numJobs = par("numJobs").intValue();
+	if(jobs.size() != numJobs) {
+		throw cRuntimeError("The job queue has %d jobs, numJobs is %d", (int)jobs.size(), numJobs);
+	}
+	maxConcurrentJobs = par("maxConcurrentJobs").intValue();
+	runningJobs = 0;
+	jobsFinished = 0;
+	startTimes.assign(numJobs, -1);
+	finishTimes.assign(numJobs, -1);
+
+	// One submission event per job, the kind is the job ID
+	for(int i = 0; i < numJobs; i++) {
+		cMessage *submitMsg = new cMessage("SubmitJob", i);
+		scheduleAt(jobs[i].submitTime, submitMsg);
+	}
+}
+
+/*
+* Handles the submission of a job: it is queued, and started if a slot is free.
+*/
+void JobManager::handleMessage(cMessage *msg){
+	int jobId = msg->getKind();
+	delete msg;
+
+	EV_INFO << "Job " << jobId << " submitted: " << (jobs[jobId].programFile.empty() ? "random" : jobs[jobId].programFile) << "\n";
+	waitingJobs.push_back(jobId);
+	startWaitingJobs();
+}
+
+// Starts the waiting jobs, in submission order, while slots are free
+void JobManager::startWaitingJobs(){
+	while(!waitingJobs.empty() && (maxConcurrentJobs <= 0 || runningJobs < maxConcurrentJobs)) {
+		int jobId = waitingJobs.front();
+		waitingJobs.pop_front();
+
+		JobLeader *leader = dynamic_cast<JobLeader *>(getParentModule()->getSubmodule("job", jobId));
+		if(leader == nullptr) {
+			throw cRuntimeError("No Leader for job %d", jobId);
+		}
+		runningJobs++;
+		startTimes[jobId] = simTime();
+		leader->startJob(jobs[jobId].programFile);
+	}
+}
+
+/*
+* Called by the Leader of a job when all its workers have finished: the next waiting job starts.
+* A job that is not running (not started, or already finished) is ignored, so that its slot is released once.
+*
+* Parameters:
+*	- jobId: ID of the completed job
+*/
+void JobManager::jobFinished(int jobId){
+	Enter_Method("jobFinished");
+	if(startTimes[jobId] < 0 || finishTimes[jobId] >= 0) {
+		EV_WARN << "Job " << jobId << " is not running, completion ignored\n";
+		return;
+	}
+	finishTimes[jobId] = simTime();
+	runningJobs--;
+	jobsFinished++;
+	startWaitingJobs();
+}
+
+void JobManager::finish(){
+	simtime_t firstSubmit = -1;
+	simtime_t lastFinish = 0;
+	simtime_t totalLatency = 0;
+	for(int i = 0; i < jobs.size(); i++) {
+		std::cout << "Job " << i << " (" << (jobs[i].programFile.empty() ? "random" : jobs[i].programFile) << ", weight " << jobs[i].weight << ") submitted at " << jobs[i].submitTime << "s";
+		if(finishTimes[i] < 0) {
+			std::cout << ", not completed\n";
+			continue;
+		}
+		simtime_t latency = finishTimes[i] - jobs[i].submitTime;
+		std::cout << ", queued for " << startTimes[i] - jobs[i].submitTime << "s, latency: " << latency << "s\n";
+		if(firstSubmit < 0 || jobs[i].submitTime < firstSubmit) {
+			firstSubmit = jobs[i].submitTime;
+		}
+		lastFinish = std::max(lastFinish, finishTimes[i]);
+		totalLatency += latency;
+	}
+
+	if(jobsFinished == 0) {
+		std::cout << "Jobs completed: 0 of " << jobs.size() << "\n";
+		return;
+	}
+	simtime_t makespan = lastFinish - firstSubmit;
+	std::cout << "Jobs completed: " << jobsFinished << " of " << jobs.size() << ", makespan: " << makespan << "s, mean latency: " << totalLatency / jobsFinished << "s";
+	std::cout << ", throughput: " << (makespan > 0 ? jobsFinished * 3600 / SIMTIME_DBL(makespan) : 0) << " jobs/hour\n";
+}
@@ -2,11 +2,13 @@
 #include <string.h>
 #include <omnetpp.h>
 #include <filesystem>
-#include <cstdlib>
-#include <ctime>
 #include <algorithm>
 #include <numeric> // For std::accumulate
 #include <fstream>
+#include <deque>
+#include <array>
+#include <sstream>
+#include <cmath>
 
 #include "setup_m.h"
 #include "schedule_m.h"
@@ -15,17 +17,49 @@
 #include "ping_m.h"
 #include "restart_m.h"
 #include "finishSim_m.h"
-
-#define EXPERIMENT_NAME "Increasing_Number_of_Data"
+#include "speculate_m.h"
+#include "reassign_m.h"
+#include "setupCredit_m.h"
+#include "membership_m.h"
+#include "streamTuples_m.h"
+#include "leave_m.h"
+
+#include "ProgramParser.h"
+#include "Partitioner.h"
+#include "InputReader.h"
+#include "ProgramOptimizer.h"
+#include "ResultVerifier.h"
+#include "MessagePool.h"
+#include "MessageKinds.h"
+#include "Routing.h"
+#include "MessageSizes.h"
+#include "QueuedSender.h"
+#include "JobQueue.h"
+#include "StreamWindows.h"
+#include "StateTimeline.h"
+#include "CostModel.h"
 
 namespace fs = std::filesystem;
 using namespace omnetpp;
 
-class Leader : public cSimpleModule
+// RNG streams of the random jobs (module-local indices, seeded by OMNeT++ from the seed-set of the run):
+// the data does not change with the schedule drawn before it
+#define SCHEDULE_RNG 0
+#define DATA_RNG 1
+
+class Leader : public QueuedSender, public JobLeader
 {
     private:
         // Base simulation information
         int numWorkers;
+        Router router; // Output gate towards each worker, for the configured topology
+        PayloadEncoding payloadEncoding; // Encoding of the data-carrying payloads, for their byte length
+
+        // Job of the Leader: one of the queue of a LeaderNode, or the only job of the simulation
+        int jobId;
+        std::string dataDir; // Root of the job's persistent state ("<dataDir>/Worker_i/")
+        JobListener* jobManager; // Notified when the job completes (nullptr: single job)
+        bool started;
         
         // Termination condition and result information
         bool finished;
@@ -34,18 +68,71 @@ class Leader : public cSimpleModule
         std::vector<int> ckReceived;
         std::vector<int> ckSent;
         std::vector<std::vector<int>> workerResult;
+        std::string verificationMode; // "sorted": compare sorted vectors, "hash": multiset digests, "exact": external sort on disk
+        ResultVerifier* verifier;
 
         // Schedule information
         int scheduleSize;
         bool reduceLast;
         std::vector<std::string> schedule;
         std::vector<int> parameters;
+
+        // Program run by the workers (the schedule above after the optimizer, if enabled)
+        bool optimizeProgram;
+        int defaultPartitioner; // Partitioner of the changekeys that don't name one (PartitionerType)
+        std::vector<std::string> workerSchedule;
+        std::vector<int> workerParameters;
+        std::vector<int> workerUpperBounds; // Upper bound of "range" operators
+        long long referenceExecutions; // Per-tuple operator executions of the submitted program
+        long long workerExecutions; // Per-tuple operator executions of the program run by the workers
+
+        // Pipelined execution: segments of the program mapped onto sets of workers
+        std::string executionMode; // "schedule": every worker runs the whole program, "pipeline": every worker runs one stage
+        int pipelineStages; // Stages of balanced cost (0: one per changekey segment)
+        std::vector<int> stageOfStep; // Stage running each step of the workers' program, then the stage of the results
+        std::vector<int> stageOfWorker; // Stage of each worker (empty in schedule mode)
+        std::vector<int> stageWorkers; // Workers of each stage
+        simtime_t finishTime; // FinishSim sent to the workers
         
         // Data information
         int dataSize;
         std::vector<int> data;
-        std::vector<std::vector<int>> data_clone;
-        std::vector<std::vector<int>> dataMatrix;
+        std::vector<int> workerDataSize; // Data points assigned to each worker
+
+        // Submitted job: JSON program and input CSV files (random job if no program file)
+        std::string programFile;
+        std::vector<std::string> inputFiles;
+        int inputColumn;
+        int ingestChunkSize;
+        int partitions;
+
+        // Chunked input distribution, with credit-based flow control
+        int setupChunkSize;
+        int setupWindow;
+        std::vector<int> setupCredits; // Chunks each worker is ready to receive
+        std::vector<std::deque<int>> pendingSetup; // Values waiting to be sent to each worker
+        std::vector<int> valuesToGenerate; // Random job: values still to be generated for each worker
+        std::vector<int> chunksSent;
+        std::vector<int> setupComplete; // The last chunk has been sent to the worker
+        InputReader* inputReader; // Submitted job: input being streamed (nullptr once read)
+        long long pendingSetupValues; // Values currently buffered
+        long long peakPendingSetup;
+
+        // Streaming input (a StreamSource in the network): the panes of the windows are elaborated one at a time,
+        // as rounds of the termination protocol, and the reduce of each pane is the growth of the workers' partial results
+        bool streaming;
+        StreamWindows windows;
+        StreamPane currentPane;
+        bool paneRunning; // The tuples of currentPane are being elaborated
+        int paneExpected; // Reduce of currentPane by the reference program
+        long long streamedReduce; // Sum of the workers' partial results at the end of the previous pane
+        bool streamEnded;
+        std::ofstream windowsFile; // One line per window result
+        long long windowsEmitted;
+        long long incorrectWindows;
+        double totalWindowLatency;
+        double maxWindowLatency;
+        double totalTupleLatency;
         
         // Ping-related variables        
         bool stopPing;
@@ -55,35 +142,125 @@ class Leader : public cSimpleModule
         cMessage *check_msg;
         std::vector<int> pingWorkers;
 
-        // Utils for plotting
+        // Recycled messages of the high-frequency exchanges
+        MessagePool<PingMessage> pingPool{MSG_PING};
+        MessagePool<FinishLocalElaborationMessage> finishLocalPool{MSG_FINISH_LOCAL};
+
+        // Handlers of the received messages, indexed by kind, and their statistics
+        std::array<void (*)(Leader*, cMessage*), MSG_KIND_COUNT> dispatchTable;
+        MessageStats messageStats;
+
+        // Speculative execution of stragglers
+        bool speculativeExecution;
+        int speculationMinBatches;
+        std::vector<int> batchesDone; // Progress reported with ping replies
+        std::vector<int> aliveWorkers; // Replied to the last ping
+        std::vector<int> speculationHelper; // Helper assigned to each straggler (-1 if none)
+        std::vector<int> helpingWorker; // Straggler helped by each worker (-1 if none)
+        int speculationsLaunched;
+
+        // Recovery of failed workers
+        std::string recoveryMode; // "restart": wait for the failed worker, "reassign": hand its partition to another worker
+        std::vector<int> retiredWorkers; // Workers whose partition was reassigned
+        std::vector<int> keyOwner; // Worker currently owning each key
+        int reassignments;
+
+        // Elastic membership: spare workers joining, and workers leaving, a running job
+        int initialWorkers; // Workers of the job at start, the others are spares
+        std::vector<int> joinedWorkers; // Workers that joined the job (they may have left since, see retiredWorkers)
+        std::vector<int> members; // Workers of the job, the keys of the partitioners
+        std::vector<int> inputPartitions; // Worker receiving each partition of the submitted input
+        std::vector<int> leavingWorkers; // Leave in progress: stop requested (1), stopped and waiting for an adopter (2)
+        std::deque<std::pair<simtime_t, int>> scaleEvents; // Time, workers to add (> 0) or remove (< 0)
+        double scaleOutBacklog; // A spare joins when the remaining batches per worker exceed this (0: never)
+        int workersJoined;
+        int workersLeft;
+
+        // Statistics (see the @statistic declarations of the Leader)
+        simsignal_t setupBufferedSignal;
+        simsignal_t windowLatencySignal;
         simtime_t startTime;
         double workerFailureProbability;
         int workerBatchSize;
     protected:
         virtual void initialize() override;
         virtual void finish() override;
-        
+
+    public:
+        virtual void startJob(const std::string& programFile) override;
+
+    protected:
         // Message handling
         virtual void handleMessage(cMessage *msg) override;
+        void initializeDispatchTable();
         void handleFinishElaborationMessage(FinishLocalElaborationMessage *msg);
         void handleCheckChangeKeyAckMessage(CheckChangeKeyAckMessage *msg);
         void handlePingMessage(cMessage *msg, int id);
+        void handleSpeculateMessage(SpeculateMessage *msg);
+        void handleSetupCreditMessage(SetupCreditMessage *msg);
+        void handleStreamTuplesMessage(StreamTuplesMessage *msg);
+        void handleLeaveMessage(LeaveMessage *msg);
         
         // Ping handling
         void checkPing();
         void sendPing();
+        void sendToWorker(RoutedMessage *msg, int workerId);
+
+        // Straggler handling
+        void launchSpeculation();
+        void cancelSpeculation(int ownerId);
+
+        // Failure recovery
+        void restartWorker(int workerId);
+        bool reassignPartition(int failedId, const std::vector<int>& live);
+
+        // Elastic membership
+        bool isActive(int workerId);
+        void parseScaleEvents(const std::string& events);
+        void applyScaleEvents();
+        bool addWorker();
+        bool removeWorker();
+        void sendLeaveRequest(int workerId);
+        bool completeLeave(int workerId, const std::vector<int>& live);
+        void moveInput(int workerId);
+        void broadcastMembership();
+        int remainingBatches(int workerId);
         
         // Data, schedule handling
-        void sendData(int id_dest);
-        void sendSchedule();
+        void planData(int idDest);
+        void generateSchedule();
         bool isFilterOperation(const std::string& operation);
         int generateParameter(const std::string& operation);
-        void sendScheduleToWorker(int workerID, const std::vector<std::string>& schedule, const std::vector<int>& parameters);
-        void sendCustomData(); // For custom testing
+        void prepareWorkerSchedule();
+        void planPipeline();
+        double stepCost(const std::string& operation);
+        bool receivesInput(int workerId);
+        template <typename T> void setPipelineStages(T *msg);
+        void sendScheduleToWorker(int workerID, const std::vector<std::string>& schedule, const std::vector<int>& parameters, const std::vector<int>& upperBounds);
         void sendCustomSchedule(); // For custom testing
+
+        // Submitted job handling
+        void loadProgram();
+        void openInput();
+        int inputPartition(int value);
+
+        // Chunked input distribution
+        bool refillSetup(int workerId);
+        void sendSetupChunk(int workerId);
+        void pumpSetup();
+
+        // Windowed streaming
+        void startNextPane();
+        void finishPane();
+        void emitWindows(const std::vector<WindowResult>& results);
+        void finishJob();
         
         // Final result calculation
-        void calcResult();
+        void trackExpected(int value);
+        void recordExpected(int value);
+        void verifyResult();
+        bool applyReferenceSchedule(int& value);
+        bool evaluateProgram(const std::vector<std::string>& program, const std::vector<int>& programParameters, const std::vector<int>& upperBounds, int& value, long long& executions);
 
         // Persistent storage handling
         void createWorkersDirectory();
@@ -92,9 +269,11 @@ class Leader : public cSimpleModule
         // Util functions
         int numberOfFilters(int scheduleSize);
         void getWorkerData();
-        void logSimData();
+        cModule* workerModule(int id);
+        void analyzeTimelines();
+        void recordStatistics();
         void printingVector(std::vector<int> vector);
-        void printingStringVector(std::vector<std::string> vector);
+        std::string formatVector(const std::vector<int>& vector);
         int counter(std::vector<int> vec);
 };
 
@@ -104,32 +283,203 @@ void Leader::initialize()
 {
     // Basic initializations
     dataSize = 0;
+    initializeDispatchTable();
+    router = Router(par("topology").stdstringValue(), LEADER_ADDRESS);
+    payloadEncoding = PayloadCodec::parseEncoding(par("payloadEncoding").stdstringValue());
     stopPing = false;
+    jobId = par("jobId").intValue();
+    dataDir = par("dataDir").stdstringValue();
+    jobManager = dynamic_cast<JobListener*>(getParentModule()->getSubmodule("jobManager"));
+    started = false;
+    ping_msg = nullptr;
+    check_msg = nullptr;
+    verifier = nullptr;
+    inputReader = nullptr;
+    streaming = false;
+    paneRunning = false;
+    setupBufferedSignal = registerSignal("setupBuffered");
+    windowLatencySignal = registerSignal("windowLatency");
+
+    // Jobs of a LeaderNode are started by its JobManager, when they are submitted
+    if(par("autoStart").boolValue())
+    {
+        startJob(par("programFile").stdstringValue());
+    }
+}
+
+/*
+* Starts the job: creates the workers' directories, loads or generates the program and its input,
+* and sends the first input chunk and the program to the initial workers.
+*
+* Parameters:
+*   - programFile: JSON program to run (random program and data if empty)
+*/
+void Leader::startJob(const std::string& programFile)
+{
+    Enter_Method("startJob");
+    started = true;
 
-    // Remove all previous simulation data in './Data/'
+    // Remove all previous simulation data in './<dataDir>/'
     removeWorkersDirectory();
 	//Create './Data/Worker_i' Directory for worker data
 	createWorkersDirectory();
 	
     // Initialize termination condition data structures
     numWorkers = par("numWorkers").intValue();
+    initialWorkers = par("initialWorkers").intValue();
+    if(initialWorkers == -1)
+    {
+        initialWorkers = numWorkers;
+    }
+    if(initialWorkers < 1 || initialWorkers > numWorkers)
+    {
+        throw cRuntimeError("initialWorkers must be between 1 and numWorkers (%d), got %d", numWorkers, initialWorkers);
+    }
+    parseScaleEvents(par("scaleEvents").stdstringValue());
+    scaleOutBacklog = par("scaleOutBacklog").doubleValue();
+    workersJoined = 0;
+    workersLeft = 0;
+    finished = false;
+    speculativeExecution = par("speculativeExecution").boolValue();
+    speculationMinBatches = par("speculationMinBatches").intValue();
+    speculationsLaunched = 0;
+    recoveryMode = par("recoveryMode").stdstringValue();
+    reassignments = 0;
+    optimizeProgram = par("optimizeProgram").boolValue();
+    executionMode = par("executionMode").stdstringValue();
+    pipelineStages = par("pipelineStages").intValue();
+    if(executionMode != "schedule" && executionMode != "pipeline")
+    {
+        throw cRuntimeError("Unknown executionMode: %s", executionMode.c_str());
+    }
+    if(executionMode == "pipeline" && (initialWorkers < numWorkers || !scaleEvents.empty() || scaleOutBacklog > 0))
+    {
+        throw cRuntimeError("The pipelined mode maps the stages onto a fixed set of workers: initialWorkers, scaleEvents and scaleOutBacklog are not supported");
+    }
+    finishTime = -1;
+    try
+    {
+        defaultPartitioner = Partitioner::parseName(par("defaultPartitioner").stdstringValue());
+    }
+        catch(const std::runtime_error& e)
+        {
+            throw cRuntimeError("%s", e.what());
+        }
+    verificationMode = par("verificationMode").stdstringValue();
+    if(verificationMode != "sorted" && verificationMode != "hash" && verificationMode != "exact")
+    {
+        throw cRuntimeError("Unknown verificationMode: %s", verificationMode.c_str());
+    }
+    verifier = new ResultVerifier(verificationMode == "exact", dataDir + "/Verification/", numWorkers, par("verificationMemory").intValue());
+    referenceExecutions = 0;
+    workerExecutions = 0;
     for(int i = 0; i < numWorkers; i++)
     {
-        finishedWorkers.push_back(0);
-        ckChecked.push_back(0);
+        // Spares take part in the termination condition once they join
+        int spare = (i >= initialWorkers) ? 1 : 0;
+        finishedWorkers.push_back(spare);
+        ckChecked.push_back(spare);
+        retiredWorkers.push_back(0);
+        joinedWorkers.push_back(1 - spare);
+        keyOwner.push_back(i);
+        if(!spare)
+        {
+            members.push_back(i);
+        }
     }
     
-    // Distribute data
-    for(int i = 0; i < numWorkers; i++)
-	{
-	    // Re-initialize seed for more randomness
-        srand((unsigned) time(NULL) + i);
-        // Generate and send data to the worker i
-	    sendData(i);
-	}
+    workerDataSize.resize(numWorkers, 0);
+    setupChunkSize = par("setupChunkSize").intValue();
+    setupWindow = par("setupWindow").intValue();
+    setupCredits.resize(numWorkers, setupWindow);
+    pendingSetup.resize(numWorkers);
+    valuesToGenerate.resize(numWorkers, 0);
+    chunksSent.resize(numWorkers, 0);
+    setupComplete.resize(numWorkers, 0);
+    inputReader = nullptr;
+    pendingSetupValues = 0;
+    peakPendingSetup = 0;
+
+    // Streaming input: the tuples come from the StreamSource, in windows reduced by the program
+    streaming = getParentModule() -> getSubmodule("source", 0) != nullptr;
+    paneRunning = false;
+    streamedReduce = 0;
+    streamEnded = false;
+    windowsEmitted = 0;
+    incorrectWindows = 0;
+    totalWindowLatency = 0;
+    maxWindowLatency = 0;
+    totalTupleLatency = 0;
+    if(streaming)
+    {
+        std::string windowType = par("windowType").stdstringValue();
+        if(windowType != "time" && windowType != "count")
+        {
+            throw cRuntimeError("Unknown windowType: %s", windowType.c_str());
+        }
+        try
+        {
+            windows = StreamWindows(windowType == "count", par("windowSize").doubleValue(), par("windowSlide").doubleValue());
+        }
+            catch(const std::runtime_error& e)
+            {
+                throw cRuntimeError("%s", e.what());
+            }
+        windowsFile.open(dataDir + "/windows.csv");
+        windowsFile << "window,start,end,tuples,result,expected,emitted_at,latency,tuple_latency\n";
+    }
+
+    this -> programFile = programFile;
+    if(!programFile.empty())
+    {
+        // Submitted job: the program is needed to compute the expected result while streaming the input
+        loadProgram();
+        prepareWorkerSchedule();
+        planPipeline();
+        if(!streaming)
+        {
+            openInput();
+        }
+    }
+        else
+        {
+            // Random job: the schedule is generated first, to compute the expected result while generating the data
+            generateSchedule();
+            prepareWorkerSchedule();
+            planPipeline();
+            for(int i = 0; i < initialWorkers; i++)
+            {
+                // In the pipelined mode, only the workers of the first stage read input (a stream brings its own)
+                if(receivesInput(i) && !streaming)
+                {
+                    planData(i);
+                }
+            }
+        }
+
+    reduceLast = (schedule.back() == "reduce");
+    if(streaming && !reduceLast)
+    {
+        throw cRuntimeError("The windows of a stream need a program ending with reduce");
+    }
+    data.clear();
+    if(reduceLast)
+    {
+        data.push_back(0); // Expected reduce, in first cell
+    }
 
-    // Generate and send schedule to all workers
-	sendSchedule();
+    // The first chunk initializes each worker, the program follows, then the rest of the input as credits return
+    // (with a stream, the first chunk is empty: the input comes with the panes)
+    for(int i = 0; i < initialWorkers; i++)
+    {
+        refillSetup(i);
+        sendSetupChunk(i);
+    }
+    for(int i = 0; i < initialWorkers; i++)
+    {
+        sendScheduleToWorker(i, workerSchedule, workerParameters, workerUpperBounds);
+    }
+    pumpSetup();
 
 	// Initialize structures based on numWorkers
 	finishedWorkers.resize(numWorkers);
@@ -137,6 +487,11 @@ void Leader::initialize()
     workerResult.resize(numWorkers);
     ckSent.resize(numWorkers);
     ckReceived.resize(numWorkers);
+    batchesDone.resize(numWorkers, 0);
+    aliveWorkers = joinedWorkers;
+    leavingWorkers.resize(numWorkers, 0);
+    speculationHelper.resize(numWorkers, -1);
+    helpingWorker.resize(numWorkers, -1);
 
     // Initialize helper flag
     reduceLast = (schedule[schedule.size() - 1] == "reduce");
@@ -166,114 +521,124 @@ void Leader::initialize()
 
 void Leader::finish()
 {
-    // Calculate schedule result to check with workers'
-    calcResult(); // Final result in data vector
-
-    // Print final result
-    std::cout << "\nResult should be: \n";
-    if(reduceLast)
+    if(!started)
     {
-        std::cout << data[0] << "\n";
+        std::cout << "Job " << jobId << " was never started\n";
+        return;
     }
-    else
+    if(jobManager != nullptr)
     {
-        // First sort the result and print
-        std::sort(std::begin(data), std::end(data));
-        printingVector(data);
+        std::cout << "\n----- Job " << jobId << " (" << (programFile.empty() ? "random" : programFile) << ") -----\n";
     }
-    
-    std::cout << "\nAnd from the workers: \n";
-    // Print result received by workers
-    if(reduceLast)
+
+    // The expected result (data vector or verifier) was computed while distributing the input
+    if(!reduceLast && verificationMode != "sorted")
     {
-        int res = 0;
-        for(int i = 0; i < numWorkers; i++)
-        {
-            res += workerResult[i][0];
-        }
-        // Sum and print reduced results
-        std::cout << res << "\n" << "\n";
+        verifyResult();
     }
-    else
-    {
-        /*
-        * Sort the received vectors
-        * Compare with the result calculated
-        * Print Correct/Incorrect
-        */
-        std::vector<int> workerRes;
-        for(int i = 0; i < numWorkers; i++)
+        else
         {
-            for(int j = 0; j < workerResult[i].size(); j++)
+            // Print final result
+            std::cout << "\nResult should be: \n";
+            if(reduceLast)
             {
-                // Push all results
-                workerRes.push_back(workerResult[i][j]);
+                std::cout << data[0] << "\n";
             }
-        }
+            else
+            {
+                // First sort the result and print
+                std::sort(std::begin(data), std::end(data));
+                printingVector(data);
+            }
+    
+            std::cout << "\nAnd from the workers: \n";
+            // Print result received by workers
+            if(reduceLast)
+            {
+                int res = 0;
+                for(int i = 0; i < numWorkers; i++)
+                {
+                    res += workerResult[i][0];
+                }
+                // Sum and print reduced results
+                std::cout << res << "\n" << "\n";
+            }
+            else
+            {
+                /*
+                * Sort the received vectors
+                * Compare with the result calculated
+                * Print Correct/Incorrect
+                */
+                std::vector<int> workerRes;
+                for(int i = 0; i < numWorkers; i++)
+                {
+                    for(int j = 0; j < workerResult[i].size(); j++)
+                    {
+                        // Push all results
+                        workerRes.push_back(workerResult[i][j]);
+                    }
+                }
 
-        // Sort result vector
-        std::sort(std::begin(workerRes), std::end(workerRes));
-        printingVector(workerRes);
+                // Sort result vector
+                std::sort(std::begin(workerRes), std::end(workerRes));
+                printingVector(workerRes);
 
-        std::cout << "\n\nThe result is: ";
-        bool result;
+                std::cout << "\n\nThe result is: ";
+                // Check if the two vectors are of the same size, and the elements contained are the same
+                bool result = (data.size() == workerRes.size());
+                for(int i = 0; result && i < workerRes.size(); i++)
+                {
+                    if(data[i] != workerRes[i])
+                    {
+                        result = false;
+                    }
+                }
 
-        // Check if the elements contained are the same
-        for(int i = 0; i < workerRes.size(); i++)
-        {
-            if(data[i] != workerRes[i])
-            {
-                result = false;
-                break;
+                // Print final result
+                if(result)
+                {
+                    std::cout << "Correct\n\n";
+                }
+                else
+                {
+                    std::cout << "Incorrect\n\n";
+                }
             }
         }
 
-        // Check if the two vectors are of the same size
-        if(data.size() != workerRes.size())
-        {
-            result = false;
-        }
-        else
-        {
-            result = true;
-        }
-
-        // Print final result
-        if(result)
-        {
-            std::cout << "Correct\n\n";
-        }
-        else
-        {
-            std::cout << "Incorrect\n\n";
-        }
+    std::cout << "Speculative copies launched: " << speculationsLaunched << "\n";
+    std::cout << "Partitions reassigned: " << reassignments << "\n";
+    std::cout << "Workers joined: " << workersJoined << ", left: " << workersLeft << ", workers at the end: " << members.size() << "\n";
+    std::cout << "Input chunks sent: " << counter(chunksSent) << ", peak values buffered: " << peakPendingSetup << "\n";
+    std::cout << "Operator executions (per-tuple, failure-free): submitted program " << referenceExecutions << ", workers' program " << workerExecutions << "\n";
+    std::cout << "Execution mode: " << executionMode;
+    if(!stageWorkers.empty())
+    {
+        std::cout << " (" << stageWorkers.size() << " stages, workers per stage: ";
+        printingVector(stageWorkers);
+        std::cout << ")";
     }
-
-    // Debug prints (Ignore)
-    std::cout << "For testing: " << "\n";
-    std::cout << "dataMatrix: {";
-
-    for(const auto& row : dataMatrix)
+    if(finishTime >= 0)
+    {
+        std::cout << ", completion time: " << finishTime - startTime << "s, throughput: " << dataSize / SIMTIME_DBL(finishTime - startTime) << " values/s";
+    }
+    std::cout << "\n";
+    if(streaming)
     {
-        std::cout <<"{";
-        printingVector(row);
-        if(row != dataMatrix.back())
+        std::cout << "Stream: " << windows.getTuples() << " tuples received, " << windows.getLateTuples() << " late (dropped), ";
+        std::cout << windowsEmitted << " windows emitted (" << incorrectWindows << " incorrect)";
+        if(windowsEmitted > 0)
         {
-            std::cout << "},\n";
+            std::cout << ", window latency mean: " << totalWindowLatency / windowsEmitted << "s, max: " << maxWindowLatency << "s";
+            std::cout << ", tuple latency mean: " << totalTupleLatency / windowsEmitted << "s";
         }
-            else
-            {
-                std::cout << "}\n";
-            }
+        std::cout << "\n";
+        windowsFile.close();
     }
-
-    std::cout << "};" << "\n";
-    std::cout << "parameters = {";
-    printingVector(parameters);
-    std::cout << "};" << "\n";
-    std::cout << "schedule = {";
-    printingStringVector(schedule);
-    std::cout << "};" << "\n";
+    std::cout << "Message allocations: " << pingPool.getAllocations() + finishLocalPool.getAllocations() << ", reuses: " << pingPool.getReuses() + finishLocalPool.getReuses() << "\n";
+    std::cout << "Messages queued on busy links: " << getQueuedPackets() << ", total queueing delay: " << getTotalQueueingDelay() << ", peak queue: " << getPeakQueueLength() << "\n";
+    analyzeTimelines();
 
     // Deallocating variables to avoid memory leaks
     if(ping_msg->isScheduled())
@@ -288,111 +653,138 @@ void Leader::finish()
     }
     delete check_msg;
 
-    // Log data
-    logSimData();
+    delete verifier;
+    delete inputReader;
+
+    recordStatistics();
 }
 
 /*
-* Calculates the result of the schedule based on parameters and data.
-* The final result is stored in the data vector, in the first cell if
-* the schedule has a final reduce
+* Applies the schedule to an input data point, and accumulates it in the expected result:
+* the data vector holds the reduce in its first cell, or the expected values (see recordExpected).
+*
+* Parameters:
+*   - value: The input data point
 */
-void Leader::calcResult()
+void Leader::trackExpected(int value)
 {
-    std::vector<int> filteredData; // Tmp vector for filter operations
-
-    for(size_t i = 0; i < schedule.size(); ++i)
+    if(applyReferenceSchedule(value))
     {
-        const std::string& op = schedule[i];
-        int param = parameters[i];
-        filteredData.clear(); // Clear it before the next operation
-
-        if(op == "add" || op == "sub" || op == "mul" || op == "div")
+        if(reduceLast)
         {
-            for(int& value : data)
-            {
-                if(op == "add") {
-                    value += param;
-                } else if(op == "sub") {
-                    value -= param;
-                } else if(op == "mul") {
-                    value *= param;
-                } else if(op == "div") {
-                    value /= param;
-                }
-            }
+            data[0] += value;
         }
-            else if(op == "gt" || op == "lt" || op == "ge" || op == "le")
+            else
             {
-                for(int value : data)
-                {
-                    bool condition = false;
-                    if(op == "gt") {
-                        condition = (value > param);
-                    } else if(op == "lt") {
-                        condition = (value < param);
-                    } else if(op == "ge") {
-                        condition = (value >= param);
-                    } else if(op == "le") {
-                        condition = (value <= param);
-                    }
-
-                    // Push valid data points in filteredData vector
-                    if(condition) {
-                        filteredData.push_back(value);
-                    }
-                }
-                data = filteredData; // Update data with filtered results.
+                recordExpected(value);
             }
-                else if(op == "reduce")
-                {
-                    int sum = 0;
-                    for(int value : data)
-                    {
-                        sum += value;
-                    }
-                    data.clear();
-                    data.push_back(sum); // Push in first cell
-                    break; // No further operation is expected after reduce.
-                }
-        // Ignoring changekey op.
     }
 }
 
 /*
-* - Testing function -
-* Sends a custom data vector to each worker
-* Used for debugging with specific data vectors
+* Records a value of the expected (non-reduced) result.
+* Values are kept in the data vector only for the "sorted" verification, otherwise they go to the verifier.
 */
-void Leader::sendCustomData()
+void Leader::recordExpected(int value)
 {
-    dataMatrix = {{33, 74, 88, 39, 70, 75, 60, 62, 87, 48, 16, 71, 93, 92, 31, 87, 80, 92, 79, 50},
-    {82, 38, 83, 85, 97, 87, 33, 73, 39, 100, 60, 42, 39, 16, 1, 5, 5, 23, 35, 65, 45, 39, 88},
-    {62, 34, 78, 100, 55, 100, 5, 17, 59, 52, 4, 81, 17, 40, 71, 55, 62, 54, 92, 81},
-    };
-    
-    // Update data vector for final calculation
-    for(int i = 0; i < dataMatrix.size(); i++)
+    if(verificationMode == "sorted")
     {
-        for(int j=0; j < dataMatrix[i].size(); j++)
+        data.push_back(value);
+    }
+        else
         {
-            data.push_back(dataMatrix[i][j]);
+            verifier -> addExpected(value);
         }
-        dataSize += dataMatrix[i].size();
-    }
+}
 
-    // Send a setup message to each worker with custom data
-    for(int i = 0; i < numWorkers; i++)
+/*
+* Verifies the workers' (non-reduced) results with the ResultVerifier, without sorting
+* or holding them in memory. Prints Correct/Incorrect.
+*/
+void Leader::verifyResult()
+{
+    std::string report;
+    bool result = verifier -> verify(report);
+    std::cout << "\nVerification (" << verificationMode << "): " << report << "\n";
+    std::cout << "\nThe result is: " << (result ? "Correct" : "Incorrect") << "\n\n";
+}
+
+/*
+* Applies the schedule to a single data point, up to the final reduce (excluded).
+* The program run by the workers is evaluated on the same data point, to compare the operator executions.
+* The submitted program has no "range" operations (they are made by the optimizer), so it has no upper bounds.
+*
+* Parameters:
+*   - value: The data point, updated in place
+*
+* Returns:
+*   - false if the data point is filtered out
+*/
+bool Leader::applyReferenceSchedule(int& value)
+{
+    int workerValue = value;
+    evaluateProgram(workerSchedule, workerParameters, workerUpperBounds, workerValue, workerExecutions);
+    return evaluateProgram(schedule, parameters, std::vector<int>(), value, referenceExecutions);
+}
+
+/*
+* Applies a program to a single data point, up to the final reduce (excluded).
+* ChangeKey operations are ignored, they don't change the value.
+*
+* Parameters:
+*   - program, programParameters: The operations and their parameters
+*   - upperBounds: Upper bound of "range" operations, by position in the program (empty if it has none)
+*   - value: The data point, updated in place
+*   - executions: Incremented for every operation applied
+*
+* Returns:
+*   - false if the data point is filtered out
+*/
+bool Leader::evaluateProgram(const std::vector<std::string>& program, const std::vector<int>& programParameters, const std::vector<int>& upperBounds, int& value, long long& executions)
+{
+    for(size_t i = 0; i < program.size(); ++i)
     {
-        SetupMessage *msg = new SetupMessage();
-        msg -> setAssigned_id(i);
-        msg -> setDataArraySize(dataMatrix[i].size());
-        for(int j = 0; j < dataMatrix[i].size(); j++)
-        {
-            msg -> setData(j, dataMatrix[i][j]);
+        const std::string& op = program[i];
+        int param = programParameters[i];
+
+        if(op == "reduce") {
+            break; // No further operation is expected after reduce.
+        }
+        executions++;
+
+        if(op == "add") {
+            value += param;
+        } else if(op == "sub") {
+            value -= param;
+        } else if(op == "mul") {
+            value *= param;
+        } else if(op == "div") {
+            value /= param;
+        } else if(op == "gt" || op == "lt" || op == "ge" || op == "le" || op == "range") {
+            bool condition = false;
+            if(op == "gt") {
+                condition = (value > param);
+            } else if(op == "lt") {
+                condition = (value < param);
+            } else if(op == "ge") {
+                condition = (value >= param);
+            } else if(op == "le") {
+                condition = (value <= param);
+            } else if(op == "range") {
+                if(i >= upperBounds.size())
+                {
+                    throw cRuntimeError("Operation %zu (range) of the program has no upper bound", i);
+                }
+                condition = (value >= param && value <= upperBounds[i]);
+            }
+
+            if(!condition) {
+                return false;
+            }
         }
-        send(msg, "out", i);
+        // Ignoring changekey op.
     }
+    return true;
 }
 
 /*
@@ -405,61 +797,44 @@ void Leader::sendCustomSchedule()
     // Define schedule and parameters
     schedule = {"gt", "changekey", "mul", "changekey", "changekey", "div", "le", "add", "changekey", "sub", "div", "reduce"};
     parameters = {15, 0, 4, 0, 0, 5, 84, 25, 0, 4, 3, 0};
+    workerSchedule = schedule;
+    workerParameters = parameters;
+    workerUpperBounds.assign(schedule.size(), 0);
 
     // Manually set values and send schedule to each worker
     scheduleSize = schedule.size();
     bool reduceFound = true;
     for(int i = 0; i < numWorkers; i++)
     {
-        std::cout << "Schedule: ";
+        EV_DETAIL << "Schedule: ";
         ScheduleMessage *msg = new ScheduleMessage();
+        msg -> setKind(MSG_SCHEDULE);
         msg -> setDestWorker(i);
         msg -> setScheduleArraySize(scheduleSize);
         msg -> setParametersArraySize(scheduleSize);
+        msg -> setUpperBoundsArraySize(scheduleSize);
 
         for(int j = 0; j < scheduleSize; j++)
         {
             msg -> setSchedule(j, schedule[j].c_str());
             msg -> setParameters(j, parameters[j]);
-            std::cout << schedule[j] << " ";
-            std::cout << parameters[j] << " ";
+            msg -> setUpperBounds(j, workerUpperBounds[j]);
+            EV_DETAIL << schedule[j] << " ";
+            EV_DETAIL << parameters[j] << " ";
         }
-        send(msg, "out", i);
-        std::cout << "\n";
+        sendToWorker(msg, i);
+        EV_DETAIL << "\n";
     }
 }
 
 /*
-* Handles incoming messages/self-messages by casting to their respective type, and
-* calling the function responsible for the corresponding task.
+* Handles incoming messages/self-messages: self-messages are recognized by pointer, the other
+* messages are dispatched by kind to the function responsible for the corresponding task.
 */
 void Leader::handleMessage(cMessage *msg)
 {
-    /*
-	*	FinishLocalElaboration Message segment:
-	*	Update ChangeKey counters for this worker
-	*/
-    FinishLocalElaborationMessage *finishLocalMsg = dynamic_cast<FinishLocalElaborationMessage *>(msg);
-    if(finishLocalMsg != nullptr)
-    {
-        handleFinishElaborationMessage(finishLocalMsg);
-        delete msg;
-        return;
-    }
-
-    /*
-	*	CheckChangeKeyACK Message segment:
-	*	Update ChangeKey counters
-	*   Update Partial result
-	*   Evaluate termination condition
-	*/
-    CheckChangeKeyAckMessage *checkChangeKeyAckMsg = dynamic_cast<CheckChangeKeyAckMessage *>(msg);
-    if(checkChangeKeyAckMsg != nullptr)
-    {
-        handleCheckChangeKeyAckMessage(checkChangeKeyAckMsg);
-        delete msg;
-        return;
-    }
+    // Segment for the end of a transmission on a busy link
+    if(handleTransmitTimer(msg)) return;
 
     // Segment for workers pinging self-message
     if(msg == ping_msg)
@@ -479,18 +854,98 @@ void Leader::handleMessage(cMessage *msg)
         return;
     }
 
+    // Messages from the workers: the kind, set when the message was created, indexes the dispatch table
+    int kind = msg -> getKind();
+    if(!isValidMessageKind(kind) || dispatchTable[kind] == nullptr)
+    {
+        EV_WARN << "Received message of unexpected kind " << kind << " - dropped\n";
+        delete msg;
+        return;
+    }
+    messageStats.record(msg);
+    dispatchTable[kind](this, msg);
+}
+
+/*
+* Fills the dispatch table: one entry per kind of message the Leader can receive, which
+* calls the function responsible for the corresponding task and disposes of the message.
+*/
+void Leader::initializeDispatchTable()
+{
+    dispatchTable.fill(nullptr);
+
+    /*
+	*	FinishLocalElaboration Message:
+	*	Update ChangeKey counters for this worker
+	*/
+    dispatchTable[MSG_FINISH_LOCAL] = [](Leader* leader, cMessage* msg)
+    {
+        leader -> handleFinishElaborationMessage(static_cast<FinishLocalElaborationMessage *>(msg));
+        leader -> finishLocalPool.release(static_cast<FinishLocalElaborationMessage *>(msg));
+    };
+
+    /*
+	*	CheckChangeKeyACK Message:
+	*	Update ChangeKey counters
+	*   Update Partial result
+	*   Evaluate termination condition
+	*/
+    dispatchTable[MSG_CHECK_CK_ACK] = [](Leader* leader, cMessage* msg)
+    {
+        leader -> handleCheckChangeKeyAckMessage(static_cast<CheckChangeKeyAckMessage *>(msg));
+        delete msg;
+    };
+
     /*
-	*	Ping Message segment:
+	*	Ping Message:
 	*	Register a worker's response to the ping
 	*/
-    PingMessage *pingMsg = dynamic_cast<PingMessage *>(msg);
-    if(pingMsg != nullptr)
+    dispatchTable[MSG_PING] = [](Leader* leader, cMessage* msg)
+    {
+        PingMessage *pingMsg = static_cast<PingMessage *>(msg);
+        leader -> handlePingMessage(pingMsg, pingMsg -> getWorkerId());
+        leader -> pingPool.release(pingMsg);
+    };
+
+    /*
+	*	Speculate Message:
+	*	A straggler replied with the first batch of the speculative copy
+	*/
+    dispatchTable[MSG_SPECULATE] = [](Leader* leader, cMessage* msg)
     {
-        handlePingMessage(pingMsg, pingMsg -> getWorkerId());
+        leader -> handleSpeculateMessage(static_cast<SpeculateMessage *>(msg));
         delete msg;
-        return;
-    }
+    };
+
+    /*
+	*	SetupCredit Message:
+	*	A worker has loaded some chunks of its input, send the next ones
+	*/
+    dispatchTable[MSG_SETUP_CREDIT] = [](Leader* leader, cMessage* msg)
+    {
+        leader -> handleSetupCreditMessage(static_cast<SetupCreditMessage *>(msg));
+        delete msg;
+    };
+
+    /*
+	*	Leave Message:
+	*	A leaving worker has stopped, its partition can be reassigned
+	*/
+    dispatchTable[MSG_LEAVE] = [](Leader* leader, cMessage* msg)
+    {
+        leader -> handleLeaveMessage(static_cast<LeaveMessage *>(msg));
+        delete msg;
+    };
 
+    /*
+	*	StreamTuples Message:
+	*	Tuples and watermark of the stream source, the closed panes are elaborated in order
+	*/
+    dispatchTable[MSG_STREAM_TUPLES] = [](Leader* leader, cMessage* msg)
+    {
+        leader -> handleStreamTuplesMessage(static_cast<StreamTuplesMessage *>(msg));
+        delete msg;
+    };
 }
 
 /*
@@ -522,18 +977,47 @@ void Leader::handleFinishElaborationMessage(FinishLocalElaborationMessage *msg)
     ckReceived[id] = msg -> getChangeKeyReceived();
     ckSent[id] = msg -> getChangeKeySent();
 
+    // The worker finished its local data, a speculative copy is no longer useful
+    cancelSpeculation(id);
+
     //Reply with ACK
-    FinishLocalElaborationMessage* finishLocalMsg = new FinishLocalElaborationMessage();
+    FinishLocalElaborationMessage* finishLocalMsg = finishLocalPool.acquire();
     finishLocalMsg -> setWorkerId(id);
-    send(finishLocalMsg, "out", id);
+    sendToWorker(finishLocalMsg, id);
 }
 
 /*
-* Handles a CheckChangeKeyACK message received from a worker.
-* Updates the Changekey counters for this worker
-* Updates worker's partial result
-* Updates vector of received CheckChangeKeyACK messages
-* Evaluates termination condition. If the changekey counters are different (sent != received)
+* Sends FinishSim to the workers of the job, and notifies the JobManager (if any).
+* Only the first call completes the job: later termination checks (e.g. a late CheckChangeKeyACK) find it finished.
+*/
+void Leader::finishJob()
+{
+    if(finishTime >= 0)
+    {
+        return;
+    }
+    for(int i = 0; i < numWorkers; i++)
+    {
+        if(!isActive(i)) continue;
+        FinishSimMessage* finishSimMsg = new FinishSimMessage();
+        finishSimMsg -> setKind(MSG_FINISH_SIM);
+        finishSimMsg -> setWorkerId(i);
+        sendToWorker(finishSimMsg, i);
+        stopPing = true;
+    }
+    finishTime = simTime();
+    if(jobManager != nullptr)
+    {
+        jobManager -> jobFinished(jobId);
+    }
+}
+
+/*
+* Handles a CheckChangeKeyACK message received from a worker.
+* Updates the Changekey counters for this worker
+* Updates worker's partial result
+* Updates vector of received CheckChangeKeyACK messages
+* Evaluates termination condition. If the changekey counters are different (sent != received)
 * sends a FinishLocalElaboration message to make workers check their ChangeKey queue
 *
 * Parameters:
@@ -550,6 +1034,11 @@ void Leader::handleCheckChangeKeyAckMessage(CheckChangeKeyAckMessage *msg)
     {
         workerResult[id][0] = msg -> getPartialRes();
     }
+        else if(verificationMode != "sorted")
+        {
+            // Only the digest (and the spill file, in exact mode) of the partial result is kept
+            verifier -> setWorkerResult(id, msg -> getPartialVectorArraySize(), [msg](int i) { return msg -> getPartialVector(i); });
+        }
         else
         {
             int resultSize = msg -> getPartialVectorArraySize();
@@ -575,211 +1064,1158 @@ void Leader::handleCheckChangeKeyAckMessage(CheckChangeKeyAckMessage *msg)
         }
     }
 
-    EV<<"ChangeKeyReceived: "<<counter(ckReceived)<<" ChangeKeySent: "<<counter(ckSent)<<"\n";
-    EV<<"Finished: "<<finished<<"\n";
-    // If all of the workers have finished at least once ('finished') and all workers have replied with a
-    // CheckChangeKeyACK message, we can check for termination
-    if(finished && allChecked)
+    EV_DEBUG << "ChangeKeyReceived: "<<counter(ckReceived)<<" ChangeKeySent: "<<counter(ckSent)<<"\n";
+    EV_DEBUG << "Finished: "<<finished<<"\n";
+    // If all of the workers have finished at least once ('finished') and all workers have replied with a
+    // CheckChangeKeyACK message, we can check for termination
+    if(finished && allChecked)
+    {
+        // If the ChangeKeys sent are equal to the ChangeKeys received, terminate simulation (or the pane of a stream)
+        if(counter(ckReceived) == counter(ckSent)) {
+            if(streaming)
+            {
+                // Between panes (e.g. a worker restarted meanwhile) there is nothing to complete
+                if(paneRunning)
+                {
+                    finishPane();
+                }
+                return;
+            }
+            finishJob();
+            return;
+        }
+        
+        // Else, ask all workers to check their ChangeKey queues
+        for(int i = 0; i < numWorkers; i++)
+        {
+            // Spare and retired workers have no ChangeKey queue left to check
+            if(!isActive(i)) continue;
+            ckChecked[i] = 0;   
+            FinishLocalElaborationMessage* finishLocalMsg = finishLocalPool.acquire();
+            finishLocalMsg -> setWorkerId(i);
+            sendToWorker(finishLocalMsg, i);
+        }
+    }
+}
+
+/*
+* Handles a Ping message received from a worker.
+* Updates the pingWorkers structure to register that the worker has replied
+* to the current ping.
+*
+* Parameters:
+*   - msg: A pointer to the PingMessage.
+*   - id: ID of the worker that replied
+*/
+void Leader::handlePingMessage(cMessage *msg, int id)
+{
+    EV_DEBUG << "Ping received from worker: " << id << "\n";
+    pingWorkers[id] = 1;
+    batchesDone[id] = static_cast<PingMessage *>(msg) -> getBatchesDone();
+}
+
+/*
+* Handles the reply of a straggler to a speculation notice.
+* The straggler sets the first batch that the helper may elaborate, the assignment is forwarded to the helper.
+* If the straggler has no local batches left, or its input is still arriving, it declines and the helper is released.
+*
+* Parameters:
+*   - msg: A pointer to the SpeculateMessage.
+*/
+void Leader::handleSpeculateMessage(SpeculateMessage *msg)
+{
+    int ownerId = msg -> getOwnerId();
+    int helperId = msg -> getHelperId();
+
+    if(msg -> getFirstBatch() < 0 || speculationHelper[ownerId] != helperId)
+    {
+        helpingWorker[helperId] = -1;
+        if(speculationHelper[ownerId] == helperId)
+        {
+            // Declined by the owner: it may be a straggler again later
+            speculationHelper[ownerId] = -1;
+        }
+        return;
+    }
+
+    EV_INFO << "Worker " << helperId << " speculating on worker " << ownerId << " from batch " << msg -> getFirstBatch() << "\n";
+    SpeculateMessage* assignMsg = new SpeculateMessage();
+    assignMsg -> setKind(MSG_SPECULATE);
+    assignMsg -> setOwnerId(ownerId);
+    assignMsg -> setHelperId(helperId);
+    assignMsg -> setFirstBatch(msg -> getFirstBatch());
+    assignMsg -> setCancel(false);
+    sendToWorker(assignMsg, helperId);
+    speculationsLaunched++;
+}
+
+/*
+* Handles the credits returned by a worker, which has loaded the data of some of its chunks.
+* The next chunks of its input are sent.
+*
+* Parameters:
+*   - msg: A pointer to the SetupCreditMessage.
+*/
+void Leader::handleSetupCreditMessage(SetupCreditMessage *msg)
+{
+    setupCredits[msg -> getWorkerId()] += msg -> getCredits();
+    pumpSetup();
+}
+
+/*
+* Handles the tuples emitted by the stream source: they are added to the panes of their windows,
+* the panes closed by the watermark (or by the end of the stream) are queued, and the next one is started.
+*
+* Parameters:
+*   - msg: A pointer to the StreamTuplesMessage.
+*/
+void Leader::handleStreamTuplesMessage(StreamTuplesMessage *msg)
+{
+    if(!streaming || streamEnded)
+    {
+        return;
+    }
+
+    double now = SIMTIME_DBL(simTime());
+    for(int i = 0; i < msg -> getValuesArraySize(); i++)
+    {
+        windows.add(msg -> getValues(i), msg -> getEventTimes(i), now);
+    }
+
+    if(msg -> getLast())
+    {
+        windows.closeAll();
+        streamEnded = true;
+    }
+        else
+        {
+            windows.advanceWatermark(msg -> getWatermark());
+        }
+    startNextPane();
+}
+
+/*
+* Checks the status of the current ping.
+* Times out all workers that have failed to reply in time.
+* Reschedules a ping event, and a check ping event.
+*/
+void Leader::checkPing()
+{
+    for(int i = 0; i < numWorkers; i++)
+    {
+        // Spare and retired workers are not pinged
+        if(!isActive(i))
+        {
+            aliveWorkers[i] = 0;
+            pingWorkers[i] = 0;
+            continue;
+        }
+
+        // If worker 'i' has failed to reply to the ping
+        if(pingWorkers[i] == 0)
+        {
+            // Hand its partition to another worker, or force restart the worker.
+            // A leaving worker is not waited for: its partition is handed over from what it persisted
+            bool handedOver = (leavingWorkers[i] != 0) ? completeLeave(i, pingWorkers) : (recoveryMode == "reassign" && reassignPartition(i, pingWorkers));
+            if(!handedOver)
+            {
+                restartWorker(i);
+            }
+        }
+        
+        // A restarted helper has lost its speculative copy
+        if(pingWorkers[i] == 0 && helpingWorker[i] != -1)
+        {
+            helpingWorker[i] = -1;
+        }
+
+        // Reset pingWorkers vector for next ping event
+        aliveWorkers[i] = pingWorkers[i];
+        pingWorkers[i] = 0;
+    }
+
+    // Workers that stopped to leave while no other worker could take over their partition
+    for(int i = 0; i < numWorkers; i++)
+    {
+        if(leavingWorkers[i] == 2)
+        {
+            completeLeave(i, aliveWorkers);
+        }
+    }
+
+    // Workers joining or leaving the job
+    applyScaleEvents();
+
+    // Look for stragglers to speculate on
+    if(speculativeExecution)
+    {
+        launchSpeculation();
+    }
+
+    // Schedule next ping event, and check ping event
+    scheduleAt(simTime() + interval, ping_msg);
+    scheduleAt(simTime() + interval + timeout, check_msg);
+}
+
+/*
+* Forces the restart of a worker that has failed to reply to the ping.
+* The restart message carries the schedule and the current key ownership.
+*
+* Parameters:
+*   - workerId: ID of the failed worker
+*/
+void Leader::restartWorker(int workerId)
+{
+    EV_WARN << "Worker "<< workerId << " is dead. Sending Restart message" << "\n";
+    RestartMessage* restartMsg = new RestartMessage();
+    restartMsg -> setKind(MSG_RESTART);
+    restartMsg -> setWorkerID(workerId);
+
+    // Re-send schedule information (the program run by the workers)
+    restartMsg -> setScheduleArraySize(workerSchedule.size());
+    restartMsg -> setParametersArraySize(workerSchedule.size());
+    restartMsg -> setUpperBoundsArraySize(workerSchedule.size());
+
+    for(int j = 0; j < workerSchedule.size(); j++)
+    {
+        restartMsg -> setSchedule(j, workerSchedule[j].c_str());
+        restartMsg -> setParameters(j, workerParameters[j]);
+        restartMsg -> setUpperBounds(j, workerUpperBounds[j]);
+    }
+
+    // Re-send key ownership, changed by reassignments
+    restartMsg -> setKeyOwnersArraySize(numWorkers);
+    for(int j = 0; j < numWorkers; j++)
+    {
+        restartMsg -> setKeyOwners(j, keyOwner[j]);
+    }
+    restartMsg -> setMembersArraySize(members.size());
+    for(int j = 0; j < members.size(); j++)
+    {
+        restartMsg -> setMembers(j, members[j]);
+    }
+    setPipelineStages(restartMsg);
+    restartMsg -> setSetupComplete(setupComplete[workerId] == 1);
+    sendToWorker(restartMsg, workerId);
+
+    // A leave interrupted by the failure is requested again
+    if(leavingWorkers[workerId] != 0)
+    {
+        sendLeaveRequest(workerId);
+    }
+
+    // The credits of the chunks in flight were lost with the worker: start a new window
+    setupCredits[workerId] = setupWindow;
+    pumpSetup();
+}
+
+/*
+* Reassigns the partition of a failed worker to a live one, instead of waiting for its restart.
+* The adopter is the live worker with the least remaining batches, finished workers first.
+* The whole partition goes to a single adopter, which continues the failed worker's request IDs,
+* so that the receivers' duplicate detection keeps working.
+* All workers are notified, to route the failed worker's keys to the adopter.
+*
+* Parameters:
+*   - failedId: ID of the failed (or leaving) worker
+*   - live: Workers that replied to the last ping
+*
+* Returns:
+*   - true if the partition was reassigned, false if no worker can take it over
+*/
+bool Leader::reassignPartition(int failedId, const std::vector<int>& live)
+{
+    // The input of the failed worker must be complete before another worker elaborates it
+    if(setupComplete[failedId] == 0)
+    {
+        return false;
+    }
+
+    int adopterId = -1;
+    std::pair<int, int> best;
+    for(int i = 0; i < numWorkers; i++)
+    {
+        if(i == failedId || !isActive(i) || live[i] == 0 || leavingWorkers[i] != 0)
+        {
+            continue;
+        }
+        std::pair<int, int> candidate = {1 - finishedWorkers[i], remainingBatches(i)};
+        if(adopterId == -1 || candidate < best)
+        {
+            adopterId = i;
+            best = candidate;
+        }
+    }
+
+    if(adopterId == -1)
+    {
+        return false;
+    }
+
+    if(leavingWorkers[failedId] != 0)
+    {
+        EV_INFO << "Worker " << failedId << " is leaving. Reassigning its partition to worker " << adopterId << "\n";
+    }
+        else
+        {
+            EV_WARN << "Worker "<< failedId << " is dead. Reassigning its partition to worker " << adopterId << "\n";
+        }
+    retiredWorkers[failedId] = 1;
+    reassignments++;
+    for(int i = 0; i < numWorkers; i++)
+    {
+        if(keyOwner[i] == failedId)
+        {
+            keyOwner[i] = adopterId;
+        }
+    }
+
+    // Speculative copies involving the failed worker are dropped
+    cancelSpeculation(failedId);
+    if(helpingWorker[failedId] != -1)
+    {
+        speculationHelper[helpingWorker[failedId]] = -1;
+        helpingWorker[failedId] = -1;
+    }
+
+    // The failed worker's counters and partial result are folded into the adopter's
+    finishedWorkers[failedId] = 1;
+    ckChecked[failedId] = 1;
+    ckSent[failedId] = 0;
+    ckReceived[failedId] = 0;
+    workerResult[failedId].assign(reduceLast ? 1 : 0, 0);
+    verifier -> clearWorkerResult(failedId);
+
+    // The adopter has new local data to elaborate
+    finishedWorkers[adopterId] = 0;
+    ckChecked[adopterId] = 0;
+    finished = false;
+
+    for(int i = 0; i < numWorkers; i++)
+    {
+        if(!isActive(i) && i != failedId) continue;
+        ReassignMessage* reassignMsg = new ReassignMessage();
+        reassignMsg -> setKind(MSG_REASSIGN);
+        reassignMsg -> setFailedId(failedId);
+        reassignMsg -> setAdopterId(adopterId);
+        sendToWorker(reassignMsg, i);
+    }
+    return true;
+}
+
+/*
+* Detects stragglers and launches speculative copies of their remaining batches.
+* A straggler is a worker that has not finished its local data, with at least speculationMinBatches
+* batches left, while some other worker has finished and is idle.
+* Stragglers with the most remaining batches are paired first with the idle workers.
+* The straggler receives a notice, and replies with the first batch the helper may elaborate.
+*/
+void Leader::launchSpeculation()
+{
+    // Collect idle workers
+    std::vector<int> helpers;
+    for(int i = 0; i < numWorkers; i++)
+    {
+        if(finishedWorkers[i] == 1 && aliveWorkers[i] == 1 && helpingWorker[i] == -1 && leavingWorkers[i] == 0)
+        {
+            helpers.push_back(i);
+        }
+    }
+
+    // Collect stragglers, with their remaining batches. Only those whose whole input has been sent:
+    // a helper reading their data from a batch count would miss the chunks still to arrive
+    std::vector<std::pair<int, int>> stragglers;
+    for(int i = 0; i < numWorkers; i++)
+    {
+        int remaining = remainingBatches(i);
+        if(finishedWorkers[i] == 0 && aliveWorkers[i] == 1 && setupComplete[i] == 1 && leavingWorkers[i] == 0 && speculationHelper[i] == -1 && remaining >= speculationMinBatches)
+        {
+            stragglers.push_back({remaining, i});
+        }
+    }
+    std::sort(stragglers.rbegin(), stragglers.rend());
+
+    // Pair stragglers with helpers
+    for(int i = 0; i < stragglers.size() && i < helpers.size(); i++)
+    {
+        int ownerId = stragglers[i].second;
+        int helperId = helpers[i];
+        EV_INFO << "Worker " << ownerId << " is a straggler (" << stragglers[i].first << " batches left), notifying speculation on worker " << helperId << "\n";
+
+        speculationHelper[ownerId] = helperId;
+        helpingWorker[helperId] = ownerId;
+
+        SpeculateMessage* noticeMsg = new SpeculateMessage();
+        noticeMsg -> setKind(MSG_SPECULATE);
+        noticeMsg -> setOwnerId(ownerId);
+        noticeMsg -> setHelperId(helperId);
+        noticeMsg -> setFirstBatch(-1);
+        noticeMsg -> setCancel(false);
+        sendToWorker(noticeMsg, ownerId);
+    }
+}
+
+/*
+* Stops the speculative copy running for the specified straggler, if any.
+*
+* Parameters:
+*   - ownerId: ID of the straggler
+*/
+void Leader::cancelSpeculation(int ownerId)
+{
+    int helperId = speculationHelper[ownerId];
+    if(helperId < 0 || helpingWorker[helperId] != ownerId)
+    {
+        return;
+    }
+
+    SpeculateMessage* cancelMsg = new SpeculateMessage();
+    cancelMsg -> setKind(MSG_SPECULATE);
+    cancelMsg -> setOwnerId(ownerId);
+    cancelMsg -> setHelperId(helperId);
+    cancelMsg -> setFirstBatch(-1);
+    cancelMsg -> setCancel(true);
+    sendToWorker(cancelMsg, helperId);
+
+    helpingWorker[helperId] = -1;
+}
+
+/*
+* Returns whether the specified worker is part of the job: it has joined (spares join on scale-out)
+* and its partition was not reassigned (failed or left the job).
+*/
+bool Leader::isActive(int workerId)
+{
+    return joinedWorkers[workerId] == 1 && retiredWorkers[workerId] == 0;
+}
+
+/*
+* Returns the batches of its local data the specified worker has still to elaborate, from the progress reported with the pings.
+*/
+int Leader::remainingBatches(int workerId)
+{
+    int totalBatches = (workerDataSize[workerId] + workerBatchSize - 1) / workerBatchSize;
+    return std::max(totalBatches - batchesDone[workerId], 0);
+}
+
+/*
+* Parses the scaleEvents parameter: a list of "<time>:<+n|-n>" separated by spaces or commas
+* (e.g. "5s:+2, 40s:-1"), workers joining (+) or leaving (-) the job at the specified simulation time.
+*
+* Parameters:
+*   - events: The scaleEvents parameter
+*/
+void Leader::parseScaleEvents(const std::string& events)
+{
+    std::string list = events;
+    std::replace(list.begin(), list.end(), ',', ' ');
+    std::istringstream iss(list);
+    std::string event;
+    while(iss >> event)
+    {
+        size_t colon = event.find(':');
+        try
+        {
+            if(colon == std::string::npos)
+            {
+                throw std::invalid_argument(event);
+            }
+            std::string time = event.substr(0, colon);
+            if(!time.empty() && time.back() == 's')
+            {
+                time.pop_back();
+            }
+            scaleEvents.push_back({std::stod(time), std::stoi(event.substr(colon + 1))});
+        }
+            catch(const std::logic_error& e)
+            {
+                throw cRuntimeError("Invalid scale event '%s' (expected <time>:<+n|-n>)", event.c_str());
+            }
+    }
+    std::stable_sort(scaleEvents.begin(), scaleEvents.end(), [](const std::pair<simtime_t, int>& a, const std::pair<simtime_t, int>& b) { return a.first < b.first; });
+}
+
+/*
+* Applies the scale events that are due, on the ping check (when the liveness of the workers is known):
+*   - Workers join while spares are left, the rest of the event is dropped
+*   - Workers leave once their input is complete and another worker can take over their partition, otherwise the event is retried at the next check
+* With scaleOutBacklog, a spare also joins when the remaining batches per worker exceed the threshold.
+*/
+void Leader::applyScaleEvents()
+{
+    while(!scaleEvents.empty() && scaleEvents.front().first <= simTime())
+    {
+        int& count = scaleEvents.front().second;
+        while(count > 0 && addWorker())
+        {
+            count--;
+        }
+        while(count < 0 && removeWorker())
+        {
+            count++;
+        }
+
+        if(count < 0)
+        {
+            break;
+        }
+        if(count > 0)
+        {
+            EV_WARN << "No spare worker left to join the job, " << count << " join(s) dropped\n";
+        }
+        scaleEvents.pop_front();
+    }
+
+    if(scaleOutBacklog <= 0)
+    {
+        return;
+    }
+    int backlog = 0;
+    for(int i = 0; i < numWorkers; i++)
+    {
+        if(isActive(i) && finishedWorkers[i] == 0)
+        {
+            backlog += remainingBatches(i);
+        }
+    }
+    if(backlog > scaleOutBacklog * members.size())
+    {
+        EV_INFO << backlog << " batches left for " << members.size() << " workers, scaling out\n";
+        addWorker();
+    }
+}
+
+/*
+* Adds a spare worker to the running job:
+*   - It takes part in the termination condition until it finishes, like the initial workers
+*   - It receives its share of the input not yet sent (see moveInput), in chunks like the initial workers, and the program
+*   - All workers are notified of the new members: the hash, ring and range partitioners route keys to it
+* Once it has finished its share, it is also a helper for speculative copies of the stragglers.
+*
+* Returns:
+*   - false if there is no spare worker left
+*/
+bool Leader::addWorker()
+{
+    int workerId = -1;
+    for(int i = 0; i < numWorkers && workerId == -1; i++)
+    {
+        if(joinedWorkers[i] == 0)
+        {
+            workerId = i;
+        }
+    }
+    if(workerId == -1)
+    {
+        return false;
+    }
+
+    EV_INFO << "Worker " << workerId << " joins the job at " << simTime() << "\n";
+    joinedWorkers[workerId] = 1;
+    aliveWorkers[workerId] = 1;
+    members.push_back(workerId);
+    inputPartitions.push_back(workerId);
+    workersJoined++;
+
+    // The counters of the new worker are part of the termination condition
+    finishedWorkers[workerId] = 0;
+    ckChecked[workerId] = 0;
+    finished = false;
+
+    moveInput(workerId);
+    setupCredits[workerId] = setupWindow;
+    refillSetup(workerId);
+    sendSetupChunk(workerId);
+    sendScheduleToWorker(workerId, workerSchedule, workerParameters, workerUpperBounds);
+    broadcastMembership();
+    pumpSetup();
+    return true;
+}
+
+/*
+* Starts the removal of a worker from the running job: the worker is asked to stop between batches,
+* and its partition is reassigned once it has replied (see completeLeave).
+* The leaving worker is a finished one if possible (nothing left to move), otherwise the one with the least remaining batches.
+*
+* Returns:
+*   - false if no worker can leave now (input not complete, or no other worker to take over)
+*/
+bool Leader::removeWorker()
+{
+    int staying = std::count_if(members.begin(), members.end(), [this](int id) { return leavingWorkers[id] == 0; });
+    if(staying <= 1)
+    {
+        return false;
+    }
+
+    int leavingId = -1;
+    std::pair<int, int> best;
+    for(int i = 0; i < numWorkers; i++)
+    {
+        if(!isActive(i) || aliveWorkers[i] == 0 || setupComplete[i] == 0 || leavingWorkers[i] != 0)
+        {
+            continue;
+        }
+        std::pair<int, int> candidate = {1 - finishedWorkers[i], remainingBatches(i)};
+        if(leavingId == -1 || candidate < best)
+        {
+            leavingId = i;
+            best = candidate;
+        }
+    }
+
+    if(leavingId == -1)
+    {
+        return false;
+    }
+
+    EV_INFO << "Worker " << leavingId << " leaves the job at " << simTime() << ", waiting for it to stop\n";
+    leavingWorkers[leavingId] = 1;
+    sendLeaveRequest(leavingId);
+    return true;
+}
+
+/*
+* Asks a leaving worker to stop between batches, and to reply once its work is persisted.
+*
+* Parameters:
+*   - workerId: ID of the leaving worker
+*/
+void Leader::sendLeaveRequest(int workerId)
+{
+    LeaveMessage* leaveMsg = new LeaveMessage();
+    leaveMsg -> setKind(MSG_LEAVE);
+    leaveMsg -> setWorkerId(workerId);
+    sendToWorker(leaveMsg, workerId);
+}
+
+/*
+* Handles the reply of a leaving worker, which has stopped between batches: its partition is reassigned.
+* A reply of a worker no longer leaving (handed over after a failure), or after the end of the job, is ignored.
+*
+* Parameters:
+*   - msg: A pointer to the LeaveMessage.
+*/
+void Leader::handleLeaveMessage(LeaveMessage *msg)
+{
+    int workerId = msg -> getWorkerId();
+    if(leavingWorkers[workerId] != 1 || finishTime >= 0)
+    {
+        return;
+    }
+
+    leavingWorkers[workerId] = 2;
+    completeLeave(workerId, aliveWorkers);
+}
+
+/*
+* Completes the removal of a worker: its partition is handed to another worker, as for a failed worker
+* in the reassign recovery mode (the adopter folds in its counters, partial result and pending ChangeKeys),
+* and all workers are notified of the new members.
+*
+* Parameters:
+*   - workerId: ID of the leaving worker
+*   - live: Workers that may take over the partition
+*
+* Returns:
+*   - false if no other worker can take over now (retried on the next ping check)
+*/
+bool Leader::completeLeave(int workerId, const std::vector<int>& live)
+{
+    if(!reassignPartition(workerId, live))
+    {
+        return false;
+    }
+
+    EV_INFO << "Worker " << workerId << " left the job at " << simTime() << "\n";
+    leavingWorkers[workerId] = 0;
+    members.erase(std::remove(members.begin(), members.end(), workerId), members.end());
+    workersLeft++;
+    broadcastMembership();
+    return true;
+}
+
+/*
+* Moves to a joining worker its share of the input not yet sent to the other workers: an equal share
+* of the values buffered for them and, for a random job, of the values they have still to receive.
+* The records of a submitted input not yet read are hashed to the new worker too (see inputPartition).
+*
+* Parameters:
+*   - workerId: ID of the joining worker
+*/
+void Leader::moveInput(int workerId)
+{
+    int shares = members.size();
+    for(int i = 0; i < numWorkers; i++)
+    {
+        if(i == workerId || !isActive(i) || setupComplete[i] == 1)
+        {
+            continue;
+        }
+
+        int buffered = pendingSetup[i].size() / shares;
+        for(int j = 0; j < buffered; j++)
+        {
+            pendingSetup[workerId].push_back(pendingSetup[i].back());
+            pendingSetup[i].pop_back();
+        }
+
+        int planned = valuesToGenerate[i] / shares;
+        valuesToGenerate[i] -= planned;
+        valuesToGenerate[workerId] += planned;
+
+        workerDataSize[i] -= buffered + planned;
+        workerDataSize[workerId] += buffered + planned;
+    }
+}
+
+/*
+* Sends the current members to all the workers of the job.
+*/
+void Leader::broadcastMembership()
+{
+    for(int i = 0; i < numWorkers; i++)
+    {
+        if(!isActive(i)) continue;
+        MembershipMessage* membershipMsg = new MembershipMessage();
+        membershipMsg -> setKind(MSG_MEMBERSHIP);
+        membershipMsg -> setMembersArraySize(members.size());
+        for(int j = 0; j < members.size(); j++)
+        {
+            membershipMsg -> setMembers(j, members[j]);
+        }
+        sendToWorker(membershipMsg, i);
+    }
+}
+
+/*
+* Sends a Ping message to all workers
+*/
+void Leader::sendPing()
+{
+    for(int i = 0; i < numWorkers; i++)
+    {
+        if(!isActive(i)) continue;
+        PingMessage *pingMsg = pingPool.acquire();
+        // Set corresponding worker ID
+        pingMsg -> setWorkerId(i);
+        sendToWorker(pingMsg, i);
+    }
+}
+
+/*
+* Sends a message to the specified worker, through the output gate chosen by the routing layer.
+* The message is sized from its payload, and waits for the link if it is busy.
+*/
+void Leader::sendToWorker(RoutedMessage *msg, int workerId)
+{
+    msg -> setSrcAddress(LEADER_ADDRESS);
+    msg -> setDestAddress(workerAddress(workerId));
+    msg -> setJobId(jobId);
+    msg -> setByteLength(messageByteLength(msg, payloadEncoding));
+    msg -> setTimestamp();
+    sendQueued(msg, router.outputGate(workerAddress(workerId)));
+}
+
+/*
+* Handles the creation of the workers' directories.
+* Root dir: "./<dataDir>/" ("./Data/", or "./Data/Job_j/" for the jobs of a LeaderNode)
+* Workers directories: "./<dataDir>/Worker_i/"
+*/
+void Leader::createWorkersDirectory()
+{
+    fs::path dirPath = dataDir;
+    if(!fs::exists(dirPath))
+    {
+        fs::create_directories(dirPath);
+    }
+
+    int numWorkers = par("numWorkers").intValue();
+    fs::path subPath;
+    for(int i = 0; i < numWorkers; i++)
+    {
+        subPath = "Worker_" + std::to_string(i);
+        fs::create_directory(dirPath/subPath);
+    }
+}
+
+/*
+* Handles the removal of all subdirectories and files inside "./<dataDir>/"
+* Called at the beginning of a new simulation (of a new job).
+*/
+void Leader::removeWorkersDirectory()
+{
+    fs::path dirPath = dataDir;
+    // Check if the directory exists before trying to remove it
+    if(fs::exists(dirPath) && fs::is_directory(dirPath))
+    {
+        // Remove the directory and its contents recursively
+        fs::remove_all(dirPath);
+    }
+}
+
+/*
+* Plans the random data of the specified worker:
+* generates a random amount of data between minimum and maximum thresholds.
+* The values are generated chunk by chunk while they are sent (see refillSetup).
+*
+* Parameters:
+*  - idDest: ID of the receiving worker.
+*/
+void Leader::planData(int idDest)
+{
+    // Generate a random dimension for the array of values between minimum and maximum
+    int minimum = par("minDataPerWorker").intValue();
+    int maximum = par("maxDataPerWorker").intValue();
+    int numElements = intuniform(minimum, maximum, DATA_RNG);
+
+    // Update local information on total amount of data (Logging)
+    dataSize += numElements;
+    valuesToGenerate[idDest] = numElements;
+    workerDataSize[idDest] = numElements;
+
+    EV_DETAIL << "Worker " << idDest << " #elements: " << numElements << "\n";
+}
+
+/*
+* Loads the submitted program from the JSON programFile (see ProgramParser.h).
+* The number of partitions can't exceed the number of workers.
+*/
+void Leader::loadProgram()
+{
+    DataflowProgram program;
+    try
+    {
+        ProgramParser parser;
+        program = parser.parseFile(programFile);
+    }
+        catch(const std::runtime_error& e)
+        {
+            throw cRuntimeError("%s", e.what());
+        }
+
+    if(program.partitions > initialWorkers)
+    {
+        throw cRuntimeError("Program file: %d partitions requested, but only %d workers are available", program.partitions, initialWorkers);
+    }
+
+    schedule = program.operators;
+    parameters = program.parameters;
+    scheduleSize = schedule.size();
+
+    // The parameter of a changekey selects its partitioner
+    for(int i = 0; i < scheduleSize; i++)
+    {
+        if(schedule[i] != "changekey") continue;
+        try
+        {
+            parameters[i] = program.partitioners[i].empty() ? defaultPartitioner : Partitioner::parseName(program.partitioners[i]);
+        }
+            catch(const std::runtime_error& e)
+            {
+                throw cRuntimeError("Program file: %s", e.what());
+            }
+    }
+    partitions = (program.partitions == 0) ? initialWorkers : program.partitions;
+    for(int i = 0; i < partitions; i++)
+    {
+        inputPartitions.push_back(i);
+    }
+    // (In the pipelined mode, the partitions are the workers of the first stage, see planPipeline)
+    reduceLast = (schedule.back() == "reduce");
+
+    EV_INFO << "Loaded program " << programFile << " (" << scheduleSize << " operators, " << partitions << " partitions)\n";
+}
+
+/*
+* Opens the input CSV files of the submitted job. Their records are then streamed to the workers
+* ingestChunkSize lines at a time, as the workers' credits allow (see refillSetup).
+*/
+void Leader::openInput()
+{
+    inputFiles = InputReader::splitFileList(par("inputFiles").stdstringValue());
+    inputColumn = par("inputColumn").intValue();
+    ingestChunkSize = par("ingestChunkSize").intValue();
+    if(inputFiles.empty())
+    {
+        throw cRuntimeError("A program file was submitted without inputFiles");
+    }
+
+    try
+    {
+        inputReader = new InputReader(inputFiles, inputColumn, ingestChunkSize);
+    }
+        catch(const std::runtime_error& e)
+        {
+            throw cRuntimeError("%s", e.what());
+        }
+}
+
+/*
+* Fills the buffer of the specified worker up to one chunk, from the random generator or the input files.
+* Input records are hashed to their partition, so reading for a worker also fills the buffers of the others:
+* the input is not read further while setupWindow chunks per worker are buffered, until credits return.
+* The expected result is updated with every value produced.
+*
+* Parameters:
+*  - workerId: ID of the worker
+*
+* Returns:
+*  - true if no more values will be produced for the worker
+*/
+bool Leader::refillSetup(int workerId)
+{
+    if(!receivesInput(workerId))
+    {
+        return true;
+    }
+    if(streaming)
+    {
+        // The tuples of a pane are all distributed when it starts
+        return paneRunning;
+    }
+    if(programFile.empty())
+    {
+        while(pendingSetup[workerId].size() < setupChunkSize && valuesToGenerate[workerId] > 0)
+        {
+            // Generate a random int value between 1 and 100
+            int value = intuniform(1, 100, DATA_RNG);
+            pendingSetup[workerId].push_back(value);
+            pendingSetupValues++;
+            valuesToGenerate[workerId]--;
+            trackExpected(value);
+        }
+        peakPendingSetup = std::max(peakPendingSetup, pendingSetupValues);
+        return valuesToGenerate[workerId] == 0;
+    }
+
+    long long maxPending = (long long)setupChunkSize * setupWindow * numWorkers;
+    while(pendingSetup[workerId].size() < setupChunkSize && inputReader != nullptr && pendingSetupValues < maxPending)
     {
-        // If the ChangeKeys sent are equal to the ChangeKeys received, terminate simulation
-        if(counter(ckReceived) == counter(ckSent)) {
-            for(int i = 0; i < numWorkers; i++)
+        std::vector<int> chunk;
+        try
+        {
+            chunk = inputReader -> nextChunk();
+        }
+            catch(const std::runtime_error& e)
             {
-                FinishSimMessage* finishSimMsg = new FinishSimMessage();
-                finishSimMsg -> setWorkerId(i);
-                send(finishSimMsg, "out", i);
-                stopPing = true;
+                throw cRuntimeError("%s", e.what());
             }
-            return;
+
+        if(chunk.empty())
+        {
+            // All the input has been read
+            dataSize = inputReader -> getRecordsRead();
+            EV_INFO << "Ingested " << inputReader -> getRecordsRead() << " records from " << inputFiles.size() << " file(s), " << inputReader -> getLinesSkipped() << " lines skipped\n";
+            EV_INFO << "Records per worker: " << formatVector(workerDataSize) << "\n";
+            delete inputReader;
+            inputReader = nullptr;
+            break;
         }
-        
-        // Else, ask all workers to check their ChangeKey queues
-        for(int i = 0; i < numWorkers; i++)
+
+        for(int value : chunk)
         {
-            ckChecked[i] = 0;   
-            FinishLocalElaborationMessage* finishLocalMsg = new FinishLocalElaborationMessage();
-            finishLocalMsg -> setWorkerId(i);
-            send(finishLocalMsg, "out", i);
+            int dest = inputPartition(value);
+            pendingSetup[dest].push_back(value);
+            pendingSetupValues++;
+            workerDataSize[dest]++;
+            trackExpected(value);
         }
     }
+    peakPendingSetup = std::max(peakPendingSetup, pendingSetupValues);
+    return inputReader == nullptr;
 }
 
 /*
-* Handles a Ping message received from a worker.
-* Updates the pingWorkers structure to register that the worker has replied
-* to the current ping.
+* Sends the next chunk (up to setupChunkSize values) of the specified worker's input, using one credit.
+* The first chunk initializes the worker, the following ones are appended to its data.
 *
 * Parameters:
-*   - msg: A pointer to the PingMessage.
-*   - id: ID of the worker that replied
+*  - workerId: ID of the receiving worker
 */
-void Leader::handlePingMessage(cMessage *msg, int id)
+void Leader::sendSetupChunk(int workerId)
 {
-    EV << "Ping received from worker: " << id << "\n";
-    pingWorkers[id] = 1;
+    bool exhausted = !receivesInput(workerId) || (streaming ? paneRunning : (programFile.empty() ? (valuesToGenerate[workerId] == 0) : (inputReader == nullptr)));
+    int chunkSize = std::min<int>(setupChunkSize, pendingSetup[workerId].size());
+
+    SetupMessage *msg = new SetupMessage();
+    msg -> setKind(MSG_SETUP);
+    msg -> setAssigned_id(workerId);
+    msg -> setAppend(chunksSent[workerId] > 0);
+    msg -> setWindow(paneRunning ? currentPane.index : -1);
+    msg -> setDataArraySize(chunkSize);
+    for(int j = 0; j < chunkSize; j++)
+    {
+        msg -> setData(j, pendingSetup[workerId].front());
+        pendingSetup[workerId].pop_front();
+    }
+    pendingSetupValues -= chunkSize;
+    emit(setupBufferedSignal, pendingSetupValues);
+    msg -> setLast(exhausted && pendingSetup[workerId].empty());
+
+    setupComplete[workerId] = msg -> getLast() ? 1 : 0;
+    setupCredits[workerId]--;
+    chunksSent[workerId]++;
+    sendToWorker(msg, workerId);
 }
 
 /*
-* Checks the status of the current ping.
-* Times out all workers that have failed to reply in time.
-* Reschedules a ping event, and a check ping event.
+* Sends chunks to the workers with credits left, until no full chunk (or last chunk) can be sent.
 */
-void Leader::checkPing()
+void Leader::pumpSetup()
 {
-    for(int i = 0; i < numWorkers; i++)
+    bool sent = true;
+    while(sent)
     {
-        // If worker 'i' has failed to reply to the ping
-        if(pingWorkers[i] == 0)
+        sent = false;
+        for(int i = 0; i < numWorkers; i++)
         {
-            // Force restart the worker
-            EV << "Worker "<< i << " is dead. Sending Restart message" << "\n";
-            RestartMessage* restartMsg = new RestartMessage();
-            restartMsg -> setWorkerID(i);
-
-            // Re-send schedule information
-            restartMsg -> setScheduleArraySize(scheduleSize);
-            restartMsg -> setParametersArraySize(scheduleSize);
-
-            for(int j = 0; j < scheduleSize; j++)
+            if(joinedWorkers[i] == 0 || setupComplete[i] == 1 || setupCredits[i] <= 0)
+            {
+                continue;
+            }
+            bool exhausted = refillSetup(i);
+            if(pendingSetup[i].size() >= setupChunkSize || exhausted)
             {
-                restartMsg -> setSchedule(j, schedule[j].c_str());
-                restartMsg -> setParameters(j, parameters[j]);
+                sendSetupChunk(i);
+                sent = true;
             }
-            send(restartMsg, "out", i);
         }
-        
-        // Reset pingWorkers vector for next ping event
-        pingWorkers[i] = 0;
     }
-
-    // Schedule next ping event, and check ping event
-    scheduleAt(simTime() + interval, ping_msg);
-    scheduleAt(simTime() + interval + timeout, check_msg);
 }
 
 /*
-* Sends a Ping message to all workers
+* Starts the elaboration of the next closed pane of the stream, if none is running: its tuples are distributed
+* to the workers as the chunks of a new round, which ends with the termination condition (see finishPane).
+* Empty panes are completed at once. Once the stream has ended and its last pane is done, the job finishes.
 */
-void Leader::sendPing()
+void Leader::startNextPane()
 {
-    for(int i = 0; i < numWorkers; i++)
+    while(!paneRunning && windows.hasClosedPane())
     {
-        PingMessage *pingMsg = new PingMessage();
-        // Set corresponding worker ID
-        pingMsg -> setWorkerId(i);
-        send(pingMsg, "out", i);
+        currentPane = windows.nextClosedPane();
+        if(currentPane.values.empty())
+        {
+            emitWindows(windows.completePane(currentPane, 0, 0, SIMTIME_DBL(simTime())));
+            continue;
+        }
+
+        int expectedBefore = data[0];
+        for(int value : currentPane.values)
+        {
+            int dest = inputPartition(value);
+            pendingSetup[dest].push_back(value);
+            pendingSetupValues++;
+            workerDataSize[dest]++;
+            trackExpected(value);
+        }
+        dataSize += currentPane.values.size();
+        peakPendingSetup = std::max(peakPendingSetup, pendingSetupValues);
+        paneExpected = data[0] - expectedBefore;
+        paneRunning = true;
+
+        // New round of the termination condition: the first chunk of the pane restarts the elaboration on each worker
+        finished = false;
+        for(int i = 0; i < numWorkers; i++)
+        {
+            if(!isActive(i)) continue;
+            finishedWorkers[i] = 0;
+            ckChecked[i] = 0;
+            setupComplete[i] = 0;
+            setupCredits[i] = setupWindow;
+        }
+        pumpSetup();
+    }
+
+    if(!paneRunning && streamEnded && finishTime < 0)
+    {
+        finishJob();
     }
 }
 
 /*
-* Handles the creation of the workers' directories.
-* Root dir: "./Data/"
-* Workers directories: "./Data/Worker_i/"
+* Completes the running pane, once the workers have elaborated all its tuples:
+* the reduce of the pane is the growth of the sum of the workers' partial results since the previous pane.
+* The windows ending with the pane are emitted, and the next pane is started.
 */
-void Leader::createWorkersDirectory()
+void Leader::finishPane()
 {
-    fs::path dirPath = "Data";
-    if(!fs::exists(dirPath))
-    {
-        fs::create_directory(dirPath);
-    }
-
-    int numWorkers = par("numWorkers").intValue();
-    fs::path subPath;
+    long long total = 0;
     for(int i = 0; i < numWorkers; i++)
     {
-        subPath = "Worker_" + std::to_string(i);
-        fs::create_directory(dirPath/subPath);
+        total += workerResult[i][0];
     }
+    long long paneResult = total - streamedReduce;
+    streamedReduce = total;
+    paneRunning = false;
+
+    emitWindows(windows.completePane(currentPane, paneResult, paneExpected, SIMTIME_DBL(simTime())));
+    startNextPane();
 }
 
 /*
-* Handles the removal of all subdirectories and files inside "./Data/"
-* Called at the beginning of a new simulation.
+* Emits the results of completed windows: printed, and written to '<dataDir>/windows.csv' with their latency.
+*
+* Parameters:
+*   - results: The windows completed by a pane
 */
-void Leader::removeWorkersDirectory()
+void Leader::emitWindows(const std::vector<WindowResult>& results)
 {
-    fs::path dirPath = "Data";
-    // Check if the directory exists before trying to remove it
-    if(fs::exists(dirPath) && fs::is_directory(dirPath))
+    const char* unit = windows.isCountWindows() ? " tuples" : "s";
+    for(const WindowResult& window : results)
     {
-        // Remove the directory and its contents recursively
-        fs::remove_all(dirPath);
+        bool correct = (window.result == window.expected);
+        EV_INFO << "Window " << window.index << " [" << window.start << ", " << window.end << ")" << unit << ": " << window.tuples << " tuples, result " << window.result;
+        EV_INFO << (correct ? " (correct)" : " (incorrect, expected " + std::to_string(window.expected) + ")") << ", latency " << window.latency << "s\n";
+
+        windowsFile << window.index << "," << window.start << "," << window.end << "," << window.tuples << "," << window.result << "," << window.expected << ",";
+        windowsFile << simTime() << "," << window.latency << "," << window.tupleLatency << "\n";
+
+        windowsEmitted++;
+        if(!correct)
+        {
+            incorrectWindows++;
+        }
+        emit(windowLatencySignal, window.latency);
+        totalWindowLatency += window.latency;
+        maxWindowLatency = std::max(maxWindowLatency, window.latency);
+        totalTupleLatency += window.tupleLatency;
     }
 }
 
 /*
-* Handles generation and sending of data to the worker specified.
-* Creates a Setup message to hold all necessary information.
-* Generates a random amount of data between minimum and maximum thresholds
-* Loads information in the Setup message
-* Sends message to specified worker
+* Returns the worker that receives the specified input record.
+* Records are distributed by a multiplicative hash of their value over the program's partitions,
+* and over the workers that joined the job since. The high bits of the hash select the partition,
+* as in the HASH partitioner: the low bits of a multiplicative hash are poorly mixed.
 *
 * Parameters:
-*  - idDest: ID of the receiving worker.
+*  - value: The input record
 */
-void Leader::sendData(int idDest)
+int Leader::inputPartition(int value)
 {
-    // Instantiate a new SetupMessage
-    SetupMessage *msg = new SetupMessage();
-    std::vector<int> currentData;
-    msg -> setAssigned_id(idDest); // Assign idDest to the worker
-    
-    // Generate a random dimension for the array of values between minimum and maximum
-    int minimum = 50;
-    int maximum = 60;
-    int numElements = minimum + rand() % (maximum - minimum + 1);
-
-    // Update local information on total amount of data (Logging)
-    dataSize += numElements;
-
-    std::cout << "#elements: " << numElements << "\n";
-    
-    // Set array size information in message
-    msg -> setDataArraySize(numElements);
-    
-    std::cout << "Array: ";
-    
-    // Generate numElements data points
-    for(int j = 0; j < numElements; j++)
-    {
-         // Generate a random int value between 1 and 100
-        int value = (rand() % 100) + 1;
-        std::cout << value << " ";
-        // Set this value as j-th element of the array
-        msg -> setData(j, value);
-
-        // Keep track of data for the final calculation of the result
-        data.push_back(value);
-        currentData.push_back(value);
-    }
-    // Again, keep track of data
-    dataMatrix.push_back(currentData);
-    std::cout << "\n" << "\n";
-    
-    // Send the SetupMessage
-    send(msg, "out", idDest);
+    uint32_t hash = static_cast<uint32_t>(value) * 2654435761u;
+    return inputPartitions[(static_cast<uint64_t>(hash) * inputPartitions.size()) >> 32];
 }
 
 /*
-* Handles generation and sending of the schedule to all workers.
+* Handles generation of the schedule.
 * Selects a schedule size between minScheduleSize and maxScheduleSize
 * Randomly chooses whether the schedule should end in reduce or not
 * Defines number of filter operations based on the length of the schedule
 *
 * Generates a schedule for the generated length, with randomly generated parameters.
-* Sends the schedule and parameters to all workers
 */
-void Leader::sendSchedule()
+void Leader::generateSchedule()
 {
     const std::vector<std::string> operations = {"add", "sub", "mul", "div", "gt", "lt", "ge", "le", "changekey", "reduce"};
     int numOperations = operations.size();
 
     // Setting bounds for schedule size
-    int minScheduleSize = 8;
-    int maxScheduleSize = 20;
+    int minScheduleSize = par("minScheduleSize").intValue();
+    int maxScheduleSize = par("maxScheduleSize").intValue();
     // Generate a scheduleSize between min and max
-    scheduleSize = minScheduleSize + rand() % (maxScheduleSize - minScheduleSize + 1);
+    scheduleSize = intuniform(minScheduleSize, maxScheduleSize, SCHEDULE_RNG);
 
     schedule.resize(scheduleSize);
     parameters.resize(scheduleSize);
@@ -787,12 +2223,12 @@ void Leader::sendSchedule()
     int maxFilters = numberOfFilters(scheduleSize);
     
     // Decide if reduce should be the last operation
-    bool includeReduceLast = (rand() % 2 == 0); // 50-50 chance
+    bool includeReduceLast = streaming || (intuniform(0, 1, SCHEDULE_RNG) == 0); // 50-50 chance, always with the windows of a stream
     bool reduceScheduled = false;
 
     for (int i = 0; i < scheduleSize; ++i) {
         // Randomly choose an operation in the vector
-        int opIndex = rand() % numOperations;
+        int opIndex = intuniform(0, numOperations - 1, SCHEDULE_RNG);
         std::string op = operations[opIndex];
 
         // Ensure that the reduce is only scheduled as last operation
@@ -802,7 +2238,7 @@ void Leader::sendSchedule()
             // Prevent reduce from being selected unless it's the last operation
             // Also ensure we are not adding filters above the threshold            
             while ((op == "reduce") || (isFilterOperation(op) && maxFilters <= 0)) {
-                opIndex = rand() % numOperations;
+                opIndex = intuniform(0, numOperations - 1, SCHEDULE_RNG);
                 op = operations[opIndex];
             }
         }
@@ -817,9 +2253,212 @@ void Leader::sendSchedule()
         }
     }
 
-    // Send the schedule to all workers
-    for (int workerID = 0; workerID < numWorkers; workerID++) {
-        sendScheduleToWorker(workerID, schedule, parameters);
+}
+
+/*
+* Prepares the program run by the workers: the schedule rewritten by the ProgramOptimizer
+* if optimizeProgram is set, the schedule as-is otherwise.
+* The submitted schedule is kept to compute the expected result.
+*/
+void Leader::prepareWorkerSchedule()
+{
+    ProgramOptimizer optimizer(schedule, parameters);
+    if(optimizeProgram)
+    {
+        optimizer.optimize();
+    }
+    workerSchedule = optimizer.getSchedule();
+    workerParameters = optimizer.getParameters();
+    workerUpperBounds = optimizer.getUpperBounds();
+
+    if(optimizer.getRewrites() > 0)
+    {
+        EV_INFO << "Optimized program (" << optimizer.getRewrites() << " rewrites): ";
+        for(size_t i = 0; i < workerSchedule.size(); i++)
+        {
+            EV_INFO << workerSchedule[i] << "(" << workerParameters[i];
+            if(workerSchedule[i] == "range")
+            {
+                EV_INFO << ".." << workerUpperBounds[i];
+            }
+            EV_INFO << ") ";
+        }
+        EV_INFO << "\n";
+    }
+}
+
+/*
+* Pipelined mode: splits the workers' program in stages, and maps each stage onto a set of workers.
+*   - pipelineStages = 0: the stages are the segments between changekeys (adjacent segments are merged,
+*     by cost, when there are more segments than workers)
+*   - pipelineStages = n: n stages of balanced cost; a hash changekey is inserted at the cuts that
+*     don't follow a changekey, to move the values to the next stage
+* Workers are given to the stages in proportion to their cost (at least one each). Only the workers of the
+* first stage receive input; the changekey closing a stage routes each value to a worker of the next one.
+*/
+void Leader::planPipeline()
+{
+    if(executionMode != "pipeline")
+    {
+        return;
+    }
+
+    // Cost of a step, weighted by the fraction of values left by the filters before it (half per filter).
+    // The same weights place the cuts and give the workers to the stages
+    auto weightedCost = [this](int i)
+    {
+        int filters = std::count_if(workerSchedule.begin(), workerSchedule.begin() + i, [this](const std::string& op) { return isFilterOperation(op) || op == "range"; });
+        return stepCost(workerSchedule[i]) * std::pow(0.5, filters);
+    };
+
+    int steps = workerSchedule.size();
+    std::vector<double> cumulative(steps + 1, 0); // Cost of the steps before each position
+    for(int i = 0; i < steps; i++)
+    {
+        cumulative[i + 1] = cumulative[i] + weightedCost(i);
+    }
+
+    // Positions where a stage may start
+    std::vector<int> candidates;
+    for(int p = 1; p < steps; p++)
+    {
+        if(pipelineStages > 0 || workerSchedule[p - 1] == "changekey")
+        {
+            candidates.push_back(p);
+        }
+    }
+    int stages = (pipelineStages > 0) ? pipelineStages : (int)candidates.size() + 1;
+    stages = std::max(1, std::min({stages, numWorkers, (int)candidates.size() + 1}));
+
+    // Cut j at the candidate closest to j / stages of the total cost, after the previous cut
+    std::vector<int> cuts;
+    size_t next = 0;
+    for(int j = 1; j < stages; j++)
+    {
+        double target = cumulative[steps] * j / stages;
+        size_t best = next;
+        // Leave enough candidates for the remaining cuts
+        for(size_t c = next; c + (stages - 1 - j) < candidates.size(); c++)
+        {
+            if(std::abs(cumulative[candidates[c]] - target) < std::abs(cumulative[candidates[best]] - target))
+            {
+                best = c;
+            }
+        }
+        cuts.push_back(candidates[best]);
+        next = best + 1;
+    }
+
+    // Cuts not following a changekey get one (inserted from the last, to keep the positions of the others)
+    for(int j = cuts.size() - 1; j >= 0; j--)
+    {
+        int p = cuts[j];
+        if(workerSchedule[p - 1] == "changekey") continue;
+        workerSchedule.insert(workerSchedule.begin() + p, "changekey");
+        workerParameters.insert(workerParameters.begin() + p, PARTITIONER_HASH);
+        workerUpperBounds.insert(workerUpperBounds.begin() + p, 0);
+        for(int k = j; k < cuts.size(); k++)
+        {
+            cuts[k]++;
+        }
+    }
+
+    // Stage of each step: a stage starts at each cut
+    steps = workerSchedule.size();
+    stageOfStep.assign(steps + 1, 0);
+    std::vector<double> stageCost(stages, 0);
+    for(int i = 0, stage = 0; i <= steps; i++)
+    {
+        while(stage < cuts.size() && i >= cuts[stage])
+        {
+            stage++;
+        }
+        stageOfStep[i] = stage;
+        if(i < steps)
+        {
+            stageCost[stage] += weightedCost(i);
+        }
+    }
+
+    // One worker per stage, then the others to the stage with the highest cost per worker
+    stageWorkers.assign(stages, 1);
+    for(int w = stages; w < numWorkers; w++)
+    {
+        int busiest = 0;
+        for(int j = 1; j < stages; j++)
+        {
+            if(stageCost[j] / stageWorkers[j] > stageCost[busiest] / stageWorkers[busiest])
+            {
+                busiest = j;
+            }
+        }
+        stageWorkers[busiest]++;
+    }
+    stageOfWorker.clear();
+    for(int j = 0; j < stages; j++)
+    {
+        stageOfWorker.insert(stageOfWorker.end(), stageWorkers[j], j);
+    }
+
+    // The input is partitioned over the workers of the first stage
+    inputPartitions.clear();
+    for(int i = 0; i < stageWorkers[0]; i++)
+    {
+        inputPartitions.push_back(i);
+    }
+
+    EV_INFO << "Pipeline: " << stages << " stages, step stages: " << formatVector(stageOfStep) << ", workers per stage: " << formatVector(stageWorkers) << "\n";
+}
+
+/*
+* Returns the relative cost of an operation on a data point, for the pipeline planning: the mean time per tuple
+* in the cost model of the Workers, with the fixed cost spread over a batch (the reduce about ten times slower
+* than the other operations, if the first worker can't be found).
+*/
+double Leader::stepCost(const std::string& operation)
+{
+    cModule *worker = workerModule(0);
+    if(worker == nullptr)
+    {
+        return operation == "reduce" ? 10 : 1;
+    }
+    std::string kind = operation;
+    if(isFilterOperation(operation) || operation == "range")
+    {
+        kind = "filter";
+    }
+        else if(operation != "changekey" && operation != "reduce")
+        {
+            kind = "map";
+        }
+    CostModel costs;
+    costs.set(kind, worker -> par((kind + "Cost").c_str()).doubleValue(), worker -> par((kind + "ItemCost").c_str()).doubleValue(), 0);
+    return costs.perItem(kind, worker -> par("batchSize").intValue());
+}
+
+/*
+* Returns whether the specified worker receives input: every worker, or the workers of the first stage in the pipelined mode.
+*/
+bool Leader::receivesInput(int workerId)
+{
+    return stageOfWorker.empty() || stageOfWorker[workerId] == 0;
+}
+
+/*
+* Adds the stages of the pipelined mode to a Schedule or Restart message (nothing in schedule mode).
+*/
+template <typename T>
+void Leader::setPipelineStages(T *msg)
+{
+    msg -> setStageOfStepArraySize(stageOfStep.size());
+    for(size_t i = 0; i < stageOfStep.size(); i++)
+    {
+        msg -> setStageOfStep(i, stageOfStep[i]);
+    }
+    msg -> setStageOfWorkerArraySize(stageOfWorker.size());
+    for(size_t i = 0; i < stageOfWorker.size(); i++)
+    {
+        msg -> setStageOfWorker(i, stageOfWorker[i]);
     }
 }
 
@@ -849,14 +2488,16 @@ bool Leader::isFilterOperation(const std::string& operation){
 int Leader::generateParameter(const std::string& operation) {
         if (operation == "le" || operation == "lt") {
             // Return high values for le/lt to avoid filtering out too many values
-            return 60 + rand() % 41; // Range [60, 100]
+            return intuniform(60, 100, SCHEDULE_RNG); // Range [60, 100]
         } else if (operation == "ge" || operation == "gt") {
             // Same logic but for ge/gt operations
-            return rand() % 41; // Range [0, 40]
-        } else if (operation == "changekey" || operation == "reduce") {
+            return intuniform(0, 40, SCHEDULE_RNG); // Range [0, 40]
+        } else if (operation == "changekey") {
+            return defaultPartitioner; // The parameter of a changekey selects its partitioner
+        } else if (operation == "reduce") {
             return 0;
         } else {
-            return (rand() % 10) + 1; // General case
+            return intuniform(1, 10, SCHEDULE_RNG); // General case
         }
 }
 
@@ -867,22 +2508,31 @@ int Leader::generateParameter(const std::string& operation) {
 *  - workerID: ID of the receiving worker
 *  - schedule: Generated schedule
 *  - parameters: Generated parameters
+*  - upperBounds: Upper bounds of the "range" operations
 */
-void Leader::sendScheduleToWorker(int workerID, const std::vector<std::string>& schedule, const std::vector<int>& parameters) {
-        std::cout << "Sending schedule to worker " << workerID << ": ";
+void Leader::sendScheduleToWorker(int workerID, const std::vector<std::string>& schedule, const std::vector<int>& parameters, const std::vector<int>& upperBounds) {
+        EV_DETAIL << "Sending schedule to worker " << workerID << ": ";
         ScheduleMessage *msg = new ScheduleMessage();
+        msg -> setKind(MSG_SCHEDULE);
         msg->setDestWorker(workerID);
         msg->setScheduleArraySize(schedule.size());
         msg->setParametersArraySize(schedule.size());
+        msg->setUpperBoundsArraySize(schedule.size());
+        msg->setMembersArraySize(members.size());
 
         for (size_t i = 0; i < schedule.size(); ++i) {
             msg->setSchedule(i, schedule[i].c_str());
             msg->setParameters(i, parameters[i]);
-            std::cout << schedule[i] << "(" << parameters[i] << ") ";
+            msg->setUpperBounds(i, upperBounds[i]);
+            EV_DETAIL << schedule[i] << "(" << parameters[i] << ") ";
+        }
+        for (size_t i = 0; i < members.size(); ++i) {
+            msg->setMembers(i, members[i]);
         }
+        setPipelineStages(msg);
 
-        send(msg, "out", workerID);
-        std::cout << "\n";
+        sendToWorker(msg, workerID);
+        EV_DETAIL << "\n";
 }
 
 /*
@@ -909,32 +2559,25 @@ int Leader::numberOfFilters(int scheduleSize)
 
 void Leader::printingVector(std::vector<int> vector)
 {
-    for(int i = 0; i < vector.size(); i++)
-    {
-        if(i < vector.size()-1)
-        {
-            std::cout<<vector[i]<<", ";
-        }
-            else
-            {
-                std::cout<<vector[i];
-            }
-    }
+    std::cout << formatVector(vector);
 }
 
-void Leader::printingStringVector(std::vector<std::string> vector)
+// Returns the elements of the vector separated by commas (for the log)
+std::string Leader::formatVector(const std::vector<int>& vector)
 {
-    for(int i = 0; i < vector.size(); i++)
+    std::ostringstream out;
+    for(size_t i = 0; i < vector.size(); i++)
     {
         if(i < vector.size()-1)
         {
-            std::cout<< "\"" <<vector[i] << "\"" <<", ";
+            out << vector[i] << ", ";
         }
             else
             {
-                std::cout<< "\"" <<vector[i] << "\"";
+                out << vector[i];
             }
     }
+    return out.str();
 }
 
 int Leader::counter(std::vector<int> vec)
@@ -947,9 +2590,20 @@ int Leader::counter(std::vector<int> vec)
     return count;
 }
 
+// Returns the module of the specified worker of the job (nullptr if it does not exist)
+cModule* Leader::workerModule(int id)
+{
+    cModule *worker = getSimulation()->getSystemModule()->getSubmodule("worker", id);
+    if(worker != nullptr && !worker -> hasPar("batchSize"))
+    {
+        worker = worker -> getSubmodule("job", jobId); // Worker node: the worker of this job
+    }
+    return worker;
+}
+
 void Leader::getWorkerData()
 {
-    cModule *worker = getParentModule()->getSubmodule("worker", 0); // Access the first worker
+    cModule *worker = workerModule(0); // Access the first worker
     if(worker != nullptr)
     {
         // Accessing parameters
@@ -958,70 +2612,155 @@ void Leader::getWorkerData()
     }
 }
 
-void Leader::logSimData()
+/*
+* Puts together the state timelines of the workers (see StateTimeline.h), from the start to the completion of the job:
+*   - writes them to '<dataDir>/timeline.csv' (worker, state, peer, start, end)
+*   - prints the utilization of every worker (processing and loading over the completion time) and the largest
+*     shares of the critical path, by bottleneck (e.g. blocked on DataInsert ACKs to a worker) and by worker
+*   - records the utilization and the critical-path share of each state as scalars
+*/
+void Leader::analyzeTimelines()
 {
-    // Capture the simulation end time
-    simtime_t endTime = simTime();
-
-    // Calculate duration
-    simtime_t duration = endTime - startTime;
-
-    // Write duration to a file
-    std::string logDir = "./Logs";
-    fs::path parentDir = fs::path(logDir) / fs::path(EXPERIMENT_NAME);
-    int maxId = -1;
-
-    // Ensure the parent directory exists
-	if(!fs::exists(logDir)) {
-		fs::create_directory(logDir);
-	}
-
-    if (!fs::exists(parentDir)) {
-        fs::create_directory(parentDir);
+    if(finishTime < 0)
+    {
+        return;
     }
-
-    // Scan existing folders to find the max ID
-    for(const auto& entry : fs::directory_iterator(parentDir))
+    double start = SIMTIME_DBL(startTime);
+    double end = SIMTIME_DBL(finishTime);
+    double completion = end - start;
+
+    std::vector<std::vector<StateSegment>> timelines(numWorkers);
+    std::ofstream timelineFile(dataDir + "/timeline.csv");
+    timelineFile << "worker,state,peer,start,end\n";
+    double totalUtilization = 0;
+    double minUtilization = 1;
+    int busyWorkers = 0;
+    std::cout << "Worker utilization (share of the completion time):\n";
+    for(int i = 0; i < numWorkers; i++)
     {
-        if(entry.is_directory())
+        TimelineSource *source = dynamic_cast<TimelineSource*>(workerModule(i));
+        if(source == nullptr)
         {
-            std::string folderName = entry.path().filename().string();
-            try
+            continue;
+        }
+        // Segments within the job
+        for(StateSegment segment : source -> getTimeline().getSegments(end))
+        {
+            segment.start = std::max(segment.start, start);
+            segment.end = std::min(segment.end, end);
+            if(segment.end > segment.start)
             {
-                int folderId = std::stoi(folderName);
-                maxId = std::max(maxId, folderId);
+                timelines[i].push_back(segment);
+                timelineFile << i << "," << workerStateName(segment.state) << "," << segment.peer << "," << segment.start << "," << segment.end << "\n";
             }
-                catch(const std::invalid_argument& e)
-                {
-                // Not a number-named folder, ignore
-                }
         }
-    }
 
-    // Determine the folder name for the new simulation
-    int newFolderId = maxId + 1;
-    fs::path newFolderPath = parentDir / std::to_string(newFolderId);
+        std::vector<double> times(STATE_COUNT, 0);
+        for(const StateSegment& segment : timelines[i])
+        {
+            times[segment.state] += segment.end - segment.start;
+        }
+        double utilization = (times[STATE_PROCESSING] + times[STATE_LOADING]) / completion;
+        if(utilization > 0)
+        {
+            totalUtilization += utilization;
+            minUtilization = std::min(minUtilization, utilization);
+            busyWorkers++;
+        }
+        std::cout << "  Worker " << i << ": " << 100 * utilization << "%";
+        for(int state = 0; state < STATE_COUNT; state++)
+        {
+            if(times[state] > 0 && state != STATE_PROCESSING && state != STATE_LOADING)
+            {
+                std::cout << ", " << workerStateName(state) << " " << 100 * times[state] / completion << "%";
+            }
+        }
+        std::cout << "\n";
+    }
+    timelineFile.close();
+    if(busyWorkers == 0)
+    {
+        return;
+    }
 
-    // Create the folder for the new simulation
-    if(fs::create_directory(newFolderPath))
+    // Critical path, by bottleneck (state and worker waited for, over all workers) and by worker
+    std::vector<CriticalPathEntry> path = criticalPath(timelines, start, end);
+    std::map<std::pair<int, int>, double> bottlenecks;
+    std::vector<double> stateShares(STATE_COUNT, 0);
+    for(const CriticalPathEntry& entry : path)
     {
-        std::cout << "Created directory for simulation ID: " << newFolderId << "\n";
+        bottlenecks[{entry.state, entry.peer}] += entry.time;
+        stateShares[entry.state] += entry.time / completion;
     }
-        else
+    std::vector<std::pair<double, std::pair<int, int>>> sorted;
+    for(const auto& bottleneck : bottlenecks)
+    {
+        sorted.push_back({bottleneck.second, bottleneck.first});
+    }
+    std::sort(sorted.rbegin(), sorted.rend());
+
+    auto describe = [](int state, int peer)
+    {
+        switch(state)
         {
-            std::cerr << "Failed to create directory for new simulation.q";
-            return; // Error
+            case STATE_PROCESSING: return std::string("processing");
+            case STATE_LOADING: return std::string("loading batches");
+            case STATE_WAITING_INSERT: return "blocked on DataInsert ACKs to worker " + std::to_string(peer);
+            case STATE_WAITING_CREDIT: return std::string("waiting for insert credits");
+            case STATE_WAITING_INPUT: return std::string("waiting for input chunks");
+            case STATE_RESTARTING: return std::string("restarting after a failure");
+            default: return std::string("no worker busy (termination protocol, failures)");
         }
-
-    std::string fileName = newFolderPath.string() + "/SIM_" + std::to_string(numWorkers) + "_" + std::to_string(workerFailureProbability) + "_" + std::to_string(dataSize) + "_" + std::to_string(workerBatchSize) + "_" + std::to_string(scheduleSize) + ".log"; 
-    std::ofstream outFile(fileName);
-    if(outFile.is_open())
+    };
+    std::cout << "Critical path (" << completion << "s):\n";
+    for(int i = 0; i < sorted.size() && i < 5; i++)
     {
-        outFile << duration;
-        outFile.close();
+        std::cout << "  " << 100 * sorted[i].first / completion << "% of completion time was " << describe(sorted[i].second.first, sorted[i].second.second) << "\n";
     }
-        else
+    std::cout << "By worker:\n";
+    for(int i = 0; i < path.size() && i < 5; i++)
+    {
+        std::cout << "  " << 100 * path[i].time / completion << "%: worker " << path[i].worker << " " << describe(path[i].state, path[i].peer) << "\n";
+    }
+
+    recordScalar("utilizationMean", totalUtilization / busyWorkers);
+    recordScalar("utilizationMin", minUtilization);
+    for(int state = 0; state < STATE_COUNT; state++)
+    {
+        if(stateShares[state] > 0)
         {
-            EV << "Error opening file for writing simulation duration.\n";
+            recordScalar((std::string("criticalPath:") + workerStateName(state)).c_str(), stateShares[state]);
         }
+    }
+}
+
+/*
+* Records the scalars of the job in the result files: duration, input size, program size, completion time and
+* throughput, recovery and elasticity counters, and the statistics of the received messages.
+*/
+void Leader::recordStatistics()
+{
+    recordScalar("duration", simTime() - startTime, "s");
+    recordScalar("dataSize", dataSize);
+    recordScalar("scheduleSize", schedule.size());
+    recordScalar("numWorkers", numWorkers);
+    if(finishTime >= 0)
+    {
+        recordScalar("completionTime", finishTime - startTime, "s");
+        recordScalar("throughput", dataSize / SIMTIME_DBL(finishTime - startTime), "values/s");
+    }
+    recordScalar("referenceExecutions", referenceExecutions);
+    recordScalar("workerExecutions", workerExecutions);
+    recordScalar("speculationsLaunched", speculationsLaunched);
+    recordScalar("reassignments", reassignments);
+    recordScalar("workersJoined", workersJoined);
+    recordScalar("workersLeft", workersLeft);
+    recordScalar("peakSetupBuffered", peakPendingSetup);
+    if(streaming)
+    {
+        recordScalar("lateTuples", windows.getLateTuples());
+        recordScalar("windowsEmitted", windowsEmitted);
+        recordScalar("incorrectWindows", incorrectWindows);
+    }
+    messageStats.recordScalars(this);
 }
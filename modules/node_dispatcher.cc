@@ -0,0 +1,107 @@
+#include <string>
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+#include <omnetpp.h>
+
+#include "routed_m.h"
+
+#include "Routing.h"
+#include "QueuedSender.h"
+#include "JobQueue.h"
+#include "CpuScheduler.h"
+
+using namespace omnetpp;
+
+/*
+* Dispatcher of a node running several jobs (WorkerNode, LeaderNode):
+*	- Messages from the network are handed to the module of their job (job ID of the message)
+*	- Messages of the jobs are sent towards their destination, with the node's address and the network topology,
+*	  and share the node's links (one queue per output gate)
+* On worker nodes, it also shares the processor between the jobs, by the weights of the job queue (see CpuScheduler).
+*/
+class NodeDispatcher : public QueuedSender, public CpuScheduler{
+private:
+	Router router;
+	int address;
+
+	std::vector<long long> jobMessagesIn; // Messages delivered to each job
+	std::vector<long long> jobMessagesOut; // Messages sent by each job
+	long long dropped;
+
+protected:
+	virtual void initialize() override;
+	virtual void handleMessage(cMessage *msg) override;
+	virtual void finish() override;
+};
+
+Define_Module(NodeDispatcher);
+
+void NodeDispatcher::initialize(){
+	address = par("address").intValue();
+	if(address < 0) {
+		address = workerAddress(getParentModule()->getIndex());
+	}
+	router = Router(par("topology").stdstringValue(), address);
+
+	std::vector<JobSpec> jobs;
+	try {
+		jobs = parseJobQueue(par("jobQueue").stdstringValue());
+	} catch(const std::logic_error& e) {
+		throw cRuntimeError("Invalid job queue entry '%s' (expected <program>[@<time>][*<weight>])", e.what());
+	}
+	std::vector<double> weights;
+	for(const JobSpec& job : jobs) {
+		weights.push_back(job.weight);
+	}
+	weights.resize(gateSize("jobOut"), 1);
+	setWeights(weights);
+
+	jobMessagesIn.assign(gateSize("jobOut"), 0);
+	jobMessagesOut.assign(gateSize("jobOut"), 0);
+	dropped = 0;
+}
+
+/*
+* Forwards a message to the module of its job, or to the network.
+*/
+void NodeDispatcher::handleMessage(cMessage *msg){
+	if(handleTransmitTimer(msg)) {
+		return;
+	}
+
+	RoutedMessage *routedMsg = dynamic_cast<RoutedMessage *>(msg);
+	if(routedMsg == nullptr) {
+		EV_WARN << "Dispatcher received a message without address - dropped\n";
+		delete msg;
+		return;
+	}
+
+	int job = routedMsg->getJobId();
+	if(job < 0 || job >= gateSize("jobOut")) {
+		EV_WARN << "Dispatcher of node " << address << " has no job " << job << " - dropped\n";
+		dropped++;
+		delete msg;
+		return;
+	}
+
+	if(msg->getArrivalGate()->isName("jobIn")) {
+		jobMessagesOut[job]++;
+		sendQueued(routedMsg, router.outputGate(routedMsg->getDestAddress()));
+		return;
+	}
+
+	jobMessagesIn[job]++;
+	send(routedMsg, "jobOut", job);
+}
+
+void NodeDispatcher::finish(){
+	std::cout << "Node " << address << " dispatcher - dropped: " << dropped << ", queued on busy links: " << getQueuedPackets() << ", total queueing delay: " << getTotalQueueingDelay() << "\n";
+	for(int job = 0; job < gateSize("jobOut"); job++) {
+		std::cout << "Node " << address << " - Job " << job << " (weight " << getWeight(job) << ") messages in: " << jobMessagesIn[job] << ", out: " << jobMessagesOut[job];
+		if(getRequestedTime(job) > 0) {
+			std::cout << ", processor time: " << getRequestedTime(job) << "s, on the shared processor: " << getSharedTime(job) << "s";
+		}
+		std::cout << "\n";
+	}
+}
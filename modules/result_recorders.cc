@@ -0,0 +1,35 @@
+#include <string>
+#include <utility>
+#include <omnetpp.h>
+
+#include "StreamingHistogram.h"
+
+using namespace omnetpp;
+
+/*
+* Result recorder "percentiles" (record=...,percentiles in a @statistic): keeps the values in a StreamingHistogram,
+* whose memory does not grow with the length of the run, and records the median, the 90th and the 99th percentile
+* as scalars at the end of the simulation (e.g. "batchTime:p99").
+*/
+class PercentileRecorder : public cNumericResultRecorder{
+private:
+	StreamingHistogram histogram;
+
+protected:
+	virtual void collect(simtime_t_cref t, double value, cObject *details) override;
+	virtual void finish(cResultFilter *prev) override;
+};
+
+Register_ResultRecorder("percentiles", PercentileRecorder);
+
+void PercentileRecorder::collect(simtime_t_cref t, double value, cObject *details){
+	histogram.collect(value);
+}
+
+void PercentileRecorder::finish(cResultFilter *prev){
+	static const std::pair<const char*, double> percentiles[] = {{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}};
+	for(const auto& percentile : percentiles) {
+		std::string name = std::string(getStatisticName()) + ":" + percentile.first;
+		getComponent()->recordScalar(name.c_str(), histogram.quantile(percentile.second));
+	}
+}
@@ -0,0 +1,155 @@
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <omnetpp.h>
+
+#include "streamTuples_m.h"
+
+#include "MessageKinds.h"
+#include "MessageSizes.h"
+
+using namespace omnetpp;
+
+/*
+* Source of a continuous input: emits tuples to the Leader, which processes them window by window.
+*	- rate source: Poisson arrivals at the configured rate, with random values in [1, 100], until the duration
+*	- replay: the records of a CSV file ("<timestamp>,<value>"), emitted at their timestamp (relative to the first one)
+* Event times may lag the emission by up to maxOutOfOrderness (random for the rate source, from the timestamps of the replay):
+* the watermark sent with the tuples lags the emission time by the same amount.
+* The tuples emitted during each emitInterval are sent together.
+*/
+class StreamSource : public cSimpleModule{
+private:
+	cModule *leader;
+	simtime_t emitInterval;
+	simtime_t maxOutOfOrderness;
+
+	// Rate source
+	double rate;
+	simtime_t duration;
+	simtime_t nextArrival;
+
+	// Replay of a CSV file: event time (s, relative to the first record), value
+	std::vector<std::pair<double, int>> records;
+	size_t nextRecord;
+	bool replay;
+
+	cMessage *emitMsg;
+	long long tuplesEmitted;
+	long long linesSkipped;
+
+	void loadRecords(const std::string& fileName);
+
+protected:
+	virtual void initialize() override;
+	virtual void handleMessage(cMessage *msg) override;
+	virtual void finish() override;
+};
+
+Define_Module(StreamSource);
+
+void StreamSource::initialize(){
+	leader = getParentModule()->getSubmodule(par("target").stdstringValue().c_str());
+	if(leader == nullptr || !leader->hasGate("streamIn")) {
+		throw cRuntimeError("The stream source needs a Leader module named '%s'", par("target").stdstringValue().c_str());
+	}
+	emitInterval = par("emitInterval");
+	maxOutOfOrderness = par("maxOutOfOrderness");
+	rate = par("rate").doubleValue();
+	duration = par("duration");
+	tuplesEmitted = 0;
+	linesSkipped = 0;
+	nextRecord = 0;
+
+	replay = !par("replayFile").stdstringValue().empty();
+	if(replay) {
+		loadRecords(par("replayFile").stdstringValue());
+	} else if(rate <= 0) {
+		throw cRuntimeError("The stream source needs a rate > 0, or a replayFile");
+	} else {
+		nextArrival = simTime() + exponential(1 / rate);
+	}
+
+	emitMsg = new cMessage("emitTuples");
+	scheduleAt(simTime() + emitInterval, emitMsg);
+}
+
+/*
+* Reads the records of the replay file; lines without a numeric timestamp and value (e.g. headers) are skipped.
+*/
+void StreamSource::loadRecords(const std::string& fileName){
+	std::ifstream file(fileName);
+	if(!file.is_open()) {
+		throw cRuntimeError("Can't open replay file: %s", fileName.c_str());
+	}
+	std::string line;
+	while(std::getline(file, line)) {
+		std::replace(line.begin(), line.end(), ',', ' ');
+		std::istringstream fields(line);
+		double timestamp;
+		int value;
+		if(fields >> timestamp >> value) {
+			records.push_back({timestamp, value});
+		} else {
+			linesSkipped++;
+		}
+	}
+	if(!records.empty()) {
+		double first = records.front().first;
+		for(auto& record : records) {
+			record.first = SIMTIME_DBL(simTime()) + record.first - first;
+		}
+	}
+}
+
+/*
+* Emits the tuples due since the previous emission, with the current watermark.
+*/
+void StreamSource::handleMessage(cMessage *msg){
+	simtime_t now = simTime();
+	StreamTuplesMessage *tuplesMsg = new StreamTuplesMessage();
+	tuplesMsg->setKind(MSG_STREAM_TUPLES);
+
+	bool last;
+	if(replay) {
+		// Records are emitted in file order: a record whose timestamp is behind the previous ones is out of order
+		while(nextRecord < records.size() && records[nextRecord].first <= now) {
+			tuplesMsg->appendValues(records[nextRecord].second);
+			tuplesMsg->appendEventTimes(records[nextRecord].first);
+			nextRecord++;
+		}
+		last = nextRecord == records.size();
+	} else {
+		while(nextArrival <= now && nextArrival < duration) {
+			tuplesMsg->appendValues(intuniform(1, 100));
+			tuplesMsg->appendEventTimes(SIMTIME_DBL(nextArrival) - uniform(0, SIMTIME_DBL(maxOutOfOrderness)));
+			nextArrival += exponential(1 / rate);
+		}
+		last = nextArrival >= duration;
+	}
+	tuplesEmitted += tuplesMsg->getValuesArraySize();
+	tuplesMsg->setWatermark(SIMTIME_DBL(now - maxOutOfOrderness));
+	tuplesMsg->setLast(last);
+	tuplesMsg->setTimestamp();
+	tuplesMsg->setByteLength(messageByteLength(tuplesMsg));
+	sendDirect(tuplesMsg, leader, "streamIn");
+
+	if(last) {
+		std::cout << "Stream source: end of the stream at " << now << "s, " << tuplesEmitted << " tuples emitted\n";
+		return;
+	}
+	scheduleAt(now + emitInterval, emitMsg);
+}
+
+void StreamSource::finish(){
+	std::cout << "Stream source - tuples emitted: " << tuplesEmitted;
+	if(replay) {
+		std::cout << " of " << records.size() << " records, lines skipped: " << linesSkipped;
+	}
+	std::cout << "\n";
+	cancelAndDelete(emitMsg);
+}
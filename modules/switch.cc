@@ -0,0 +1,79 @@
+#include <string>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <omnetpp.h>
+
+#include "routed_m.h"
+
+#include "Routing.h"
+#include "QueuedSender.h"
+
+using namespace omnetpp;
+
+/*
+* Switch of the star and rack topologies: forwards each message to the output port
+* towards its destination address (see Router::switchPort for the port layout).
+* Messages wait in a queue per output port while its link is busy.
+*/
+class Switch : public QueuedSender{
+private:
+	std::string role;
+	int rack;
+	int workersPerRack;
+
+	long long forwarded;
+	std::vector<long long> portMessages; // Messages forwarded on each output port
+
+protected:
+	virtual void initialize() override;
+	virtual void handleMessage(cMessage *msg) override;
+	virtual void finish() override;
+};
+
+Define_Module(Switch);
+
+void Switch::initialize(){
+	role = par("role").stdstringValue();
+	rack = par("rack").intValue();
+	workersPerRack = par("workersPerRack").intValue();
+	forwarded = 0;
+	portMessages.assign(gateSize("out"), 0);
+}
+
+/*
+* Forwards a message to the port towards its destination.
+*/
+void Switch::handleMessage(cMessage *msg){
+	if(handleTransmitTimer(msg)) {
+		return;
+	}
+
+	RoutedMessage *routedMsg = dynamic_cast<RoutedMessage *>(msg);
+	if(routedMsg == nullptr) {
+		EV_WARN << "Switch received a message without address - dropped\n";
+		delete msg;
+		return;
+	}
+
+	int port = Router::switchPort(role, rack, workersPerRack, routedMsg->getDestAddress());
+	if(port < 0 || port >= gateSize("out") || !gate("out", port)->isConnected()) {
+		EV_WARN << "Switch has no route to address " << routedMsg->getDestAddress() << " - dropped\n";
+		delete msg;
+		return;
+	}
+
+	routedMsg->setHops(routedMsg->getHops() + 1);
+	forwarded++;
+	portMessages[port]++;
+	sendQueued(routedMsg, port);
+}
+
+void Switch::finish(){
+	long long busiestPort = 0;
+	for(long long messages : portMessages) {
+		busiestPort = std::max(busiestPort, messages);
+	}
+	std::cout << "Switch " << getFullName() << " (" << role << ") forwarded " << forwarded << " messages, busiest port: " << busiestPort;
+	std::cout << ", queued: " << getQueuedPackets() << ", peak queue: " << getPeakQueueLength() << "\n";
+}
@@ -5,6 +5,7 @@
 #include <omnetpp.h>
 #include <algorithm>
 #include <deque>
+#include <array>
 
 #include "setup_m.h"
 #include "datainsert_m.h"
@@ -16,57 +17,84 @@
 #include "finishSim_m.h"
 #include "nextstep_m.h"
 #include "pingres_m.h"
+#include "speculate_m.h"
+#include "speculativeCommit_m.h"
+#include "reassign_m.h"
+#include "setupCredit_m.h"
+#include "membership_m.h"
+#include "insertCredit_m.h"
+#include "leave_m.h"
 
 #include "BatchLoader.h"
 #include "InsertManager.h"
+#include "Partitioner.h"
+#include "MessagePool.h"
+#include "MessageKinds.h"
+#include "Routing.h"
+#include "MessageSizes.h"
+#include "QueuedSender.h"
+#include "CpuScheduler.h"
+#include "StateTimeline.h"
+#include "CostModel.h"
 
-#define EXPERIMENT_NAME "Increasing_Batch_Size"
 
-#define LEADER_PORT 0
-
-// ----- Fast operations -----
-
-#define PING_DELAY_AVG 0.0001
-#define PING_DELAY_STD 0.001
-
-#define FINISH_EXEC_DELAY_AVG 0.0002
-#define FINISH_EXEC_DELAY_STD 0.001
-
-#define MAP_EXEC_TIME_AVG 0.003
-#define MAP_EXEC_TIME_STD 0.001
-
-#define FILTER_EXEC_TIME_AVG 0.003
-#define FILTER_EXEC_TIME_STD 0.001
-
-// (Fast when local)
-#define CHANGEKEY_EXEC_TIME_AVG 0.003
-#define CHANGEKEY_EXEC_TIME_STD 0.001
-
-// ----- Medium-duration operations -----
+using namespace omnetpp;
 
-#define REDUCE_EXEC_TIME_AVG 0.03
-#define REDUCE_EXEC_TIME_STD 0.01
+// RNG stream of the trace sampling (module-local index): tracing does not change the delays and failures (stream 0),
+// nor the random data of the Leader (stream 1)
+#define TRACE_RNG 2
 
-// ----- Medium to slow-duration operations -----
+// Elaboration in progress when a worker fails: the work lost, and redone after the restart, is accounted by phase
+enum FailurePhase {
+	PHASE_LOCAL, // Local batch (own, or speculative copy)
+	PHASE_CHANGEKEY, // ChangeKey batch, from the InsertManager
+	PHASE_REDUCE, // Reduce of a batch
+	PHASE_COUNT
+};
 
-#define BATCH_LOAD_TIME_AVG 0.3
-#define BATCH_LOAD_TIME_STD 0.1
+static const char* failurePhaseNames[PHASE_COUNT] = {"localBatch", "ckBatch", "reduce"};
 
-// ----- Slow operations -----
-#define RESTART_DELAY_AVG 1
-#define RESTART_DELAY_STD 0.2
+// ChangeKey data point waiting to be sent (deferred or committed)
+struct PendingInsert {
+	int newKey;
+	int value;
+	int scheduleStep;
+	int origin; // Worker whose request IDs are used to send it
+	TupleTrace trace; // Trace of the data point, if it is traced (not persisted with the outbox)
+};
 
-using namespace omnetpp;
+// Partition of a failed worker taken over by this worker.
+// Its data is elaborated with the failed worker's request IDs, so that re-sent ChangeKeys are still recognized as duplicates.
+struct AdoptedPartition {
+	int workerId;
+	int changeKeyCtr;
+	int committedBatch; // Last batch committed by a speculative copy of the failed worker
+	BatchLoader* loader;
+	InsertManager* insertManager; // Holds the ChangeKey batch in progress at the failure
+};
 
-class Worker : public cSimpleModule{
+class Worker : public QueuedSender, public TimelineSource{
 private:
 	// Data structures to hold batch, and insertions in progress
 	std::map<int, std::deque<int>> data;
 
-	DataInsertMessage* unstableMessage;
+	// DataInsert waiting for its ACK: the message is rebuilt from this record on every (re)transmission
+	PendingInsert unstableInsert;
+	int unstableReqID;
 	cMessage* insertTimeoutMsg;
 
+	// Recycled messages of the high-frequency exchanges
+	MessagePool<DataInsertMessage> insertPool{MSG_DATA_INSERT};
+	MessagePool<PingMessage> pingPool{MSG_PING};
+	MessagePool<FinishLocalElaborationMessage> finishLocalPool{MSG_FINISH_LOCAL};
+	long long tuplesProcessed; // Data points taken from the schedule queues
+
+	// Handlers of the received messages, indexed by kind, and their statistics
+	std::array<void (*)(Worker*, cMessage*), MSG_KIND_COUNT> dispatchTable;
+	MessageStats messageStats;
+
 	// Information on working folder and files
+	std::string dataDir; // Root of the workers' persistent state ("<dataDir>/Worker_i/")
 	std::string folder;
 	std::string fileName;
 	std::string fileProgressName;
@@ -78,11 +106,20 @@ private:
 	// Worker information
 	int workerId;
 	int numWorkers;
+	Router router; // Output gate towards each address, for the configured topology
+	PayloadEncoding payloadEncoding; // Encoding of the data-carrying payloads, for their byte length
+	int jobId; // Job of the messages sent by the worker
+	int nodeIndex; // Index of the worker node, the worker's address (the module index, unless it runs on a WorkerNode)
+	CpuScheduler* cpuScheduler; // Processor shared with the other jobs of the WorkerNode (nullptr: dedicated)
 	int changeKeyCtr;
 	float failureProbability;
 	float changeKeyProbability;
+	Partitioner partitioner; // Routing of the changekey operations (selected by their parameter)
+	std::vector<int> stageOfStep; // Pipelined mode: stage running each step (empty: this worker runs the whole schedule)
+	std::vector<Partitioner> stagePartitioners; // Pipelined mode: routing over the workers of each stage
 	bool failed;
 	float insertTimeout;
+	double speedFactor;
 
 	// For ChangeKey protocol
 	int changeKeySent; //to be saved
@@ -97,6 +134,13 @@ private:
 	bool previousLocal;
 	bool idle;
 
+	// Chunked input from the leader
+	bool setupComplete; // The last chunk of the input has been received
+	bool waitingForSetup; // Local data exhausted, waiting for the next chunk
+	std::deque<std::streampos> chunkEnds; // End of the received chunks in the data file, a credit is returned once loaded
+	int window; // Pane of a streamed input being elaborated (-1: none yet, or batch input)
+	simtime_t firstResultTime; // End of the first batch (time-to-first-result)
+
 	// General Elaboration Information
 	bool finishedLocalElaboration;
 	bool finishedPartialCK;
@@ -104,11 +148,53 @@ private:
 	bool finishNoticeSent;
 	std::vector<std::string> schedule;
 	std::vector<int> parameters;
+	std::vector<int> upperBounds; // Upper bound of "range" operations
+	long long operatorExecutions; // Operations applied to data points
 
 	// Partial Results
 	int tmpReduce;
+	int lastBatchReduce; // Reduce of the current batch, not yet persisted
 	std::vector<int> tmpResult;
 
+	// Tuple-level tracing (traceSampling > 0)
+	TupleTracer tracer; // Traces of the sampled tuples of the batch
+	TupleTrace currentTrace; // Trace of the data point in elaboration
+	long long tuplesTraced; // Input tuples sampled for tracing
+
+	// Speculative execution - Owner side
+	int currentLocalBatch; // Index of the local batch being elaborated
+	int speculationStart; // First local batch that may be committed by a speculative copy (-1 if none)
+	std::vector<PendingInsert> deferredSends; // ChangeKeys of the current batch, sent only once it is committed
+	std::deque<PendingInsert> outbox; // Committed ChangeKeys waiting to be sent
+	bool outboxInFlight;
+	bool batchStarted; // The outbox is only sent between batches
+
+	// Speculative execution - Helper side
+	int speculativeOwner; // Worker whose batches are being re-executed (-1 if none)
+	BatchLoader* speculativeLoader;
+	bool speculativeBatch; // Current batch is a speculative copy
+	int speculativeBatchIndex;
+	std::vector<PendingInsert> routedData; // ChangeKeys of the speculative batch, sent by the owner on commit
+	int speculativeCommitsAccepted;
+	int speculativeCommitsRejected;
+
+	// Credit-based back-pressure of ChangeKey data (insertWindow > 0)
+	int insertWindow; // Credits granted to every sender, in data points
+	std::vector<int> insertCredits; // Credits held for each receiver
+	std::deque<int> creditDebtors; // Sender of each remote data point received and not yet drained
+	size_t peakCreditDebtors;
+	long long creditStalls; // Times the outbox had ChangeKeys, but no credits to send any
+
+	// Partition reassignment (Recovery mode)
+	std::vector<int> keyOwner; // Worker currently owning each key
+	std::deque<AdoptedPartition> adoptedPartitions;
+	int batchOrigin; // Worker whose request IDs are used for the current batch
+	bool retired; // Partition reassigned to another worker, never restarts
+
+	// Graceful leave
+	bool leaving; // The Leader asked this worker to leave the job
+	bool stoppedToLeave; // Stopped between batches for the leave, until the partition is reassigned
+
 	// Event Message holders
 	PingResMessage *pingResEvent;
 	NextStepMessage *nextStepMsg;
@@ -116,12 +202,34 @@ private:
 	// Ping reply holder
 	PingMessage *replyPingMsg;
 
-	// Parameter conversion for lognormal distribution
-	std::map<std::string, std::pair<double, double>> lognormal_params;
-
-	// Others - For Logging (Ignore)
-	std::map<std::string, std::vector<simtime_t>> per_op_exec_times;
-	std::vector<simtime_t> per_schedule_exec_times;
+	// Simulated time of the operations (see the cost parameters of the Worker)
+	CostModel costModel;
+	int chargedStep; // Step whose fixed cost was charged in the current batch (-1: none)
+
+	// Statistics (see the @statistic declarations of the Worker)
+	simsignal_t batchTimeSignal;
+	std::map<std::string, simsignal_t> operatorTimeSignals; // "<operator>Time", recorded as the "operatorTime" template
+	simsignal_t changeKeyBacklogSignal;
+	simsignal_t outboxLengthSignal;
+	simsignal_t shuffleBytesSignal;
+	std::map<int, simsignal_t> tupleLatencySignals; // By ChangeKey hops, recorded as the "tupleLatency" template
+	simsignal_t tupleBacklogWaitSignal;
+	StateTimeline timeline; // States of the worker, put together by the Leader after the run (kept across restarts)
+
+	// Wasted work of the failures, by phase (kept across restarts)
+	std::array<long long, PHASE_COUNT> failuresByPhase;
+	std::array<long long, PHASE_COUNT> wastedExecutions; // Operator executions of the lost batches
+	std::array<long long, PHASE_COUNT> reloadedTuples; // Tuples of the lost batches reloaded at restart (progress offset, ck_batch.csv)
+	std::array<long long, PHASE_COUNT> duplicateInserts; // Re-sent ChangeKeys dropped by the InsertManager, by phase of the sender
+	long long retransmittedDuplicates; // Duplicates of ChangeKeys re-sent on timeout, by a sender not recovering
+	std::array<double, PHASE_COUNT> recoveryTimes; // From the failure until the lost work is redone (s)
+	long long batchExecutions; // Operator executions of the current batch
+	int recoveryPhase; // Phase of the failure being recovered (-1: none)
+	simtime_t failureTime;
+	bool lostBatch; // A batch was in elaboration at the failure: it is reloaded and redone
+	bool redoPending; // The reloaded batch is not persisted yet
+	size_t replayOutbox; // ChangeKeys reloaded from the outbox at restart, not delivered yet
+	simsignal_t recoveryTimeSignal;
 	simtime_t begin_op;
 	simtime_t begin_batch;
 	simtime_t begin_elab;
@@ -132,27 +240,43 @@ protected:
 
 	// Message handling
 	virtual void handleMessage(cMessage *msg) override;
+	const StateTimeline& getTimeline() const override;
 	void handlePingMessage(cMessage *msg);
 	void handleSetupMessage(SetupMessage *msg);
 	void handleScheduleMessage(ScheduleMessage *msg);
 	void handleDataInsertMessage(DataInsertMessage *msg);
+	void handleInsertAck();
 	void handleFinishLocalElaborationMessage(FinishLocalElaborationMessage *msg);
 	void handleFinishSimMessage(FinishSimMessage *msg);
 	void handleRestartMessage(RestartMessage *msg);
+	void handleSpeculateMessage(SpeculateMessage *msg);
+	void handleSpeculativeCommitMessage(SpeculativeCommitMessage *msg);
+	void handleReassignMessage(ReassignMessage *msg);
+	void handleMembershipMessage(MembershipMessage *msg);
+	void handleInsertCreditMessage(InsertCreditMessage *msg);
+	void handleLeaveMessage(LeaveMessage *msg);
+	template <typename T> void updateMembers(const T *msg);
+	template <typename T> void updateStages(const T *msg);
+	void initializeDispatchTable();
+	void schedulePingResponse();
 
 	// Processing data
 	void processStep();
 	void processReduce();
 	void loadNextBatch();
+	void returnSetupCredits();
+	void startWindow();
+	void loadSpeculativeBatch();
+	bool loadAdoptedBatch();
 	bool applyOperation(int& value);
 
 	// Next event scheduling
-	float calculateDelay(const std::string& operation);
+	float calculateDelay(const std::string& operation, long items = 1, bool fixed = true);
 
 	// Worker operations
 	int map(std::string operation, int parameter, int data);
 	bool filter(std::string operation, int parameter, int data);
-	int changeKey(int data, float probability);
+	int changeKey(int data, int partitionerType, int selfId);
 	int reduce(std::vector<int> data);
 
 	//Crash related functions
@@ -163,21 +287,48 @@ protected:
 	void deallocatingMemory();
 
 	// ChangeKey Remote Data Insertion
-	void sendData(int newKey, int value, int scheduleStep);
+	void sendData(int newKey, int value, int scheduleStep, int origin, const TupleTrace& trace = TupleTrace());
+	void transmitInsert(int destWorker);
+	int& requestCounter(int origin);
+	bool sendOutboxFront();
+	void completeOutboxFront();
+
+	// Credit-based back-pressure
+	bool hasInsertCredit(int newKey);
+	void returnInsertCredits(int drained);
+	void resetInsertCredits();
+
+	// Speculative execution
+	bool commitLocalBatch();
+	void sendSpeculativeCommit();
+	void endSpeculation();
+
+	// Partition reassignment
+	void drainForLeave();
+	void adoptPartition(int failedId, bool merge);
+	void loadAdoptedPartitions();
+	void releaseAdoptedPartitions();
+	AdoptedPartition* findAdoptedPartition(int origin);
+	void persistAdoptedCounter(const AdoptedPartition& partition);
+
+	// Message recycling statistics
+	long long messageAllocations() const;
+	long long messageReuses() const;
 
 	// Network utilities
-	int getWorkerGate(int destID);
-	int getInboundWorkerID(int gateIndex);
+	void sendTo(RoutedMessage *msg, int destAddress);
+	std::string workerFolder(int id) const;
 
 	// Persisting functions
 	void persistingResult(std::vector<int> result);
 	void persistingReduce(int reduce);
 	void persistCKSentReceived();
 	void persistCKCounter();
+	void persistOutbox();
+	void loadOutbox();
 
 	// Delay distrbution utils
-	void convertParameters();
-	std::pair<double, double> calculateDistributionParams(double mean, double std);
+	void setupCostModel();
 
 	// Other utils
 	void loadSavedResult();
@@ -185,7 +336,15 @@ protected:
 	void printScheduledData(std::map<int, std::deque<int>> data);
 	void printDataInsertMessage(DataInsertMessage* msg, bool recv);
 	bool isScheduleEmpty();
-	void logSimData();
+	void recordStatistics();
+	void emitOperatorTime(const std::string& operation, simtime_t duration);
+	void setState(int state, int peer = -1);
+	int batchPhase() const;
+	void recordFailure(int phase);
+	void checkRecovered(simtime_t now);
+	void countDuplicate(int phase);
+	std::vector<TupleTrace> traceInput(size_t count);
+	void recordTraces();
 	std::string getParentOperation(const std::string& op);
 };
 
@@ -196,7 +355,7 @@ Define_Module(Worker);
 *	- Failure probability (x/1000)
 *	- ChangeKey probability
 *	- DataInsert timeout duration
-*	- Conversion of parameters for lognormal distribution (Check function for more details)
+*	- Cost model of the operations (Check function for more details)
 */
 void Worker::initialize(){
 	// Initializing variables to avoid segfaults
@@ -209,6 +368,7 @@ void Worker::initialize(){
 
 	// Current Batch Elaboration information
 	currentScheduleStep = 0;
+	chargedStep = -1;
 
 	// General Elaboration Information
 	finishedLocalElaboration = false;
@@ -218,22 +378,97 @@ void Worker::initialize(){
 
 	// Partial Results
 	tmpReduce = 0;
+	lastBatchReduce = 0;
 	std::vector<int> tmpResult = {};
 
+	// Speculative execution
+	currentLocalBatch = -1;
+	speculationStart = -1;
+	outboxInFlight = false;
+	batchStarted = false;
+	speculativeOwner = -1;
+	speculativeLoader = nullptr;
+	speculativeBatch = false;
+	speculativeBatchIndex = -1;
+	speculativeCommitsAccepted = 0;
+	speculativeCommitsRejected = 0;
+
+	// Partition reassignment
+	batchOrigin = -1;
+	retired = false;
+	leaving = false;
+	stoppedToLeave = false;
+
+	operatorExecutions = 0;
+	tuplesProcessed = 0;
+	unstableReqID = -1;
+
+	setupComplete = false;
+	waitingForSetup = false;
+	window = -1;
+	firstResultTime = -1;
+
+	batchTimeSignal = registerSignal("batchTime");
+	changeKeyBacklogSignal = registerSignal("changeKeyBacklog");
+	outboxLengthSignal = registerSignal("outboxLength");
+	shuffleBytesSignal = registerSignal("shuffleBytes");
+	tupleBacklogWaitSignal = registerSignal("tupleBacklogWait");
+	tracer = TupleTracer(par("traceSampling").doubleValue());
+	tuplesTraced = 0;
+
+	// Wasted work of the failures
+	failuresByPhase.fill(0);
+	wastedExecutions.fill(0);
+	reloadedTuples.fill(0);
+	duplicateInserts.fill(0);
+	recoveryTimes.fill(0);
+	retransmittedDuplicates = 0;
+	batchExecutions = 0;
+	recoveryPhase = -1;
+	lostBatch = false;
+	redoPending = false;
+	replayOutbox = 0;
+	recoveryTimeSignal = registerSignal("recoveryTime");
+
 	batchSize = par("batchSize").intValue();
 	failureProbability = (par("failureProbability").doubleValue()) / 1000.0;
 	numWorkers = par("numWorkers").intValue();
+	speedFactor = par("speedFactor").doubleValue();
+
+	// Every worker initially owns its own key
+	for(int i = 0; i < numWorkers; i++) {
+		keyOwner.push_back(i);
+	}
+
+	insertWindow = par("insertWindow").intValue();
+	insertCredits.assign(numWorkers, insertWindow);
+	peakCreditDebtors = 0;
+	creditStalls = 0;
 
-	changeKeyProbability = 0.4;
+	changeKeyProbability = par("changeKeyProbability").doubleValue();
+	partitioner = Partitioner(numWorkers, changeKeyProbability, par("virtualNodes").intValue(), par("partitionRangeMin").intValue(), par("partitionRangeMax").intValue());
 	insertTimeout = 0.5; //500 ms
 	localBatch = true;
 	failed = false;
 
-	convertParameters(); //Conversion of delay parameters for the lognormal distribution
+	setupCostModel(); // Simulated time of the operations, from the parameters
+
+	loader = nullptr;
+	insertManager = nullptr;
+
+	initializeDispatchTable();
+	// The node index is the worker's address, also after a restart.
+	// On a WorkerNode, the worker runs one of the node's jobs, and shares the node's processor with the others
+	jobId = par("jobId").intValue();
+	dataDir = par("dataDir").stdstringValue();
+	bool sharedNode = (par("topology").stdstringValue() == "node");
+	nodeIndex = sharedNode ? getParentModule()->getIndex() : getIndex();
+	cpuScheduler = sharedNode ? dynamic_cast<CpuScheduler*>(getParentModule()->getSubmodule("dispatcher")) : nullptr;
+	router = Router(par("topology").stdstringValue(), workerAddress(nodeIndex));
+	payloadEncoding = PayloadCodec::parseEncoding(par("payloadEncoding").stdstringValue());
 
 	nextStepMsg = new NextStepMessage("NextStep");
 	pingResEvent = new PingResMessage("PingRes");
-	unstableMessage = new DataInsertMessage();
 	insertTimeoutMsg = new cMessage("Timeout");
 }
 
@@ -241,17 +476,41 @@ void Worker::initialize(){
 * Deallocates worker variables, prints debug information and persists logged simulation data.
 */
 void Worker::finish(){
+	// Spare worker, never joined the job (see the Leader's initialWorkers)
+	if(loader == nullptr && insertManager == nullptr && !failed) {
+		std::cout << "Worker " << nodeIndex << " - Spare, never joined the job\n";
+		delete pingResEvent;
+		delete nextStepMsg;
+		return;
+	}
+
 	std::cout << "Worker " << workerId << " finished with value: ";
 	if(reduceLast){
 		std::cout << tmpReduce << "\n";
 	} 
 	//data.clear()
 
+	// Also for a failed or retired worker: its failures and wasted work are in these scalars
+	recordStatistics();
+
 	if(failed){
 		std::cout << "Finished, but a worker has failed" << "\n";
 		return;
 	} else {
 		std::cout << "Worker " << workerId << " - Inserted Data Empty? " << insertManager->isEmpty() << "\n";
+		std::cout << "Worker " << workerId << " - Speculative commits accepted: " << speculativeCommitsAccepted << ", rejected: " << speculativeCommitsRejected << "\n";
+		std::cout << "Worker " << workerId << " - Operator executions: " << operatorExecutions << "\n";
+		std::cout << "Worker " << workerId << " - First batch completed at: " << firstResultTime << "\n";
+		std::cout << "Worker " << workerId << " - Message allocations: " << messageAllocations() << ", reuses: " << messageReuses();
+		std::cout << ", per processed tuple: " << (tuplesProcessed > 0 ? (double)messageAllocations() / tuplesProcessed : 0) << "\n";
+		std::cout << "Worker " << workerId << " - Peak ChangeKey backlog from other workers: " << peakCreditDebtors << ", outbox stalls for insert credits: " << creditStalls << "\n";
+		std::cout << "Worker " << workerId << " - Messages queued on busy links: " << getQueuedPackets() << ", total queueing delay: " << getTotalQueueingDelay() << "\n";
+		for(int phase = 0; phase < PHASE_COUNT; phase++) {
+			if(failuresByPhase[phase] > 0 || duplicateInserts[phase] > 0) {
+				std::cout << "Worker " << workerId << " - Failures in " << failurePhaseNames[phase] << ": " << failuresByPhase[phase] << ", operator executions lost: " << wastedExecutions[phase];
+				std::cout << ", tuples reloaded: " << reloadedTuples[phase] << ", duplicate inserts dropped: " << duplicateInserts[phase] << ", recovery time: " << recoveryTimes[phase] << "s\n";
+			}
+		}
 	}
 	// Data loader instances
 	delete loader;
@@ -260,15 +519,17 @@ void Worker::finish(){
 	// Event Message holders
 	delete pingResEvent;
 	delete nextStepMsg;
-
-	logSimData();
 }
 
 /*
-* Handles incoming messages/self-messages by casting to their respective type, and
-* calling the function responsible for the corresponding task.
+* Handles incoming messages/self-messages: self-messages are recognized by pointer, the other
+* messages are dispatched by kind to the function responsible for the corresponding task.
 */
 void Worker::handleMessage(cMessage *msg){
+	// Segment for the end of a transmission on a busy link
+	if(handleTransmitTimer(msg)) {
+		return;
+	}
 
 	// Segment for data processing self-message
 	if(msg == nextStepMsg) {
@@ -287,10 +548,8 @@ void Worker::handleMessage(cMessage *msg){
 	*  Try re-sending an unstable DataInsert message and re-start a timeout.
 	*/
 	if(msg == insertTimeoutMsg) {
-		// Get the worker ID from the message
-		int destWorker = unstableMessage->getDestID();
-		DataInsertMessage* insertMsgCopy = unstableMessage->dup();
-		send(insertMsgCopy, "out", getWorkerGate(destWorker));
+		// Get the worker currently owning the destination key
+		transmitInsert(keyOwner[unstableInsert.newKey]);
 
 		// Reschedule the timeout for this message
         scheduleAt(simTime() + insertTimeout, insertTimeoutMsg);
@@ -298,80 +557,123 @@ void Worker::handleMessage(cMessage *msg){
 	}
 
 	/*
-	*	Ping Message segment:
-	*	Schedule a delayed response to the ping message
+	*	Messages from other modules:
+	*	The kind, set when the message was created, indexes the dispatch table
 	*/
-	PingMessage *pingMsg = dynamic_cast<PingMessage *>(msg);
-	if(pingMsg != nullptr){
-		delete msg;		
-		// If the worker has failed, do not reply
-		if(failed){
-			return;
-		}
-		
-		// 
-		if(pingResEvent != nullptr && pingResEvent->isScheduled()){
-			cancelEvent(pingResEvent);
-		}
-
-		// Generate random delay
-		double delay = calculateDelay("ping"); // Log-normal to have always positive increments
-		// Schedule response event
-        scheduleAt(simTime() + delay , pingResEvent);
+	int kind = msg->getKind();
+	if(!isValidMessageKind(kind) || dispatchTable[kind] == nullptr) {
+		EV_WARN << "Received message of unexpected kind " << kind << " - dropped\n";
+		delete msg;
 		return;
 	}
+	messageStats.record(msg);
+	dispatchTable[kind](this, msg);
+}
 
-	// Setup Message segment
-	SetupMessage *setupMsg = dynamic_cast<SetupMessage *>(msg);
-    if(setupMsg != nullptr){
-        // Successfully cast to SetupMessage, handle it
-        handleSetupMessage(setupMsg);
-    	delete msg;
-        return;
-    }
+/*
+* Fills the dispatch table: one entry per kind of message a worker can receive, which
+* calls the function responsible for the corresponding task and disposes of the message.
+*/
+void Worker::initializeDispatchTable(){
+	dispatchTable.fill(nullptr);
+
+	// Ping Message: schedule a delayed response to the ping message
+	dispatchTable[MSG_PING] = [](Worker* worker, cMessage* msg) {
+		worker->pingPool.release(static_cast<PingMessage*>(msg));
+		worker->schedulePingResponse();
+	};
+
+	// Setup Message
+	dispatchTable[MSG_SETUP] = [](Worker* worker, cMessage* msg) {
+		worker->handleSetupMessage(static_cast<SetupMessage*>(msg));
+		delete msg;
+	};
 
-	// Schedule Message segment	
-	ScheduleMessage *scheduleMsg = dynamic_cast<ScheduleMessage *>(msg);
-    if (scheduleMsg != nullptr) {
-        // Successfully cast to ScheduleMessage, handle it
-        handleScheduleMessage(scheduleMsg);
-    	delete msg;
-        return;
-    }
-    
-    // Data Insert Message segment (Insert/ACK)
-    DataInsertMessage *dataInsertMsg = dynamic_cast<DataInsertMessage *>(msg);
-    if(dataInsertMsg != nullptr){
-    	//Successfully cast to DataInsertMessage, handle it
-    	handleDataInsertMessage(dataInsertMsg);
-    	return;
-    }
+	// Schedule Message
+	dispatchTable[MSG_SCHEDULE] = [](Worker* worker, cMessage* msg) {
+		worker->handleScheduleMessage(static_cast<ScheduleMessage*>(msg));
+		delete msg;
+	};
+
+	// Data Insert Message (Insert/ACK), recycled by the handler
+	dispatchTable[MSG_DATA_INSERT] = [](Worker* worker, cMessage* msg) {
+		worker->handleDataInsertMessage(static_cast<DataInsertMessage*>(msg));
+	};
+
+	// FinishLocalElaboration Message (Check for local ChangeKeys)
+	dispatchTable[MSG_FINISH_LOCAL] = [](Worker* worker, cMessage* msg) {
+		EV_DETAIL << "Start executing the remain schedule for the latecomers change key data\n";
+		worker->handleFinishLocalElaborationMessage(static_cast<FinishLocalElaborationMessage*>(msg));
+		worker->finishLocalPool.release(static_cast<FinishLocalElaborationMessage*>(msg));
+	};
+
+	// Finish Simulation message
+	dispatchTable[MSG_FINISH_SIM] = [](Worker* worker, cMessage* msg) {
+		worker->handleFinishSimMessage(static_cast<FinishSimMessage*>(msg));
+		delete msg;
+	};
 
-	// FinishLocalElaboration Message segment (Check for local ChangeKeys)
-	FinishLocalElaborationMessage *finishLocalMsg = dynamic_cast<FinishLocalElaborationMessage *>(msg);
-	if(finishLocalMsg != nullptr){
-		EV<<"Start executing the remain schedule for the latecomers change key data\n";
-		handleFinishLocalElaborationMessage(finishLocalMsg);
-    	delete msg;
-		return;
-	}
+	// Speculative execution message (Leader notice/assignment)
+	dispatchTable[MSG_SPECULATE] = [](Worker* worker, cMessage* msg) {
+		worker->handleSpeculateMessage(static_cast<SpeculateMessage*>(msg));
+		delete msg;
+	};
+
+	// Speculative batch commit message (From a helper worker)
+	dispatchTable[MSG_SPECULATIVE_COMMIT] = [](Worker* worker, cMessage* msg) {
+		worker->handleSpeculativeCommitMessage(static_cast<SpeculativeCommitMessage*>(msg));
+		delete msg;
+	};
+
+	// Partition reassignment message
+	dispatchTable[MSG_REASSIGN] = [](Worker* worker, cMessage* msg) {
+		worker->handleReassignMessage(static_cast<ReassignMessage*>(msg));
+		delete msg;
+	};
+
+	// Insert credits (A receiver drained ChangeKey data of this worker)
+	dispatchTable[MSG_INSERT_CREDIT] = [](Worker* worker, cMessage* msg) {
+		worker->handleInsertCreditMessage(static_cast<InsertCreditMessage*>(msg));
+		delete msg;
+	};
+
+	// Leave message (Stop request of a graceful leave)
+	dispatchTable[MSG_LEAVE] = [](Worker* worker, cMessage* msg) {
+		worker->handleLeaveMessage(static_cast<LeaveMessage*>(msg));
+		delete msg;
+	};
+
+	// Membership message (A worker joined or left the job)
+	dispatchTable[MSG_MEMBERSHIP] = [](Worker* worker, cMessage* msg) {
+		worker->handleMembershipMessage(static_cast<MembershipMessage*>(msg));
+		delete msg;
+	};
+
+	// Restart after failure message
+	dispatchTable[MSG_RESTART] = [](Worker* worker, cMessage* msg) {
+		worker->handleRestartMessage(static_cast<RestartMessage*>(msg));
+		delete msg;
+	};
+}
 
-    // Finish Simulation message segment
-    FinishSimMessage *finishSimMsg = dynamic_cast<FinishSimMessage *>(msg);
-	if(finishSimMsg != nullptr){
-		handleFinishSimMessage(finishSimMsg);
-    	delete msg;
+/*
+*	Schedules a delayed response to a ping message coming from the Leader node
+*/
+void Worker::schedulePingResponse(){
+	// If the worker has failed, do not reply
+	if(failed){
 		return;
 	}
+	
+	// 
+	if(pingResEvent != nullptr && pingResEvent->isScheduled()){
+		cancelEvent(pingResEvent);
+	}
 
-	// Restart after failure message segment
-	RestartMessage *restartMsg = dynamic_cast<RestartMessage *>(msg);
-    if(restartMsg != nullptr) {
-    	// Successfully cast to RestartMessage, handle it
-    	handleRestartMessage(restartMsg);
-    	delete msg;
-    	return;
-    }
+	// Generate random delay
+	double delay = calculateDelay("ping"); // Log-normal to have always positive increments
+	// Schedule response event
+	scheduleAt(simTime() + delay , pingResEvent);
 }
 
 /*
@@ -381,9 +683,11 @@ void Worker::handlePingMessage(cMessage *msg){
 	if(failed) {
 		return;
 	}
-	PingMessage *pingMsg = new PingMessage();
+	PingMessage *pingMsg = pingPool.acquire();
 	pingMsg->setWorkerId(workerId);
-	send(pingMsg, "out", LEADER_PORT);
+	// Piggyback local progress, used by the leader to detect stragglers
+	pingMsg->setBatchesDone(loader != nullptr ? loader->getBatchesLoaded() : 0);
+	sendTo(pingMsg, LEADER_ADDRESS);
 	return;
 }
 
@@ -406,11 +710,11 @@ void Worker::handleSetupMessage(SetupMessage *msg){
 
 	int dataSize = msg->getDataArraySize(); // Get the number of data items
 
-	//Persisting data on file
-	folder = "Data/Worker_" + std::to_string(workerId) + "/";
+	//Persisting data on file (a chunk of a streamed input is appended, also while failed: the file is on durable storage)
+	folder = workerFolder(workerId);
 	std::ofstream data_file;
 	fileName = folder + "data.csv";
-	data_file.open(fileName);
+	data_file.open(fileName, msg->getAppend() ? std::ios_base::app : std::ios_base::out);
 
 	for (int i = 0; i < dataSize; i++) {
 	    // Directly write to the file
@@ -419,8 +723,84 @@ void Worker::handleSetupMessage(SetupMessage *msg){
 
 	data_file.close();
 
-	// Initialize BatchLoader and InsertManager
-	initializeDataModules();
+	// Initialize BatchLoader and InsertManager, once the first chunk is received
+	if(!msg->getAppend() && !failed) {
+		initializeDataModules();
+	}
+
+	// First chunk of the next pane of a stream
+	if(msg->getWindow() > window) {
+		window = msg->getWindow();
+		startWindow();
+	}
+
+	if(msg->getLast()) {
+		setupComplete = true;
+	}
+	if(failed) {
+		return; // The leader resets the credits on restart
+	}
+
+	// The credit of this chunk is returned once its data is loaded
+	chunkEnds.push_back(static_cast<std::streampos>(fs::file_size(fileName)));
+	if(loader != nullptr) {
+		returnSetupCredits();
+	}
+
+	// Resume the elaboration, if it was waiting for this chunk
+	if(waitingForSetup) {
+		waitingForSetup = false;
+		if(idle && !waitingForInsert && !nextStepMsg->isScheduled()) {
+			idle = false;
+			begin_batch = simTime();
+			begin_op = simTime();
+			scheduleAt(simTime(), nextStepMsg);
+		}
+	}
+}
+
+/*
+* Restarts the elaboration for the tuples of a new pane of a stream: the local data is no longer finished,
+* and a new round of the termination condition begins (FinishLocalElaboration, then CheckChangeKeyACK).
+* The partial reduce goes on from the previous panes: the leader takes the difference.
+*/
+void Worker::startWindow(){
+	setupComplete = false;
+	if(failed) {
+		return; // The restart resumes from the persisted state
+	}
+	finishedLocalElaboration = false;
+	localBatch = true;
+	finishNoticeSent = false;
+	checkChangeKeyReceived = false;
+
+	if(idle && !waitingForInsert && !nextStepMsg->isScheduled()) {
+		idle = false;
+		waitingForSetup = false;
+		begin_batch = simTime();
+		begin_op = simTime();
+		scheduleAt(simTime(), nextStepMsg);
+	}
+}
+
+/*
+* Returns a credit to the leader for every received chunk whose data has been loaded,
+* so that the leader sends the next chunks while this worker elaborates.
+*/
+void Worker::returnSetupCredits(){
+	int credits = 0;
+	while(!chunkEnds.empty() && loader->getFilePosition() >= chunkEnds.front()) {
+		chunkEnds.pop_front();
+		credits++;
+	}
+	if(credits == 0 || setupComplete) {
+		return; // No more chunks to receive
+	}
+	SetupCreditMessage *creditMsg = new SetupCreditMessage();
+	creditMsg->setKind(MSG_SETUP_CREDIT);
+	creditMsg->setWorkerId(workerId);
+	creditMsg->setCredits(credits);
+	sendTo(creditMsg, LEADER_ADDRESS);
 }
 
 /*
@@ -441,10 +821,17 @@ void Worker::handleScheduleMessage(ScheduleMessage *msg){
     for(int i=0; i<scheduleSize; i++){
         schedule.push_back(msg->getSchedule(i)) ;
 		parameters.push_back(msg->getParameters(i));
+		upperBounds.push_back(i < msg->getUpperBoundsArraySize() ? msg->getUpperBounds(i) : 0);
     }
     // Set helper flag
     reduceLast = (schedule.back() == "reduce");
 
+	// Keys of the partitioners: the workers of the job (a worker joining a running job gets the current ones)
+	if(msg->getMembersArraySize() > 0) {
+		updateMembers(msg);
+	}
+	updateStages(msg);
+
     loadNextBatch(); // Load first batch
     
     persistCKCounter(); // Persist first batch info
@@ -462,7 +849,7 @@ void Worker::handleScheduleMessage(ScheduleMessage *msg){
 /*
  * Handles a DataInsert message received from another Worker.
  * This function performs two tasks, based on the type of DataInsert (ACK/Insert):
- *  If the message is an ACK: 
+ *  If the message is an ACK of the pending insertion (stale ACKs of earlier retransmissions are ignored):
  *	 - Cancel the scheduled timeout
  *	 - Increment changeKeySent and persist counters
  *	 - Schedule nextStep and unblock execution
@@ -476,55 +863,93 @@ void Worker::handleScheduleMessage(ScheduleMessage *msg){
  *   - msg: A pointer to the DataInsertMessage containing a data point and info on the exchange.
  */
 void Worker::handleDataInsertMessage(DataInsertMessage *msg){
-	// Drop the message if the worker has failed
-	if(failed){
-		EV << "Received DataInsert - dropped" << "\n";
-		delete msg;
+	// Drop the message if the worker has failed, has stopped to leave the job, or has not received its input yet (joining worker):
+	// the sender re-sends it (to the adopter, once a leaving worker's partition is reassigned)
+	if(failed || stoppedToLeave || insertManager == nullptr){
+		EV_DEBUG << "Received DataInsert - dropped" << "\n";
+		insertPool.release(msg);
 		return;
 	}
 	// Check if it is an ACK or an insertion to me (workerID)
 	if(msg->getAck()){
-		// Cancel the timeout message
-		if(insertTimeoutMsg != nullptr && insertTimeoutMsg->isScheduled()) {
-			cancelEvent(insertTimeoutMsg);
-		}
-		// Delete clone of DataInsertMessage
-		delete unstableMessage;
-		
-		// Unblock execution and re-schedule a nextStep
-		if(nextStepMsg->isScheduled()) {
-			cancelEvent(nextStepMsg);
+		// Only the ACK of the pending request completes it: a late ACK of a retransmission must not complete the next one
+		if(waitingForInsert && msg->getSenderID() == unstableInsert.origin && msg->getReqID() == unstableReqID) {
+			handleInsertAck();
+		} else {
+			EV_DEBUG << "Received stale ACK for request " << msg->getReqID() << " - dropped\n";
 		}
-
-		scheduleAt(simTime(), nextStepMsg);
-		waitingForInsert = false;
-		
-		// Increment sent counter and persist
-		changeKeySent++;
-		persistCKSentReceived();
 	} else {
 		// Handle data insertion
-		// Get sender info from the arrival gate
-		int gateIndex = msg->getArrivalGate()->getIndex();
-		int senderID = getInboundWorkerID(gateIndex);
+		// The sender ID identifies the request ID sequence (it differs from the sending worker for reassigned partitions)
+		int senderID = msg->getSenderID();
 		
-		// Try to insert this value into InsertManager
-		insertManager->insertValue(senderID, msg->getReqID(), msg->getScheduleStep(), msg->getData());
+		// Try to insert this value into InsertManager, the sending worker's credit is returned once it is drained
+		TupleTrace trace;
+		trace.origin = msg->getTraceOrigin();
+		trace.hops = msg->getTraceHops();
+		trace.backlogWait = msg->getTraceBacklogWait();
+		bool inserted = insertManager->insertValue(senderID, msg->getReqID(), msg->getScheduleStep(), msg->getData(), trace.enterBacklog(SIMTIME_DBL(simTime())));
+		emit(changeKeyBacklogSignal, insertManager->getBacklog());
+		if(!inserted) {
+			countDuplicate(msg->getReplayPhase());
+		}
+		if(inserted && insertWindow > 0) {
+			creditDebtors.push_back(addressToWorker(msg->getSrcAddress()));
+			peakCreditDebtors = std::max(peakCreditDebtors, creditDebtors.size());
+		}
 
 		// Reset flag (If this new data was inserted, I need to elaborate it)
 		finishedPartialCK = false;
 		// Send back ACK after insertion
-		DataInsertMessage* insertMsg = new DataInsertMessage();
+		DataInsertMessage* insertMsg = insertPool.acquire();
+		insertMsg->setSenderID(senderID);
 		insertMsg->setReqID(msg->getReqID());
 		insertMsg->setAck(true);
 
-		send(insertMsg, "out", gateIndex);
+		sendTo(insertMsg, msg->getSrcAddress());
 		
 		// Increment received counter and persist
 		changeKeyReceived++;
 		persistCKSentReceived();
+
+		// Idle with ChangeKeys waiting for credits: drain the new data, which returns credits to the senders.
+		// In the pipelined mode, the values streamed from the previous stage are elaborated as they arrive
+		if(idle && (!outbox.empty() || !stageOfStep.empty()) && !waitingForInsert && !nextStepMsg->isScheduled()) {
+			scheduleAt(simTime(), nextStepMsg);
+		}
 	}
-	delete msg;
+	insertPool.release(msg);
+}
+
+/*
+ * Completes the pending DataInsert exchange, once it has been acknowledged:
+ *	 - Cancel the scheduled timeout
+ *	 - Increment changeKeySent and persist counters
+ *	 - Schedule nextStep and unblock execution
+ */
+void Worker::handleInsertAck(){
+	// Cancel the timeout message
+	if(insertTimeoutMsg != nullptr && insertTimeoutMsg->isScheduled()) {
+		cancelEvent(insertTimeoutMsg);
+	}
+	unstableReqID = -1;
+
+	// A committed ChangeKey was delivered: remove it from the outbox together with its request ID
+	if(outboxInFlight) {
+		completeOutboxFront();
+	}
+	
+	// Unblock execution and re-schedule a nextStep
+	if(nextStepMsg->isScheduled()) {
+		cancelEvent(nextStepMsg);
+	}
+
+	scheduleAt(simTime(), nextStepMsg);
+	waitingForInsert = false;
+	
+	// Increment sent counter and persist
+	changeKeySent++;
+	persistCKSentReceived();
 }
 
 /*
@@ -563,6 +988,7 @@ void Worker::handleFinishLocalElaborationMessage(FinishLocalElaborationMessage *
 	// Schedule a new nextStep with a small delay to account for the worker switching to the final phase of the elaboration.
 	double delay = calculateDelay("finish");
 	scheduleAt(simTime() + delay , nextStepMsg);
+	setState(STATE_PROCESSING);
 }
 
 /*
@@ -580,14 +1006,22 @@ void Worker::handleFinishLocalElaborationMessage(FinishLocalElaborationMessage *
  *   - msg: A pointer to the RestartMessage.
  */
 void Worker::handleRestartMessage(RestartMessage *msg){
+	// A worker whose partition was reassigned never restarts
+	if(retired) {
+		return;
+	}
+
 	// If the worker has not failed, but didn't respond in time to a ping, it restarts.
 	if(!failed){
-		std::cout << "Worker " << workerId << " received a RestartMessage, but has not failed: Restarting..." << "\n";
+		EV_WARN << "Worker " << workerId << " received a RestartMessage, but has not failed: Restarting..." << "\n";
+		recordFailure(batchPhase());
 		deallocatingMemory();
 	}
 	
 	//Reload base worker information and data modules
 	failed = false;
+	leaving = false; // The Leader repeats the request of a leave interrupted by the restart
+	stoppedToLeave = false;
 	workerId = msg->getWorkerID();
 	batchSize = par("batchSize").intValue();
 	numWorkers = par("numWorkers").intValue();
@@ -599,17 +1033,55 @@ void Worker::handleRestartMessage(RestartMessage *msg){
     for(int i=0; i<scheduleSize; i++){
         schedule.push_back(msg->getSchedule(i)) ;
 		parameters.push_back(msg->getParameters(i));
+		upperBounds.push_back(i < msg->getUpperBoundsArraySize() ? msg->getUpperBounds(i) : 0);
     }
     reduceLast = (schedule.back() == "reduce");
 
+	// Input chunks still to be received (their credits were reset by the leader)
+	setupComplete = setupComplete || msg->getSetupComplete();
+	waitingForSetup = false;
+	chunkEnds.clear();
+
+	// Restore the key ownership, which changes when partitions are reassigned
+	for(int i = 0; i < msg->getKeyOwnersArraySize() && i < keyOwner.size(); i++) {
+		keyOwner[i] = msg->getKeyOwners(i);
+	}
+
+	// Restore the members, which change when workers join or leave the job
+	if(msg->getMembersArraySize() > 0) {
+		updateMembers(msg);
+	}
+	updateStages(msg);
+
     // Load previous partial result
 	if(reduceLast) loadPartialResults();
 
 	// Load ChangeKey counters and previous batch type information
 	loadChangeKeyData();
+
+	// Load committed ChangeKeys that were not yet delivered
+	loadOutbox();
+	replayOutbox = outbox.size();
+
+	// Credits: a full window for every receiver, and for every sender (the data points received before the crash are not tracked)
+	insertCredits.assign(numWorkers, insertWindow);
+	creditDebtors.clear();
+	if(insertWindow > 0) {
+		resetInsertCredits();
+	}
+
+	// Reload the partitions taken over from failed workers
+	loadAdoptedPartitions();
 	
-	// Load one batch of data in memory
+	// Load one batch of data in memory: the batch lost in the failure, reloaded from the progress offset or ck_batch.csv
 	loadNextBatch();
+	if(lostBatch && recoveryPhase != -1) {
+		for(const auto& step : data) {
+			reloadedTuples[recoveryPhase] += step.second.size();
+		}
+	}
+	redoPending = lostBatch;
+	lostBatch = false;
 
 	// Cancel any pre-existing nextStep
 	if(nextStepMsg != nullptr && nextStepMsg->isScheduled()) {
@@ -626,136 +1098,499 @@ void Worker::handleRestartMessage(RestartMessage *msg){
 	
 	// Schedule delayed nextStep
 	scheduleAt(simTime() + delay, nextStepMsg);
+	setState(STATE_RESTARTING);
+
+	// Nothing lost to redo: recovered once restarted
+	checkRecovered(simTime() + delay);
 	return;
 }
 
 /*
- * Handles a FinishSimMessage received from the Leader.
- * This message terminates the simulation.
+ * Handles a SpeculateMessage received from the Leader.
+ * The same message type is used for the three legs of the speculation protocol:
+ *	 - Notice to the owner (straggler): the owner picks the first batch it has not started yet as
+ *	   handoff point, from then on it defers its ChangeKeys until each batch is committed, and replies.
+ *	 - Assignment to the helper: the helper positions a loader over the owner's input at the handoff
+ *	   point and elaborates those batches when it has no work of its own.
+ *	 - Cancel to the helper: the owner has finished its local data, the speculative copy is stopped.
  * 
  * Parameters:
- *   - msg: A pointer to the FinishSimMessage.
+ *   - msg: A pointer to the SpeculateMessage.
  */
-void Worker::handleFinishSimMessage(FinishSimMessage *msg){
-	EV<<"\nApplication finished at worker: "<<workerId<<"\n\n";
+void Worker::handleSpeculateMessage(SpeculateMessage *msg){
+	if(failed) {
+		return;
+	}
+
+	// Owner side: choose the handoff point and reply to the leader
+	if(msg->getOwnerId() == workerId) {
+		SpeculateMessage* replyMsg = new SpeculateMessage();
+		replyMsg->setKind(MSG_SPECULATE);
+		replyMsg->setOwnerId(workerId);
+		replyMsg->setHelperId(msg->getHelperId());
+
+		if(finishedLocalElaboration) {
+			// Nothing left to speculate on
+			replyMsg->setFirstBatch(-1);
+		} else if(!setupComplete) {
+			// The input is still arriving: a batch count from here would not locate it in the helper's copy
+			replyMsg->setFirstBatch(-1);
+		} else if(leaving) {
+			// The partition is about to be handed over
+			replyMsg->setFirstBatch(-1);
+		} else {
+			// The batch in progress may have already sent ChangeKeys, so it stays with this worker
+			speculationStart = loader->getBatchesLoaded();
+			replyMsg->setFirstBatch(speculationStart);
+			persistCKCounter();
+			EV_INFO << "Worker " << workerId << " - Speculative copy on worker " << msg->getHelperId() << " from batch " << speculationStart << "\n";
+		}
+		sendTo(replyMsg, LEADER_ADDRESS);
+		return;
+	}
+
+	// Helper side: stop a running speculative copy
+	if(msg->getCancel()) {
+		if(speculativeOwner == msg->getOwnerId()) {
+			endSpeculation();
+		}
+		return;
+	}
+
+	// Helper side: position a loader over the owner's input, at the handoff batch
+	if(speculativeOwner != -1 || leaving) {
+		return; // Already helping another worker, or leaving the job
+	}
+	speculativeOwner = msg->getOwnerId();
+	std::string ownerFolder = workerFolder(speculativeOwner);
+	speculativeLoader = new BatchLoader(ownerFolder + "data.csv", "", batchSize);
+	speculativeLoader->skipBatches(msg->getFirstBatch());
+	EV_INFO << "Worker " << workerId << " - Speculating on worker " << speculativeOwner << " from batch " << msg->getFirstBatch() << "\n";
+
+	// Wake up if there is nothing else to elaborate
+	if(idle && !waitingForInsert && !nextStepMsg->isScheduled()) {
+		idle = false;
+		begin_batch = simTime();
+		begin_op = simTime();
+		scheduleAt(simTime(), nextStepMsg);
+	}
 }
 
 /*
- * Initializes the data modules needed to:
- *	 - Load batches of local data
- *	 - Load/Insert ChangeKey data
+ * Handles a SpeculativeCommitMessage received from a helper worker.
+ * The first commit of a batch wins: if this worker has already committed the batch, the copy is discarded,
+ * else the result of the batch is persisted and its ChangeKeys are queued in the outbox, to be sent by this worker.
+ * 
+ * Parameters:
+ *   - msg: A pointer to the SpeculativeCommitMessage containing the result of one batch.
  */
-void Worker::initializeDataModules() {
-	// File for local data
-	fileName = folder + "data.csv";
+void Worker::handleSpeculativeCommitMessage(SpeculativeCommitMessage *msg){
+	if(failed) {
+		return;
+	}
 
-	// Instantiate a BatchLoader (For local data loading)
-	fileProgressName = folder + "progress.txt";
-	loader = new BatchLoader(fileName, fileProgressName, batchSize);
-	
-	// Instantiate an InsertManager
-	std::string insertFilename = folder + "inserted.csv"; // File for inserted data
-	std::string requestFilename = folder + "requests_log.csv"; // File to keep track of inserts from other workers
-	std::string tempFilename = folder + "ck_batch.csv"; // Temp file to store previously loaded CK batch
-	insertManager = new InsertManager(insertFilename, requestFilename, tempFilename, batchSize);
+	if(!insertManager->commitBatch(workerId, msg->getBatchIndex())) {
+		speculativeCommitsRejected++;
+		return;
+	}
+	speculativeCommitsAccepted++;
+
+	// Persist the result of the committed batch
+	if(reduceLast) {
+		tmpReduce += msg->getPartialRes();
+		persistingReduce(tmpReduce - lastBatchReduce); // Do not persist the reduce of the batch in progress
+	} else {
+		std::vector<int> results;
+		for(int i = 0; i < msg->getResultsArraySize(); i++) {
+			results.push_back(msg->getResults(i));
+		}
+		persistingResult(results);
+	}
+
+	// Queue the ChangeKeys of the committed batch
+	for(int i = 0; i < msg->getRoutedKeysArraySize(); i++) {
+		outbox.push_back({msg->getRoutedKeys(i), msg->getRoutedValues(i), msg->getRoutedSteps(i), workerId});
+	}
+	persistOutbox();
+
+	// Wake up to send the committed ChangeKeys
+	if(!outbox.empty() && idle && !waitingForInsert && !nextStepMsg->isScheduled()) {
+		scheduleAt(simTime(), nextStepMsg);
+	}
 }
+
 /*
- * This function performs several tasks related to the elaboration of data points:
- *	- Check if the current batch has been fully elaborated
- *		- Persist the result and load the next batch
- *		- Check if the local elaboration is finished and whether to send a 
- *		  FinishElaboration/CheckChangeKeyACK to the Leader.
- *		- Reschedule a nextStep with a delay for loading a batch of data.
- *	- Take one data point from the current schedule step and process the current operation
- *		- Decide between moving the data point to the next step, or dropping it (filtered/changed key)
- *		- Schedule nextStep with delay based on current operation (map/filter/changekey)
- *	- If data for current step is empty
- *		- Increment step
- *		- If we are at the last step and it is a reduce, move to the processReduce() function
- *		- Else, recursively call this function.
+ * Handles a ReassignMessage received from the Leader, broadcast when a failed worker's partition is
+ * reassigned instead of waiting for its restart:
+ *	 - Every worker routes the keys owned by the failed worker to the adopter, re-sending a pending DataInsert
+ *	 - The failed worker (if still alive) stops for good
+ *	 - The adopter takes over the failed worker's partition and resumes the elaboration
+ * 
+ * Parameters:
+ *   - msg: A pointer to the ReassignMessage.
  */
-void Worker::processStep()
-{
-	// If the worker has failed, do not do anything
-	if(failed)
-	{
-	    EV << "Worker failed!\n";
-	    return;
-	}
+void Worker::handleReassignMessage(ReassignMessage *msg){
+	int failedId = msg->getFailedId();
+	int adopterId = msg->getAdopterId();
 
-	// If the batch is finished
-	if(currentScheduleStep >= schedule.size())
-	{
-		// Logging code (IGNORE)
-		simtime_t end_batch = simTime();
-		simtime_t batch_duration = end_batch - begin_batch;
+	// The partition of this worker was reassigned: stop for good
+	if(failedId == workerId && !failed) {
+		EV_INFO << "Worker " << workerId << " - Partition reassigned to worker " << adopterId << ", stopping\n";
+		deallocatingMemory();
+	}
+	if(failedId == workerId || retired) {
+		retired = true;
+		return;
+	}
 
-		if(reduceLast) {
-			simtime_t last_op_duration = end_batch - begin_op;
-			per_op_exec_times[getParentOperation(schedule[schedule.size() - 1])].push_back(last_op_duration);
+	// Update key ownership (including keys previously taken over by the failed worker)
+	for(int i = 0; i < keyOwner.size(); i++) {
+		if(keyOwner[i] == failedId) {
+			keyOwner[i] = adopterId;
 		}
+	}
 
-		per_schedule_exec_times.push_back(batch_duration);
-		// End of Logging code
+	if(failed) {
+		return;
+	}
 
-		// Check whether to persist the reduce, or to just append the current result to the file
-		if(reduceLast) {
-			persistingReduce(tmpReduce);
-		} else {
+	// Re-send a pending DataInsert addressed to the failed worker
+	if(waitingForInsert && insertTimeoutMsg->isScheduled() && keyOwner[unstableInsert.newKey] == adopterId && adopterId != workerId) {
+		cancelEvent(insertTimeoutMsg);
+		transmitInsert(adopterId);
+		scheduleAt(simTime() + insertTimeout, insertTimeoutMsg);
+	}
+
+	if(adopterId != workerId) {
+		return;
+	}
+
+	// Take over the partition, and restart the elaboration to process it before finishing
+	adoptPartition(failedId, true);
+
+	// A DataInsert addressed to the failed worker is now a local insertion (deduplicated with the failed worker's request log)
+	if(waitingForInsert && keyOwner[unstableInsert.newKey] == workerId) {
+		insertManager->insertValue(unstableInsert.origin, unstableReqID, unstableInsert.scheduleStep, unstableInsert.value, unstableInsert.trace.enterBacklog(SIMTIME_DBL(simTime())));
+		changeKeyReceived++;
+		handleInsertAck();
+	}
+
+	finishedLocalElaboration = false;
+	localBatch = true;
+	finishNoticeSent = false;
+	checkChangeKeyReceived = false;
+
+	if(!waitingForInsert && !nextStepMsg->isScheduled()) {
+		begin_batch = simTime();
+		begin_op = simTime();
+		scheduleAt(simTime(), nextStepMsg);
+	}
+}
+
+/*
+ * Handles a LeaveMessage received from the Leader, which asks this worker to leave the job.
+ * The elaboration stops between batches (see drainForLeave): right away if no batch is in progress,
+ * otherwise at the end of the current one, once the whole input has been received.
+ * 
+ * Parameters:
+ *   - msg: A pointer to the LeaveMessage.
+ */
+void Worker::handleLeaveMessage(LeaveMessage *msg){
+	if(failed || retired || leaving) {
+		return;
+	}
+	EV_INFO << "Worker " << workerId << " - Leaving the job, stopping after the current batch\n";
+	leaving = true;
+
+	if(!batchStarted && !waitingForInsert && setupComplete) {
+		drainForLeave();
+	}
+}
+
+/*
+ * Handles an InsertCreditMessage received from another worker, which has drained ChangeKey data of this worker
+ * (or restarted). Credits beyond the window (returned for data points sent before a restart of this worker) are dropped.
+ * If this worker was idle with ChangeKeys waiting for credits, it resumes sending them.
+ * 
+ * Parameters:
+ *   - msg: A pointer to the InsertCreditMessage.
+ */
+void Worker::handleInsertCreditMessage(InsertCreditMessage *msg){
+	int receiver = addressToWorker(msg->getSrcAddress());
+	if(msg->getReset()) {
+		insertCredits[receiver] = msg->getCredits();
+	} else {
+		insertCredits[receiver] = std::min(insertCredits[receiver] + msg->getCredits(), insertWindow);
+	}
+
+	if(!failed && idle && !outbox.empty() && !waitingForInsert && !nextStepMsg->isScheduled()) {
+		scheduleAt(simTime(), nextStepMsg);
+	}
+}
+
+/*
+ * Handles a MembershipMessage received from the Leader, broadcast when a worker joins or leaves the job:
+ * the following ChangeKeys distribute their keys over the new members.
+ * Data points already routed keep their key (the keys of a worker that left are owned by its adopter, see keyOwner).
+ * 
+ * Parameters:
+ *   - msg: A pointer to the MembershipMessage.
+ */
+void Worker::handleMembershipMessage(MembershipMessage *msg){
+	updateMembers(msg);
+	EV_INFO << "Worker " << workerId << " - " << msg->getMembersArraySize() << " workers in the job\n";
+}
+
+/*
+ * Distributes the keys of the partitioners over the members carried by a message (Schedule, Restart, Membership).
+ */
+template <typename T>
+void Worker::updateMembers(const T *msg){
+	std::vector<int> members;
+	for(size_t i = 0; i < msg->getMembersArraySize(); i++) {
+		members.push_back(msg->getMembers(i));
+	}
+	partitioner.setMembers(members);
+}
+
+/*
+ * Pipelined mode: builds the partitioner of each stage over its workers, from a message (Schedule, Restart).
+ * Without stages, every changekey routes over all the members.
+ */
+template <typename T>
+void Worker::updateStages(const T *msg){
+	stageOfStep.clear();
+	stagePartitioners.clear();
+	for(size_t i = 0; i < msg->getStageOfStepArraySize(); i++) {
+		stageOfStep.push_back(msg->getStageOfStep(i));
+	}
+	std::vector<std::vector<int>> stageMembers;
+	for(size_t i = 0; i < msg->getStageOfWorkerArraySize(); i++) {
+		int stage = msg->getStageOfWorker(i);
+		if(stage >= stageMembers.size()) {
+			stageMembers.resize(stage + 1);
+		}
+		stageMembers[stage].push_back(i);
+	}
+	for(const std::vector<int>& members : stageMembers) {
+		stagePartitioners.push_back(partitioner);
+		stagePartitioners.back().setMembers(members);
+	}
+}
+
+/*
+ * Handles a FinishSimMessage received from the Leader.
+ * This message terminates the simulation.
+ * 
+ * Parameters:
+ *   - msg: A pointer to the FinishSimMessage.
+ */
+void Worker::handleFinishSimMessage(FinishSimMessage *msg){
+	EV_INFO << "\nApplication finished at worker: "<<workerId<<"\n\n";
+	setState(STATE_FINISHED);
+}
+
+/*
+ * Initializes the data modules needed to:
+ *	 - Load batches of local data
+ *	 - Load/Insert ChangeKey data
+ */
+void Worker::initializeDataModules() {
+	// File for local data
+	fileName = folder + "data.csv";
+
+	// Instantiate a BatchLoader (For local data loading)
+	fileProgressName = folder + "progress.txt";
+	loader = new BatchLoader(fileName, fileProgressName, batchSize);
+	
+	// Instantiate an InsertManager
+	std::string insertFilename = folder + "inserted.csv"; // File for inserted data
+	std::string requestFilename = folder + "requests_log.csv"; // File to keep track of inserts from other workers
+	std::string commitFilename = folder + "committed_batches.csv"; // File of the local batches committed (speculative execution)
+	std::string tempFilename = folder + "ck_batch.csv"; // Temp file to store previously loaded CK batch
+	insertManager = new InsertManager(insertFilename, requestFilename, commitFilename, tempFilename, batchSize);
+}
+/*
+ * This function performs several tasks related to the elaboration of data points:
+ *	- Check if the current batch has been fully elaborated
+ *		- Persist the result and load the next batch
+ *		- Check if the local elaboration is finished and whether to send a 
+ *		  FinishElaboration/CheckChangeKeyACK to the Leader.
+ *		- Reschedule a nextStep with a delay for loading a batch of data.
+ *	- Take one data point from the current schedule step and process the current operation
+ *		- Decide between moving the data point to the next step, or dropping it (filtered/changed key)
+ *		- Schedule nextStep with delay based on current operation (map/filter/changekey)
+ *	- If data for current step is empty
+ *		- Increment step
+ *		- If we are at the last step and it is a reduce, move to the processReduce() function
+ *		- Else, recursively call this function.
+ */
+void Worker::processStep()
+{
+	// If the worker has failed, do not do anything
+	if(failed)
+	{
+	    EV_WARN << "Worker failed!\n";
+	    return;
+	}
+
+	// Leaving the job: stop between batches, once the input is complete, and stay stopped until the partition is reassigned
+	if(leaving && !stoppedToLeave && !batchStarted && !waitingForInsert && setupComplete) {
+		drainForLeave();
+	}
+	if(stoppedToLeave) {
+		return;
+	}
+
+	// Send committed ChangeKeys between batches, one at a time (the ACK re-schedules a nextStep)
+	if(!outbox.empty() && !waitingForInsert && !batchStarted && sendOutboxFront()) {
+		return;
+	}
+
+	// If the batch is finished
+	if(currentScheduleStep >= schedule.size())
+	{
+		// Statistics
+		simtime_t end_batch = simTime();
+		simtime_t batch_duration = end_batch - begin_batch;
+
+		if(reduceLast) {
+			emitOperatorTime(schedule[schedule.size() - 1], end_batch - begin_op);
+		}
+		emit(batchTimeSignal, batch_duration);
+
+		// A speculative batch is committed by its owner, a local batch may have already been committed by a speculative copy
+		if(speculativeBatch) {
+			sendSpeculativeCommit();
+		} else if(previousLocal && !commitLocalBatch()) {
+			tmpReduce -= lastBatchReduce;
+			tmpResult.clear();
+			data[schedule.size()].clear();
+			tracer.discard(schedule.size());
+		}
+		lastBatchReduce = 0;
+
+		// Check whether to persist the reduce, or to just append the current result to the file
+		if(reduceLast) {
+			persistingReduce(tmpReduce);
+		} else {
 			// If a schedule has a ChangeKey at the last step, handle data points at schedule.size() + 1
 			if(data.size() == (schedule.size() + 1) && !data[schedule.size()].empty()) {
 				for(const auto& value : data[schedule.size()]) {
 					tmpResult.push_back(value); // Push points in the result
 				}
 				data[schedule.size()].clear(); // Clear after elaborating
+				tracer.completeStep(schedule.size());
 			}
 			// Persist to file (append)
 			persistingResult(tmpResult);
 			// Clear tmp vector
 			tmpResult.clear();
 		} 
+		recordTraces();
 
 		// Save the progress in the elaboration of data
-		if(previousLocal) {
+		if(speculativeBatch) {
+			speculativeBatch = false; // Progress is tracked by the owner
+		} else if(batchOrigin != workerId && findAdoptedPartition(batchOrigin) != nullptr) {
+			// Progress of a reassigned partition is persisted in the failed worker's files
+			AdoptedPartition* partition = findAdoptedPartition(batchOrigin);
+			partition->loader->saveProgress();
+			partition->insertManager->persistData();
+			persistAdoptedCounter(*partition);
+		} else if(previousLocal) {
 			loader->saveProgress(); // Persists current lines read
 		} else {
 			insertManager->persistData(); // Clears tmp file
 		}
 
+		// The work of the batch is persisted: a batch lost in a failure is redone
+		batchExecutions = 0;
+		redoPending = false;
+		checkRecovered(simTime());
+
+		// ChangeKeys held during the batch (insert credits) are delivered from the outbox, now that the batch is persisted
+		if(!deferredSends.empty()) {
+			outbox.insert(outbox.end(), deferredSends.begin(), deferredSends.end());
+			deferredSends.clear();
+			persistOutbox();
+		}
+
+		// Leaving the job: the batch is persisted, stop before loading the next one
+		if(leaving && setupComplete && !waitingForInsert) {
+			batchStarted = false;
+			drainForLeave();
+			return;
+		}
+
+		// Time-to-first-result
+		if(firstResultTime < 0 && batchStarted) {
+			firstResultTime = simTime();
+		}
+
 		// Attempt to load another batch of data, if the elaboration is not finished (local/changekey)
-		while(isScheduleEmpty() && (!finishedLocalElaboration || !finishedPartialCK)){
+		while(isScheduleEmpty() && !waitingForSetup && (!finishedLocalElaboration || !finishedPartialCK)){
 			loadNextBatch();
 		}
 
+		// With no work of its own, elaborate the next batch of a straggler
+		if(isScheduleEmpty() && speculativeLoader != nullptr) {
+			loadSpeculativeBatch();
+		}
+
 		// Persist changeKeyCtr, changeKeySent, changeKeyReceived before next batch
 		persistCKCounter();
+
+		// The previous batch is persisted: deliver committed ChangeKeys before going on
+		batchStarted = false;
+		if(!outbox.empty() && sendOutboxFront()) {
+			return;
+		}
+
+		// ChangeKeys waiting for credits: the local work goes on meanwhile, with none left idle until a receiver grants credits
+		if(!outbox.empty() && isScheduleEmpty()) {
+			EV_DETAIL << "Worker " << workerId << " - Waiting for insert credits - Status: Idle\n\n";
+			idle = true;
+			setState(STATE_WAITING_CREDIT);
+			return;
+		}
 		
-		EV<<"Status - Worker " << workerId << " - FinishedLocal: " << finishedLocalElaboration << " - FinishedCK: " << finishedPartialCK << " - CheckCKReceived: " << checkChangeKeyReceived << "\n";
+		EV_DEBUG << "Status - Worker " << workerId << " - FinishedLocal: " << finishedLocalElaboration << " - FinishedCK: " << finishedPartialCK << " - CheckCKReceived: " << checkChangeKeyReceived << "\n";
+
+		// Local data exhausted before the end of the input: idle until the next chunk
+		if(waitingForSetup && isScheduleEmpty()) {
+			EV_DETAIL << "Worker " << workerId << " - Waiting for the next input chunk - Status: Idle\n\n";
+			idle = true;
+			setState(STATE_WAITING_INPUT);
+			return;
+		}
 		
 		// If the worker has finished both local and ChangeKey data (for now), send a FinishLocalElaboration message to the leader
-		if(finishedLocalElaboration && finishedPartialCK && !finishNoticeSent) {
-			EV<<"\nSENDING FINISHED LOCAL ELABORATION WORKER: "<<workerId<<"\n\n";
-			FinishLocalElaborationMessage* finishLocalMsg = new FinishLocalElaborationMessage();
+		if(finishedLocalElaboration && finishedPartialCK && !finishNoticeSent && outbox.empty()) {
+			EV_DETAIL << "\nSENDING FINISHED LOCAL ELABORATION WORKER: "<<workerId<<"\n\n";
+			FinishLocalElaborationMessage* finishLocalMsg = finishLocalPool.acquire();
 			finishLocalMsg->setWorkerId(workerId);
 			finishLocalMsg->setChangeKeyReceived(changeKeyReceived);
 			finishLocalMsg->setChangeKeySent(changeKeySent);
-			send(finishLocalMsg, "out", 0);	
+			sendTo(finishLocalMsg, LEADER_ADDRESS);
 			finishNoticeSent = true;
 		}
 
 		// If the worker has sent the finish notice, and has finished all ChangeKey data, it can idle until:
 		//	a) Receives more ChangeKey data
 		//	b) The leader asks to check ChangeKey data
-		if(finishNoticeSent && finishedPartialCK && !checkChangeKeyReceived) {
-			std::cout<<"Worker " << workerId << " - Temporarily finished elaborating ChangeKeys - Status: Idle\n\n";
+		if(finishNoticeSent && finishedPartialCK && !checkChangeKeyReceived && !speculativeBatch) {
+			EV_DETAIL << "Worker " << workerId << " - Temporarily finished elaborating ChangeKeys - Status: Idle\n\n";
 			idle = true;
+			setState(STATE_IDLE);
 			return;
 		}
 
 		// If the worker has sent the finish notice, finished ChangeKey data, and has received a FinishLocal from the leader
 		// It must reply with its current partial result, for the leader to evaluate termination conditions
-		if(finishNoticeSent && finishedPartialCK && checkChangeKeyReceived) {
+		if(finishNoticeSent && finishedPartialCK && checkChangeKeyReceived && !speculativeBatch && outbox.empty()) {
 			CheckChangeKeyAckMessage* checkChangeKeyAckMsg = new CheckChangeKeyAckMessage();
+			checkChangeKeyAckMsg->setKind(MSG_CHECK_CK_ACK);
 			checkChangeKeyAckMsg->setWorkerId(workerId);
 
 			// Insert current partial result in the message
@@ -764,7 +1599,7 @@ void Worker::processStep()
 			} else {
 				//Load full result
 				loadSavedResult();
-				std::cout << "Sending partial result: ";
+				EV_DEBUG << "Sending partial result: ";
 				printingVector(tmpResult);
 				checkChangeKeyAckMsg->setPartialVectorArraySize(tmpResult.size());
 				for(int i = 0; i < tmpResult.size(); i++) {
@@ -777,9 +1612,10 @@ void Worker::processStep()
 			checkChangeKeyAckMsg->setChangeKeySent(changeKeySent);
 			
 			// Send the message and idle
-			send(checkChangeKeyAckMsg, "out", 0);
-			EV<<"\nChangeKey checked at worker: "<<workerId<<"\n\n";
-			idle = true;			
+			sendTo(checkChangeKeyAckMsg, LEADER_ADDRESS);
+			EV_DETAIL << "\nChangeKey checked at worker: "<<workerId<<"\n\n";
+			idle = true;
+			setState(STATE_IDLE);
 			return;
 		}
 
@@ -790,17 +1626,26 @@ void Worker::processStep()
 
 		// End of Logging code
 
-		// Schedule a nextStep accounting for batch loading delay (mid-high delay)
-		double delay = calculateDelay("load");
+		// Schedule a nextStep accounting for batch loading delay (mid-high delay), fixed plus per tuple loaded
+		long loaded = 0;
+		for(const auto& step : data) {
+			loaded += step.second.size();
+		}
+		double delay = calculateDelay("load", loaded);
 		scheduleAt(simTime() + delay, nextStepMsg);
+		setState(STATE_LOADING);
 		return;
 	}
 
 	// If there are data to be elaborated in the current schedule step
 	if(!data[currentScheduleStep].empty()){
+		batchStarted = true;
+		setState(STATE_PROCESSING);
 		// Take the first data point from the deque
 		int value = data[currentScheduleStep].front();
 		data[currentScheduleStep].pop_front();
+		currentTrace = tracer.take(currentScheduleStep);
+		tuplesProcessed++;
 
 		// Apply the current operation (Map/Filter/ChangeKey) to the extracted data point
 		bool result = applyOperation(value);
@@ -808,7 +1653,7 @@ void Worker::processStep()
 		// If the operation made the worker crash, return
 		if(failed) return;
 
-		EV << "Result: " << value << "\n";
+		EV_DEBUG << "Result: " << value << "\n";
 
 		/*
 		* Decide what to do with the resuting data point:
@@ -821,8 +1666,10 @@ void Worker::processStep()
 		if(result){
 			if(currentScheduleStep + 1 < schedule.size()){
 				data[currentScheduleStep + 1].push_back(value);
+				tracer.forward(currentScheduleStep + 1, currentTrace);
 			} else if(!reduceLast){
 				tmpResult.push_back(value);
+				tracer.complete(currentTrace);
 			}
 		}
 
@@ -830,31 +1677,32 @@ void Worker::processStep()
 		// this worker must wait for the exchange to terminate (ACK from other worker)
 		if(waitingForInsert) return;
 
-		// Schedule the next step delayed based on the current operation
-		double delay = calculateDelay(schedule[currentScheduleStep]);
+		// Schedule the next step delayed based on the current operation: the cost of the tuple, plus the fixed cost
+		// of the operation once per step of the batch
+		double delay = calculateDelay(schedule[currentScheduleStep], 1, chargedStep != currentScheduleStep);
+		chargedStep = currentScheduleStep;
 		scheduleAt(simTime()+delay, nextStepMsg);
-		EV<<"Scheduled next step\n";
+		EV_TRACE << "Scheduled next step\n";
 	} else {
 		// Current step is finished because the queue is empty
-		EV << "Empty queue, finished current step\n\n";
-		std::cout << "Worker " << workerId << " finished step " << currentScheduleStep << " - New step data: \n";
+		EV_DEBUG << "Empty queue, finished current step\n\n";
+		EV_DEBUG << "Worker " << workerId << " finished step " << currentScheduleStep << " - New step data: \n";
 		
-		// Logging code (IGNORE)
+		// Statistics
 		simtime_t end_op = simTime();
 		simtime_t duration = end_op - begin_op;
 
 		if(duration > 0) {
-			per_op_exec_times[getParentOperation(schedule[currentScheduleStep])].push_back(duration);
+			emitOperatorTime(schedule[currentScheduleStep], duration);
 		}
-		begin_op = simTime(); // Reset timer for next operation		
-		// End of Logging code
+		begin_op = simTime(); // Reset timer for next operation
 
 		// Increment the schedule step
 		currentScheduleStep++;
 
 		// If this step is the last, and it is a reduce, we move to the processReduce() function
 		if(reduceLast && currentScheduleStep == schedule.size() - 1) {
-			EV << "Entering reduce\n\n";
+			EV_DEBUG << "Entering reduce\n\n";
 			//std::cout << "Worker " << workerId << " reducing: ";
 			processReduce();
 			//std::cout<<"Returning after process reduce\n";
@@ -877,26 +1725,31 @@ void Worker::processStep()
 void Worker::processReduce(){
 	if(failureDetection(batchSize*schedule.size()/4)){ //Simulate as if it was distributed like the other 3 operations
 		// Logging (ignore - adding artificial delay)
-		double delay = calculateDelay(schedule[currentScheduleStep]);
-		int reductionFactor = (rand() % (batchSize)) + 1;
+		double delay = calculateDelay(schedule[currentScheduleStep], data[currentScheduleStep].size());
+		int reductionFactor = intuniform(1, batchSize);
 		// We just count durations, this is just a hack to avoid changing the deallocatingMemory() function
 		begin_op -= (delay/reductionFactor); // Divide delay by random number in [1, batchSize] to simulate failing in the middle of the operation
 		// End of logging
 		failed = true;
-		std::cout<<"FAILURE DETECTED AT WORKER: "<<workerId<<", deallocating memory\n";
+		EV_WARN << "FAILURE DETECTED AT WORKER: "<<workerId<<", deallocating memory\n";
+		recordFailure(PHASE_REDUCE);
 		deallocatingMemory();
 		return;
 	}
 	
 	// Call the reduce function on the current batch of data
+	setState(STATE_PROCESSING);
+	long items = data[currentScheduleStep].size();
 	int batchRes = reduce({data[currentScheduleStep].begin(), data[currentScheduleStep].end()});
 	tmpReduce = tmpReduce + batchRes; // Increment partial result
+	lastBatchReduce = batchRes; // Kept until the batch is committed
 
 	data[currentScheduleStep].clear();
+	tracer.completeStep(currentScheduleStep);
 
-	// Schedule a delayed nextStep due to the Reduce operation
-	double delay = calculateDelay(schedule[currentScheduleStep]);
-	std::cout << "Reduce delay: " << delay << "\n";
+	// Schedule a delayed nextStep due to the Reduce operation, fixed plus per tuple reduced
+	double delay = calculateDelay(schedule[currentScheduleStep], items);
+	EV_TRACE << "Reduce delay: " << delay << "\n";
 	currentScheduleStep++;
 
 	scheduleAt(simTime()+delay, nextStepMsg);
@@ -911,17 +1764,35 @@ void Worker::processReduce(){
 void Worker::loadNextBatch(){
 	// Clear previous data
 	data.clear();
+	tracer.clear();
+	speculativeBatch = false;
+	batchOrigin = workerId;
 
 	// Load a local batch
 	if(localBatch) {
 		// For fault tolerance purpose
 		previousLocal = true;
-		std::cout << "Worker " << workerId << " - Loading local:\n";
+		EV_DEBUG << "Worker " << workerId << " - Loading local:\n";
 		// Get a batch from BatchLoader
 		std::vector<int> batch = loader->loadBatch();
+
+		// Skip batches already committed by a speculative copy
+		while(!batch.empty() && insertManager->isCommitted(workerId, loader->getBatchesLoaded() - 1)) {
+			EV_INFO << "Worker " << workerId << " - Skipping batch " << loader->getBatchesLoaded() - 1 << ", committed by speculative copy\n";
+			loader->saveProgress();
+			batch = loader->loadBatch();
+		}
+		currentLocalBatch = batch.empty() ? -1 : loader->getBatchesLoaded() - 1;
+		returnSetupCredits();
 		
-		// If the loaded batch is empty, it means we reached the end of the file
-		if(batch.empty()){
+		// If the loaded batch is empty, continue with the partitions taken over from failed workers
+		if(batch.empty() && loadAdoptedBatch()){
+			EV_DEBUG << "Loaded batch of reassigned partition " << batchOrigin << "\n";
+		} else if(batch.empty() && !setupComplete){
+			// More input is on its way from the leader
+			waitingForSetup = true;
+		} else if(batch.empty()){
+			// Reached the end of the file
 			// Update FinishedLocal flag
 			finishedLocalElaboration = true;
 			localBatch = false;
@@ -929,30 +1800,111 @@ void Worker::loadNextBatch(){
 		} else {
 			// Else, insert data in the first step of the schedule
         	data[0].insert(data[0].end(), batch.begin(), batch.end());
+			tracer.append(0, batch.size(), traceInput(batch.size()));
 		}
 	} else {
 		// Load a changeKey batch
 		// For fault tolerance purpose
 		previousLocal = false;
-		EV << "Loading CK...\n";
+		EV_DEBUG << "Loading CK...\n";
 		
 		// Get a batch from InsertManager - Format is: <scheduleStep, [data]>
 		std::map<int, std::vector<int>> ckBatch = insertManager->getBatch();
+		emit(changeKeyBacklogSignal, insertManager->getBacklog());
+
+		// The drained data points return credits to their senders
+		int drained = 0;
+		for(const auto& stepPair : ckBatch) {
+			drained += stepPair.second.size();
+		}
+		returnInsertCredits(drained);
 
 		// If the batch is empty, it means this worker currently finished elaboration
 		if(ckBatch.empty()){
 			finishedPartialCK = true;
-			EV << "CK data empty" << "\n";
+			EV_DEBUG << "CK data empty" << "\n";
 		} else {
-			EV << "\n\nCK not empty";
+			EV_DEBUG << "\n\nCK not empty";
 			// Else, insert data in the corresponding schedule step
 			for(int i=0; i < ckBatch.size(); i++) {
 				data[i].insert(data[i].end(), ckBatch[i].begin(), ckBatch[i].end());
 			}
+
+			// Traced data points leave the backlog
+			for(const auto& stepPair : insertManager->getBatchTraces()) {
+				std::vector<TupleTrace> traces = stepPair.second;
+				for(TupleTrace& trace : traces) {
+					if(trace.traced()) {
+						emit(tupleBacklogWaitSignal, trace.leaveBacklog(SIMTIME_DBL(simTime())));
+					}
+				}
+				tracer.append(stepPair.first, ckBatch[stepPair.first].size(), traces);
+			}
 		}
 	}
 	localBatch = !finishedLocalElaboration; // Switch to ChangeKey data only when local data is finished
 	currentScheduleStep = 0; // Reset step
+	chargedStep = -1;
+}
+
+/*
+ * Loads the next batch of the partitions taken over from failed workers.
+ * The ChangeKey batch that a failed worker was elaborating is replayed first, then its remaining local data.
+ * The batch is elaborated with the failed worker's identity (batchOrigin), to send ChangeKeys with its request IDs.
+ *
+ * Returns:
+ *	- false if all reassigned partitions have been elaborated
+ */
+bool Worker::loadAdoptedBatch(){
+	for(auto& partition : adoptedPartitions) {
+		// ChangeKey batch in progress at the failure
+		std::map<int, std::vector<int>> ckBatch = partition.insertManager->getPreviousBatch();
+		if(!ckBatch.empty()) {
+			for(const auto& stepPair : ckBatch) {
+				data[stepPair.first].insert(data[stepPair.first].end(), stepPair.second.begin(), stepPair.second.end());
+				tracer.append(stepPair.first, stepPair.second.size());
+			}
+			batchOrigin = partition.workerId;
+			return true;
+		}
+
+		// Remaining local data, skipping batches committed by a speculative copy
+		std::vector<int> batch = partition.loader->loadBatch();
+		while(!batch.empty() && partition.loader->getBatchesLoaded() - 1 <= partition.committedBatch) {
+			partition.loader->saveProgress();
+			batch = partition.loader->loadBatch();
+		}
+		if(!batch.empty()) {
+			data[0].insert(data[0].end(), batch.begin(), batch.end());
+			tracer.append(0, batch.size());
+			batchOrigin = partition.workerId;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Loads the next batch of the straggler this worker is helping.
+ * When the owner's input is exhausted, the speculative copy ends.
+ */
+void Worker::loadSpeculativeBatch(){
+	std::vector<int> batch = speculativeLoader->loadBatch();
+	if(batch.empty()) {
+		endSpeculation();
+		return;
+	}
+
+	data.clear();
+	data[0].insert(data[0].end(), batch.begin(), batch.end());
+	tracer.clear();
+	tracer.append(0, batch.size());
+	speculativeBatch = true;
+	speculativeBatchIndex = speculativeLoader->getBatchesLoaded() - 1;
+	routedData.clear();
+	currentScheduleStep = 0;
+	chargedStep = -1;
+	EV_DETAIL << "Worker " << workerId << " - Loaded speculative batch " << speculativeBatchIndex << " of worker " << speculativeOwner << "\n";
 }
 
 /*
@@ -969,7 +1921,8 @@ bool Worker::applyOperation(int& value){
 	// Simulate crash probability
 	if(failureDetection()){
 		failed = true;
-		std::cout<<"FAILURE DETECTED AT WORKER: "<<workerId<<", deallocating memory\n";
+		EV_WARN << "FAILURE DETECTED AT WORKER: "<<workerId<<", deallocating memory\n";
+		recordFailure(batchPhase());
 		deallocatingMemory();
 		return false;
 	}
@@ -977,11 +1930,13 @@ bool Worker::applyOperation(int& value){
 	// Get current operation and respective parameter
 	const std::string& operation = schedule[currentScheduleStep];
 	const int& parameter = parameters[currentScheduleStep];
+	operatorExecutions++;
+	batchExecutions++;
 
 	// MAP segment
 	if(operation == "add" || operation == "sub" || operation == "mul" || operation == "div") {
 		int res = map(operation, parameter, value);
-		std::cout << "Map result: " << res << "\n";
+		EV_TRACE << "Map result: " << res << "\n";
 		value = res;
 
 		return true;
@@ -990,18 +1945,48 @@ bool Worker::applyOperation(int& value){
 	else if(operation == "lt" || operation == "gt" || operation == "le" || operation == "ge") {
 		return filter(operation, parameter, value);
 
+	}
+	// Merged filters (see ProgramOptimizer): parameter <= value <= upper bound
+	else if(operation == "range") {
+		return value >= parameter && value <= upperBounds[currentScheduleStep];
+
 	} 
 	// CHANGEKEY segment
 	else if(operation == "changekey") {
-		// Simulate probability of changing key
-		int newKey = changeKey(value, changeKeyProbability);
+		// Simulate probability of changing key (speculative and reassigned batches keep the keys of their owner)
+		int selfId = speculativeBatch ? speculativeOwner : batchOrigin;
+		int newKey = changeKey(value, parameter, selfId);
+
+		// Keys of speculative batches are routed by the owner once the batch is committed
+		if(newKey != -1 && speculativeBatch) {
+			routedData.push_back({newKey, value, currentScheduleStep + 1, speculativeOwner});
+			return false;
+		}
+
+		// A batch that may be committed by a speculative copy holds its ChangeKeys until commit
+		if(newKey != -1 && speculationStart != -1 && previousLocal && currentLocalBatch >= speculationStart) {
+			deferredSends.push_back({newKey, value, currentScheduleStep + 1, workerId, currentTrace});
+			return false;
+		}
+
+		// Keys taken over from a failed worker stay here (reassigned batches still consume a request ID, see sendData)
+		if(newKey != -1 && batchOrigin == workerId && keyOwner[newKey] == workerId) {
+			return true;
+		}
+
+		// With insert credits, ChangeKeys are held until the batch is persisted, then sent from the outbox as the receivers
+		// grant credits (request IDs are taken when sending, so a batch re-executed after a crash sends the same ones)
+		if(newKey != -1 && insertWindow > 0 && batchOrigin == workerId) {
+			deferredSends.push_back({newKey, value, currentScheduleStep + 1, workerId, currentTrace});
+			return false;
+		}
 		
 		// ChangeKey is executed if the key returned by the function is valid
 		if(newKey != -1) {
-        	std::cout << "Changing Key: " << workerId << " -> " << newKey << " for value: "<<value<<"\n";
+        	EV_TRACE << "Changing Key: " << workerId << " -> " << newKey << " for value: "<<value<<"\n";
         	// Send the current data point to worker corresponding to 'newKey'
         	// Current data point will be inserted at schedule step + 1 to account for this current Changekey operation
-        	sendData(newKey, value, currentScheduleStep + 1);
+        	sendData(newKey, value, currentScheduleStep + 1, batchOrigin, currentTrace);
 
         	// Return false because this data point no longer belongs to this worker
         	return false;
@@ -1015,18 +2000,29 @@ bool Worker::applyOperation(int& value){
 
 /*
 * Calculates the delay for a given operation by sampling from a lognormal distribution.
-* The parameters for the delay are retrieved from a map (`lognormal_params`) where each operation is associated
-* with a pair of values representing the mean (mu) and standard deviation (sigma) of the log-normal distribution.
+* Its mean is the cost of the operation kind in the cost model (`costModel`): the fixed part, if charged, plus the part
+* per item, over the speed of the node on the kind; its standard deviation is the coefficient of variation of the kind
+* times the mean.
 *
 * Parameter:
 *   - operation: A constant reference to a string that identifies the operation for which the delay is calculated.
+*   - items: Items (tuples) elaborated by the operation
+*   - fixed: Whether the fixed cost of the operation is charged (false: already charged for this step of the batch)
 *
 * Returns:
 *   - A float value representing the calculated delay for the given operation.
 */
-float Worker::calculateDelay(const std::string& operation){
-	double delay = lognormal(lognormal_params[getParentOperation(operation)].first, lognormal_params[getParentOperation(operation)].second);
-	std::cout << "OP:" << operation << "- delay: " << delay << "\n";
+float Worker::calculateDelay(const std::string& operation, long items, bool fixed){
+	std::string kind = getParentOperation(operation);
+	double delay = costModel.mean(kind, items, fixed);
+	if(delay > 0 && costModel.get(kind).cv > 0) {
+		std::pair<double, double> params = CostModel::lognormalParams(delay, costModel.get(kind).cv);
+		delay = lognormal(params.first, params.second);
+	}
+	if(cpuScheduler != nullptr && operation != "ping") {
+		delay = cpuScheduler->share(jobId, SIMTIME_DBL(simTime()), delay);
+	}
+	EV_TRACE << "OP:" << operation << "- delay: " << delay << "\n";
 	return delay;
 }
 
@@ -1090,21 +2086,33 @@ bool Worker::filter(std::string operation, int parameter, int data){
 }
 
 /*
-* Calculates a new key as function of the data point. The range of the modulo operator
-* is given by the probability value and the number of workers.
-* If the result of the modulo operation is a valid worker ID, it is returned, otherwise, returns -1.
+* Calculates a new key as function of the data point, with the partitioner selected by the changekey (see Partitioner.h).
+* If the key is a valid worker ID other than the owner's, it is returned, otherwise, returns -1.
+* In the pipelined mode, the keys are the workers of the stage running the next step: a value leaving
+* its stage always gets one (the modulo partitioner falls back to value % workers of the stage).
 *
 * Parameters:
 *   - data: The integer on which the operation is to be performed.
-*   - probability: Probability of changing key.
+*   - partitionerType: Partitioner of the changekey (its parameter).
+*   - selfId: ID of the worker owning the data point.
 *
 * Returns:
 *   - The new key if valid, otherwise -1.
 */
-int Worker::changeKey(int data, float probability){
-	int ckValue = data % (static_cast<int>((1/(probability)) * numWorkers));
-	// If the new key is not valid, return -1.
-	if(ckValue == workerId || ckValue >= numWorkers || ckValue < 0) {
+int Worker::changeKey(int data, int partitionerType, int selfId){
+	int ckValue;
+	if(stageOfStep.empty()) {
+		ckValue = partitioner.partition(partitionerType, data);
+	} else {
+		const Partitioner& stage = stagePartitioners[stageOfStep[currentScheduleStep + 1]];
+		ckValue = stage.partition(partitionerType, data);
+		if(ckValue == -1) {
+			const std::vector<int>& stageWorkers = stage.getMembers();
+			ckValue = stageWorkers[(data % (int)stageWorkers.size() + stageWorkers.size()) % stageWorkers.size()];
+		}
+	}
+	// If the key doesn't change, return -1.
+	if(ckValue == selfId || ckValue >= numWorkers || ckValue < 0) {
 		return -1;
 	}
 	return ckValue;
@@ -1136,7 +2144,7 @@ int Worker::reduce(std::vector<int> data){
 * Used for schedules ending with a 'reduce' operation.
 */
 void Worker::loadPartialResults(){
-	std::string res_filename = "Data/Worker_" + std::to_string(workerId) + "/result.csv";
+	std::string res_filename = workerFolder(workerId) + "result.csv";
 	std::ifstream res_file(res_filename, std::ios::binary);
 	std::string line;
 
@@ -1152,7 +2160,7 @@ void Worker::loadPartialResults(){
 		res_file.close();
 	}
 	
-	std::cout << "Worker " << workerId << " loaded reduce: " << tmpReduce << " [CRASH RECOVERY]" << "\n";
+	EV_INFO << "Worker " << workerId << " loaded reduce: " << tmpReduce << " [CRASH RECOVERY]" << "\n";
 }
 
 /*
@@ -1160,7 +2168,7 @@ void Worker::loadPartialResults(){
 * Used for schedules ending with an operation different than 'reduce'.
 */
 void Worker::loadSavedResult() {
-	std::string res_filename = "Data/Worker_" + std::to_string(workerId) + "/result.csv";
+	std::string res_filename = workerFolder(workerId) + "result.csv";
 	std::ifstream res_file(res_filename, std::ios::binary);
 	std::string line;
 
@@ -1209,7 +2217,7 @@ bool Worker::failureDetection(double factor){
 */
 void Worker::loadChangeKeyData(){
 
-	std::string ck_filename = "Data/Worker_" + std::to_string(workerId) + "/CK_sent_received.csv";
+	std::string ck_filename = workerFolder(workerId) + "CK_sent_received.csv";
 	std::ifstream ck_file(ck_filename, std::ios::binary); // Binary for Windows compatibility
 	std::string line;
 	
@@ -1222,21 +2230,21 @@ void Worker::loadChangeKeyData(){
 			// Template: ckSent, ckReceived
 			while (std::getline(iss, part, ',')) {
 				parts.push_back(std::stoi(part));
-				std::cout<<"Part: "<<part<<"\n";
+				EV_DEBUG << "Part: "<<part<<"\n";
 			}
 
 			if (parts.size() == 2) {
 				changeKeySent = parts[0];
 				changeKeyReceived = parts[1];
-				std::cout<<"Worker "<<workerId<<" -> LOADING: changeKeySent: "<<changeKeySent<<", changeKeyReceived: "<<changeKeyReceived<<"\n";
+				EV_DEBUG << "Worker "<<workerId<<" -> LOADING: changeKeySent: "<<changeKeySent<<", changeKeyReceived: "<<changeKeyReceived<<"\n";
 			}else{
-				std::cout<<"Error in loading change key data\n";
+				EV_ERROR << "Error in loading change key data\n";
 			}
 		}
 	}
 	ck_file.close();
 
-	std::string ck_counter = "Data/Worker_" + std::to_string(workerId) + "/CK_counter.csv";
+	std::string ck_counter = workerFolder(workerId) + "CK_counter.csv";
 	std::ifstream ck_counterFile(ck_counter, std::ios::binary); // Binary for Windows compatibility
 	std::string counterLine;
 
@@ -1246,18 +2254,19 @@ void Worker::loadChangeKeyData(){
 			std::string part;
 			std::vector<int> parts;
 
-			// Template: ChangeKeyCtr, previousLocal
+			// Template: ChangeKeyCtr, previousLocal, speculationStart
 			while(std::getline(iss, part, ',')){
 				parts.push_back(std::stoi(part));
 			}
 
-			if(parts.size() == 2){
+			if(parts.size() == 2 || parts.size() == 3){
 				changeKeyCtr = parts[0];
 				localBatch = parts[1] == 1 ? true : false; // Needed to restart elaboration from the same batch during which the worker crashed
 				previousLocal = localBatch;
-				std::cout<<"Worker "<<workerId<<" -> LOADING: ChangeKeyCtr: "<<changeKeyCtr<<", localBatch: "<<localBatch<<"\n";
+				speculationStart = parts.size() == 3 ? parts[2] : -1; // Keep deferring ChangeKeys if a speculative copy is running
+				EV_DEBUG << "Worker "<<workerId<<" -> LOADING: ChangeKeyCtr: "<<changeKeyCtr<<", localBatch: "<<localBatch<<", speculationStart: "<<speculationStart<<"\n";
 			}else{
-				std::cout<<"Error in loading change key counter\n";
+				EV_ERROR << "Error in loading change key counter\n";
 			}
 		}
 	}
@@ -1269,9 +2278,9 @@ void Worker::loadChangeKeyData(){
 * The worker's state is set to 'failed=true', which causes it to drop every message but the RestartMessages.
 */
 void Worker::deallocatingMemory(){
-	std::cout << "Worker " << workerId << " failing..." << "\n";
+	EV_WARN << "Worker " << workerId << " failing..." << "\n";
 	
-	// Logging code (IGNORE)
+	// Statistics: the work done until the failure
 
 	simtime_t end_op = simTime();
 	simtime_t end_batch = simTime();
@@ -1279,23 +2288,21 @@ void Worker::deallocatingMemory(){
 	simtime_t op_duration = end_op - begin_op;
 	simtime_t batch_duration = end_batch - begin_batch;
 
-	if(op_duration > 0){
-		per_op_exec_times[getParentOperation(schedule[currentScheduleStep])].push_back(op_duration);
+	if(op_duration > 0 && currentScheduleStep < schedule.size()){
+		emitOperatorTime(schedule[currentScheduleStep], op_duration);
 	}
 	
 	if(batch_duration > 0){
-		per_schedule_exec_times.push_back(batch_duration);
+		emit(batchTimeSignal, batch_duration);
 	}
 
-	// End of Logging code
-
 	failed = true;
+	setState(STATE_FAILED);
 
 	data.clear();
+	tracer.clear();
 
-	if(waitingForInsert) {
-		delete unstableMessage;
-	}
+	unstableReqID = -1;
 	if(insertTimeoutMsg != nullptr && insertTimeoutMsg->isScheduled() && waitingForInsert){
 		cancelEvent(insertTimeoutMsg);
 	}
@@ -1308,6 +2315,8 @@ void Worker::deallocatingMemory(){
 	// Data loader instances
 	delete loader;
 	delete insertManager;
+	loader = nullptr;
+	insertManager = nullptr;
 
 	// Worker information
 	numWorkers = 0;
@@ -1315,6 +2324,7 @@ void Worker::deallocatingMemory(){
 
 	// Current Batch Elaboration information
 	currentScheduleStep = 0;
+	chargedStep = -1;
 	reduceLast = false;
 	localBatch = !localBatch;
 
@@ -1332,11 +2342,33 @@ void Worker::deallocatingMemory(){
 
 	schedule.clear();
 	parameters.clear();
+	upperBounds.clear();
 
 	// Partial Results
 	tmpReduce = 0;
+	lastBatchReduce = 0;
 	tmpResult.clear();
 
+	// Speculative execution (Reloaded from the CK counter and outbox files)
+	currentLocalBatch = -1;
+	speculationStart = -1;
+	deferredSends.clear();
+	outbox.clear();
+	creditDebtors.clear();
+	outboxInFlight = false;
+	batchStarted = false;
+	if(speculativeLoader != nullptr) {
+		delete speculativeLoader;
+		speculativeLoader = nullptr;
+	}
+	speculativeOwner = -1;
+	speculativeBatch = false;
+	routedData.clear();
+
+	// Reassigned partitions (Reloaded from the adopted partitions file)
+	releaseAdoptedPartitions();
+	batchOrigin = -1;
+
 	if(pingResEvent != nullptr && pingResEvent->isScheduled()) {
 		cancelEvent(pingResEvent);
 	}
@@ -1344,42 +2376,45 @@ void Worker::deallocatingMemory(){
 	if(nextStepMsg != nullptr && nextStepMsg->isScheduled()) {
 		cancelEvent(nextStepMsg);
 	}
-	std::cout << "Crashed successfully\n";
+	EV_WARN << "Crashed successfully\n";
 }
 
 /*
-* Sends the data point to the worker specified, at the schedule step specified.
-* Creates a DataInsertMessage with the necessary information, creates a clone of the message and sends it.
+* Sends the data point to the worker owning the key specified, at the schedule step specified.
+* Records the data point as the unstable insertion and sends it with transmitInsert, from a pooled DataInsertMessage.
 * Starts a timeout self-message to re-send it in case the receiving worker has crashed.
+* If the key was taken over by this worker (reassigned partition), the data point is inserted locally,
+* still consuming a request ID so that the origin's request IDs stay aligned with the ones it used before failing.
 *
 * Parameters:
-*   - newKey: The ID of the worker receiving the DataInsert.
+*   - newKey: The key of the data point, resolved to the worker owning it.
 *	- value: Data point value to be sent
 *	- scheduleStep: Step of the schedule at which to insert the point
+*	- origin: Worker whose request IDs are used (this worker, or a failed worker whose partition was reassigned)
+*	- trace: Trace of the data point, if it is traced
 */
-void Worker::sendData(int newKey, int value, int scheduleStep){
-	// Create message
-	DataInsertMessage* insertMsg = new DataInsertMessage();
-
-	// Insert <k, v> pair
-	insertMsg->setDestID(newKey);
-	insertMsg->setData(value);
-	
-	// Use ChangeKeyCtr as requestID
-	insertMsg->setReqID(changeKeyCtr);
-
-	// Set the corresponding schedule step
-	insertMsg->setScheduleStep(scheduleStep);
-	insertMsg->setAck(false);
+void Worker::sendData(int newKey, int value, int scheduleStep, int origin, const TupleTrace& trace){
+	int& requestID = requestCounter(origin);
 
-	DataInsertMessage* insertMsgCopy = insertMsg->dup();
+	// Key owned by this worker: local insertion, with the same deduplication as remote ones
+	if(keyOwner[newKey] == workerId) {
+		if(!insertManager->insertValue(origin, requestID, scheduleStep, value, trace.enterBacklog(SIMTIME_DBL(simTime())))) {
+			countDuplicate(recoveryPhase);
+		}
+		requestID++;
+		finishedPartialCK = false;
+		changeKeySent++;
+		changeKeyReceived++;
+		persistCKSentReceived();
+		return;
+	}
 
-	// Get correct gate and send duplicate insert message
-	int outputGate = getWorkerGate(newKey);
-	send(insertMsgCopy, "out", outputGate);
+	// Keep the <k, v> pair as the unstable insertion, with the origin's ChangeKeyCtr as requestID
+	unstableInsert = {newKey, value, scheduleStep, origin, trace};
+	unstableReqID = requestID;
 
-	// Set this InsertMsg as the unstable message
-	unstableMessage = insertMsg;
+	// Send it to the worker owning the key
+	transmitInsert(keyOwner[newKey]);
 
 	// Create a cMessage to set a timeout
 	if(insertTimeoutMsg == nullptr) {
@@ -1392,7 +2427,7 @@ void Worker::sendData(int newKey, int value, int scheduleStep){
 	scheduleAt(simTime() + insertTimeout, insertTimeoutMsg);
 
 	// Increment ChangeKeyCtr (RequestID)
-	changeKeyCtr++;
+	requestID++;
 
 	// Set status to waiting for Insert ACK
 	// The worker should wait for the ACK before going on with the elaboration.
@@ -1400,40 +2435,468 @@ void Worker::sendData(int newKey, int value, int scheduleStep){
 }
 
 /*
-* Returns the Worker ID bounded to the specified input gate.
+* Sends the unstable insertion to the specified worker.
+* The message is taken from the pool and filled from the pending record, so that a retransmission
+* needs no copy of a previously sent message (which is owned by the network, or by the receiver, once sent).
 *
 * Parameters:
-*	- gateIndex: Index of the input gate to resolve
+*	- destWorker: Worker currently owning the destination key
+*/
+void Worker::transmitInsert(int destWorker){
+	DataInsertMessage* insertMsg = insertPool.acquire();
+	insertMsg->setDestID(unstableInsert.newKey);
+	insertMsg->setData(unstableInsert.value);
+	insertMsg->setSenderID(unstableInsert.origin);
+	insertMsg->setReqID(unstableReqID);
+	insertMsg->setScheduleStep(unstableInsert.scheduleStep);
+	insertMsg->setAck(false);
+	insertMsg->setReplayPhase(recoveryPhase);
+	if(unstableInsert.trace.traced()) {
+		insertMsg->setTraceOrigin(unstableInsert.trace.origin);
+		insertMsg->setTraceHops(unstableInsert.trace.hops);
+		insertMsg->setTraceBacklogWait(unstableInsert.trace.backlogWait);
+	}
+	emit(shuffleBytesSignal, (long)messageByteLength(insertMsg, payloadEncoding));
+	sendTo(insertMsg, workerAddress(destWorker));
+	setState(STATE_WAITING_INSERT, destWorker);
+}
+
+/*
+* Returns the request ID counter of the specified origin: this worker's ChangeKeyCtr, or the one
+* of a failed worker whose partition was taken over.
+*/
+int& Worker::requestCounter(int origin){
+	AdoptedPartition* partition = findAdoptedPartition(origin);
+	if(origin != workerId && partition != nullptr) {
+		return partition->changeKeyCtr;
+	}
+	return changeKeyCtr;
+}
+
+/*
+* Sends the first ChangeKey of the outbox whose receiver has granted credits. It is moved to the front of the
+* persisted outbox first, so that after a crash it is re-sent first, with the same request ID.
+* A local insertion completes immediately, so the elaboration goes on.
 *
 * Returns:
-*	- Corresponding worker ID
+*	- false if no ChangeKey of the outbox can be sent (no credits)
 */
-int Worker::getInboundWorkerID(int gateIndex) {
-	if(gateIndex <= workerId) {
-		return gateIndex - 1;
+bool Worker::sendOutboxFront(){
+	auto sendable = std::find_if(outbox.begin(), outbox.end(), [this](const PendingInsert& pending) { return hasInsertCredit(pending.newKey); });
+	if(sendable == outbox.end()) {
+		creditStalls++;
+		return false;
+	}
+	if(sendable != outbox.begin()) {
+		PendingInsert pending = *sendable;
+		outbox.erase(sendable);
+		outbox.push_front(pending);
+		persistOutbox();
+	}
+
+	const PendingInsert pending = outbox.front();
+	outboxInFlight = true;
+	if(insertWindow > 0 && keyOwner[pending.newKey] != workerId) {
+		insertCredits[keyOwner[pending.newKey]]--;
 	}
-	return gateIndex;
+	sendData(pending.newKey, pending.value, pending.scheduleStep, pending.origin, pending.trace);
+
+	if(!waitingForInsert) {
+		completeOutboxFront();
+		scheduleAt(simTime(), nextStepMsg);
+	}
+	return true;
+}
+
+// Returns whether a ChangeKey to the specified key can be sent: local, or the receiver has granted credits
+bool Worker::hasInsertCredit(int newKey){
+	return insertWindow == 0 || keyOwner[newKey] == workerId || insertCredits[keyOwner[newKey]] > 0;
 }
 
 /*
-* Returns the Gate index bounded to the specified Worker ID
+* Returns the credits of the data points drained from the ChangeKey backlog to their senders, one message per sender.
+* Data points are drained by schedule step rather than in arrival order: the credits are returned in arrival order,
+* which keeps the backlog within the credits granted to the senders.
 *
 * Parameters:
-*	- destID: ID of the worker to resolve
+*	- drained: Data points taken from the InsertManager
+*/
+void Worker::returnInsertCredits(int drained){
+	std::map<int, int> credits; // Sender, credits
+	for(int i = 0; i < drained && !creditDebtors.empty(); i++) {
+		credits[creditDebtors.front()]++;
+		creditDebtors.pop_front();
+	}
+	for(const auto& grant : credits) {
+		InsertCreditMessage *creditMsg = new InsertCreditMessage();
+		creditMsg->setKind(MSG_INSERT_CREDIT);
+		creditMsg->setCredits(grant.second);
+		creditMsg->setReset(false);
+		sendTo(creditMsg, workerAddress(grant.first));
+	}
+}
+
+/*
+* Grants a full window of credits to every other worker, after a restart: the credits of the data points
+* received before the crash can't be returned, the senders replace the ones they hold for this worker.
+*/
+void Worker::resetInsertCredits(){
+	for(int i = 0; i < numWorkers; i++) {
+		if(i == workerId) continue;
+		InsertCreditMessage *creditMsg = new InsertCreditMessage();
+		creditMsg->setKind(MSG_INSERT_CREDIT);
+		creditMsg->setCredits(insertWindow);
+		creditMsg->setReset(true);
+		sendTo(creditMsg, workerAddress(i));
+	}
+}
+
+/*
+* Removes the delivered ChangeKey from the outbox, persisting the outbox together with the request ID used.
+*/
+void Worker::completeOutboxFront(){
+	int origin = outbox.front().origin;
+	outbox.pop_front();
+	outboxInFlight = false;
+	persistOutbox();
+	if(replayOutbox > 0) {
+		replayOutbox--;
+		checkRecovered(simTime());
+	}
+
+	AdoptedPartition* partition = findAdoptedPartition(origin);
+	if(origin != workerId && partition != nullptr) {
+		persistAdoptedCounter(*partition);
+	} else {
+		persistCKCounter();
+	}
+}
+
+/*
+* Commits the local batch just elaborated, if a speculative copy may have committed it too.
+* On success, the ChangeKeys held during the batch are moved to the outbox.
 *
 * Returns:
-*	- Output gate index corresponding to the specified worker
+*	- false if the batch was already committed by the speculative copy, and its result must be discarded
+*/
+bool Worker::commitLocalBatch(){
+	if(speculationStart == -1 || currentLocalBatch < speculationStart) {
+		return true;
+	}
+
+	if(!insertManager->commitBatch(workerId, currentLocalBatch)) {
+		deferredSends.clear();
+		return false;
+	}
+
+	outbox.insert(outbox.end(), deferredSends.begin(), deferredSends.end());
+	deferredSends.clear();
+	persistOutbox();
+	return true;
+}
+
+/*
+* Sends the result of the speculative batch just elaborated to its owner, which commits it
+* unless it has already committed the same batch. The result is removed from this worker's partial results.
+*/
+void Worker::sendSpeculativeCommit(){
+	SpeculativeCommitMessage* commitMsg = new SpeculativeCommitMessage();
+	commitMsg->setKind(MSG_SPECULATIVE_COMMIT);
+	commitMsg->setOwnerId(speculativeOwner);
+	commitMsg->setBatchIndex(speculativeBatchIndex);
+
+	if(reduceLast) {
+		commitMsg->setPartialRes(lastBatchReduce);
+		tmpReduce -= lastBatchReduce; // The partial result belongs to the owner
+	} else {
+		// Data points sent by a ChangeKey at the last step are part of the result
+		for(const auto& value : data[schedule.size()]) {
+			tmpResult.push_back(value);
+		}
+		data[schedule.size()].clear();
+
+		commitMsg->setResultsArraySize(tmpResult.size());
+		for(int i = 0; i < tmpResult.size(); i++) {
+			commitMsg->setResults(i, tmpResult[i]);
+		}
+		tmpResult.clear();
+	}
+
+	// ChangeKeys are sent by the owner, with its own request IDs
+	commitMsg->setRoutedKeysArraySize(routedData.size());
+	commitMsg->setRoutedStepsArraySize(routedData.size());
+	commitMsg->setRoutedValuesArraySize(routedData.size());
+	for(int i = 0; i < routedData.size(); i++) {
+		commitMsg->setRoutedKeys(i, routedData[i].newKey);
+		commitMsg->setRoutedSteps(i, routedData[i].scheduleStep);
+		commitMsg->setRoutedValues(i, routedData[i].value);
+	}
+	routedData.clear();
+
+	sendTo(commitMsg, workerAddress(speculativeOwner));
+
+	// The speculative copy was cancelled while this batch was in progress
+	if(speculativeLoader == nullptr) {
+		speculativeOwner = -1;
+	}
+}
+
+/*
+* Stops the speculative copy. A batch in progress is still committed, so the owner is kept until then.
+*/
+void Worker::endSpeculation(){
+	EV_INFO << "Worker " << workerId << " - Speculation on worker " << speculativeOwner << " ended\n";
+	delete speculativeLoader;
+	speculativeLoader = nullptr;
+
+	if(!speculativeBatch) {
+		speculativeOwner = -1;
+	}
+}
+
+/*
+* Stops the elaboration for a graceful leave, between batches: the batches elaborated are persisted,
+* so the adopter of the partition resumes from there without redoing any.
+* The Leader is notified, and only then reassigns the partition; until the reassignment, DataInserts
+* are dropped and their senders re-send them to the adopter.
+*/
+void Worker::drainForLeave(){
+	if(speculativeOwner != -1) {
+		speculativeBatch = false; // A speculative batch not yet elaborated is left to its owner
+		endSpeculation();
+	}
+	if(nextStepMsg->isScheduled()) {
+		cancelEvent(nextStepMsg);
+	}
+	persistCKCounter();
+	stoppedToLeave = true;
+	idle = true;
+	setState(STATE_IDLE);
+	EV_INFO << "Worker " << workerId << " - Stopped to leave the job\n";
+
+	LeaveMessage* leaveMsg = new LeaveMessage();
+	leaveMsg->setKind(MSG_LEAVE);
+	leaveMsg->setWorkerId(workerId);
+	sendTo(leaveMsg, LEADER_ADDRESS);
+}
+
+/*
+* Takes over the partition of a failed worker, whose files are still available on durable storage.
+* The first time (merge), the failed worker's state is folded into this worker:
+*	- Pending inserted ChangeKeys and request log (InsertManager)
+*	- ChangeKey sent/received counters, for the termination condition
+*	- Partial result (reduce or result file)
+*	- Undelivered committed ChangeKeys (outbox)
+*	- Partitions that the failed worker had taken over in turn
+* Then the partition is loaded: remaining local data and ChangeKey batch in progress, with the failed worker's request IDs.
+*
+* Parameters:
+*	- failedId: ID of the failed worker
+*	- merge: false when reloading after a restart (the state was already folded)
+*/
+void Worker::adoptPartition(int failedId, bool merge){
+	if(findAdoptedPartition(failedId) != nullptr) {
+		return;
+	}
+	std::string failedFolder = workerFolder(failedId);
+	EV_INFO << "Worker " << workerId << " - Taking over the partition of worker " << failedId << "\n";
+
+	if(merge) {
+		// Pending ChangeKeys and request log
+		InsertManager failedInsertManager(failedFolder + "inserted.csv", failedFolder + "requests_log.csv", failedFolder + "committed_batches.csv", failedFolder + "ck_batch.csv", batchSize);
+		insertManager->absorb(failedInsertManager);
+		finishedPartialCK = false;
+
+		// ChangeKey counters
+		std::ifstream ck_file(failedFolder + "CK_sent_received.csv", std::ios::binary);
+		int sent, received;
+		char separator;
+		if(ck_file.is_open() && ck_file >> sent >> separator >> received) {
+			changeKeySent += sent;
+			changeKeyReceived += received;
+			persistCKSentReceived();
+		}
+		ck_file.close();
+
+		// Partial result
+		std::ifstream res_file(failedFolder + "result.csv", std::ios::binary);
+		std::vector<int> failedResult;
+		int value;
+		while(res_file.is_open() && res_file >> value) {
+			failedResult.push_back(value);
+		}
+		res_file.close();
+		if(reduceLast) {
+			tmpReduce += reduce(failedResult);
+			persistingReduce(tmpReduce - lastBatchReduce); // Do not persist the reduce of the batch in progress
+		} else {
+			persistingResult(failedResult);
+		}
+
+		// Undelivered ChangeKeys, sent with their origin's request IDs
+		std::ifstream outbox_file(failedFolder + "outbox.csv", std::ios::binary);
+		std::string line;
+		while(outbox_file.is_open() && std::getline(outbox_file, line)) {
+			std::istringstream iss(line);
+			std::string part;
+			std::vector<int> parts;
+			while(std::getline(iss, part, ',')) {
+				parts.push_back(std::stoi(part));
+			}
+			if(parts.size() == 4) {
+				outbox.push_back({parts[0], parts[2], parts[1], parts[3]});
+			}
+		}
+		outbox_file.close();
+		persistOutbox();
+
+		// Partitions previously taken over by the failed worker
+		std::ifstream adopted_file(failedFolder + "adopted.csv", std::ios::binary);
+		int adoptedId;
+		while(adopted_file.is_open() && adopted_file >> adoptedId) {
+			adoptPartition(adoptedId, false);
+		}
+		adopted_file.close();
+
+		// Record the adoption (after the nested ones, which were recorded by the recursive calls)
+		std::ofstream own_adopted_file(folder + "adopted.csv", std::ios::app);
+		own_adopted_file << failedId << '\n';
+		own_adopted_file.close();
+	}
+
+	AdoptedPartition partition;
+	partition.workerId = failedId;
+	partition.loader = new BatchLoader(failedFolder + "data.csv", failedFolder + "progress.txt", batchSize);
+	partition.insertManager = new InsertManager(failedFolder + "inserted.csv", failedFolder + "requests_log.csv", failedFolder + "committed_batches.csv", failedFolder + "ck_batch.csv", batchSize);
+	partition.committedBatch = partition.insertManager->getLastCommitted(failedId);
+	partition.changeKeyCtr = 0;
+
+	// Request IDs of the failed worker (Template: ChangeKeyCtr, previousLocal, speculationStart)
+	std::ifstream ck_counterFile(failedFolder + "CK_counter.csv", std::ios::binary);
+	int ctr;
+	if(ck_counterFile.is_open() && ck_counterFile >> ctr) {
+		partition.changeKeyCtr = ctr;
+	}
+	ck_counterFile.close();
+
+	adoptedPartitions.push_back(partition);
+
+	if(!merge) {
+		// Nested adoption: record it here too, so that a later takeover of this worker finds it
+		std::ofstream own_adopted_file(folder + "adopted.csv", std::ios::app);
+		own_adopted_file << failedId << '\n';
+		own_adopted_file.close();
+	}
+}
+
+/*
+* Reloads the partitions taken over from failed workers, after a restart.
+*/
+void Worker::loadAdoptedPartitions(){
+	std::ifstream adopted_file(folder + "adopted.csv", std::ios::binary);
+	std::vector<int> adoptedIds;
+	int adoptedId;
+	while(adopted_file.is_open() && adopted_file >> adoptedId) {
+		adoptedIds.push_back(adoptedId);
+	}
+	adopted_file.close();
+
+	for(int id : adoptedIds) {
+		if(findAdoptedPartition(id) != nullptr) {
+			continue;
+		}
+		AdoptedPartition partition;
+		std::string failedFolder = workerFolder(id);
+		partition.workerId = id;
+		partition.loader = new BatchLoader(failedFolder + "data.csv", failedFolder + "progress.txt", batchSize);
+		partition.insertManager = new InsertManager(failedFolder + "inserted.csv", failedFolder + "requests_log.csv", failedFolder + "committed_batches.csv", failedFolder + "ck_batch.csv", batchSize);
+		partition.committedBatch = partition.insertManager->getLastCommitted(id);
+		partition.changeKeyCtr = 0;
+
+		std::ifstream ck_counterFile(failedFolder + "CK_counter.csv", std::ios::binary);
+		int ctr;
+		if(ck_counterFile.is_open() && ck_counterFile >> ctr) {
+			partition.changeKeyCtr = ctr;
+		}
+		ck_counterFile.close();
+
+		adoptedPartitions.push_back(partition);
+	}
+}
+
+// Releases the data modules of the reassigned partitions
+void Worker::releaseAdoptedPartitions(){
+	for(auto& partition : adoptedPartitions) {
+		delete partition.loader;
+		delete partition.insertManager;
+	}
+	adoptedPartitions.clear();
+}
+
+// Returns the reassigned partition of the specified failed worker, nullptr if not taken over by this worker
+AdoptedPartition* Worker::findAdoptedPartition(int origin){
+	for(auto& partition : adoptedPartitions) {
+		if(partition.workerId == origin) {
+			return &partition;
+		}
+	}
+	return nullptr;
+}
+
+/*
+* Persists the request ID counter of a reassigned partition in the failed worker's CK counter file.
 */
-int Worker::getWorkerGate(int destID){
-	if(destID < workerId){
-		//out[newKey + 1] (Corresponding to worker "newKey")
-		return destID + 1;
-	} else if(destID > workerId) {
-		//out[newKey]
-		return destID;
+void Worker::persistAdoptedCounter(const AdoptedPartition& partition){
+	std::string fileName = workerFolder(partition.workerId) + "CK_counter.csv";
+
+	std::ofstream counter_file(fileName);
+	if(counter_file.is_open()){
+		counter_file << partition.changeKeyCtr << ",1,-1";
+		counter_file.close();
+	}else{
+		EV_ERROR << "Can't open file: " << fileName << "\n";
 	}
-	EV << "Error: self getWorkerGate";
-	return -1;
+}
+
+/*
+* Returns the number of messages allocated by the pools (messages sent after a pool ran empty).
+*/
+long long Worker::messageAllocations() const {
+	return insertPool.getAllocations() + pingPool.getAllocations() + finishLocalPool.getAllocations();
+}
+
+/*
+* Returns the number of messages recycled by the pools.
+*/
+long long Worker::messageReuses() const {
+	return insertPool.getReuses() + pingPool.getReuses() + finishLocalPool.getReuses();
+}
+
+/*
+* Sends a message to the node with the specified address, through the output gate chosen by the routing layer.
+* The message is sized from its payload, and waits for the link if it is busy.
+*
+* Parameters:
+*	- msg: Message to send
+*	- destAddress: Address of the destination (LEADER_ADDRESS, or workerAddress(id))
+*/
+void Worker::sendTo(RoutedMessage *msg, int destAddress){
+	msg->setSrcAddress(workerAddress(nodeIndex));
+	msg->setDestAddress(destAddress);
+	msg->setJobId(jobId);
+	msg->setByteLength(messageByteLength(msg, payloadEncoding));
+	msg->setTimestamp();
+	sendQueued(msg, router.outputGate(destAddress));
+}
+
+/*
+* Returns the folder of the persistent state of a worker: "<dataDir>/Worker_<id>/".
+*
+* Parameters:
+*	- id: ID of the worker
+*/
+std::string Worker::workerFolder(int id) const {
+	return dataDir + "/Worker_" + std::to_string(id) + "/";
 }
 
 /*
@@ -1443,7 +2906,7 @@ int Worker::getWorkerGate(int destID){
 *	- result: Vector of ints to be persisted.
 */
 void Worker::persistingResult(std::vector<int> result) {
-    std::string folder = "Data/Worker_" + std::to_string(workerId) + "/";
+    std::string folder = workerFolder(workerId);
     std::ofstream result_file;
 
     std::string fileName = folder + "result.csv";
@@ -1465,18 +2928,18 @@ void Worker::persistingResult(std::vector<int> result) {
 *	- reducedValue: Value to be persisted.
 */
 void Worker::persistingReduce(int reducedValue){
-	std::string folder = "Data/Worker_" + std::to_string(workerId) + "/";
+	std::string folder = workerFolder(workerId);
 	std::string fileName = folder + "result.csv";
 
 	std::ofstream result_file(fileName);
 	if(result_file.is_open()){
-		EV << "Opened reduce file\n";
+		EV_DEBUG << "Opened reduce file\n";
 		result_file << reducedValue;
 
 		result_file.close();
 		
 	}else{
-		EV << "Can't open file: " << fileName << "\n";
+		EV_ERROR << "Can't open file: " << fileName << "\n";
 	}
 	
 }
@@ -1485,115 +2948,152 @@ void Worker::persistingReduce(int reducedValue){
 * Persists the ChangeKeyCtr and previousLocal variables.
 */
 void Worker::persistCKCounter(){
-	std::string folder = "Data/Worker_" + std::to_string(workerId) + "/";
+	std::string folder = workerFolder(workerId);
 	std::string fileName = folder + "CK_counter.csv";
 
 	int batchType = previousLocal ? 1 : 0;
 
 	std::ofstream result_file(fileName);
 	if(result_file.is_open()){
-		EV << "Opened CK file\n";
-		std::cout<<"Worker "<<workerId<<" -> PERSISTING: changeKeyCtr: "<<changeKeyCtr<<", localBatch: "<<previousLocal<<", batchType: "<<batchType<<"\n";
-		result_file<<changeKeyCtr<<","<<batchType;
+		EV_DEBUG << "Opened CK file\n";
+		EV_DEBUG << "Worker "<<workerId<<" -> PERSISTING: changeKeyCtr: "<<changeKeyCtr<<", localBatch: "<<previousLocal<<", batchType: "<<batchType<<"\n";
+		result_file<<changeKeyCtr<<","<<batchType<<","<<speculationStart;
 
 		result_file.close();
 		
 	}else{
-		EV << "Can't open file: " << fileName << "\n";
+		EV_ERROR << "Can't open file: " << fileName << "\n";
 	}
 }
 
 /*
-* Persists counters for ChangeKeySent and ChangeKeyReceived
+* Persists the committed ChangeKeys that were not delivered yet.
 */
-void Worker::persistCKSentReceived(){
-	std::string folder = "Data/Worker_" + std::to_string(workerId) + "/";
-	std::string fileName = folder + "CK_sent_received.csv";
-
-	std::ofstream result_file(fileName);
-	if(result_file.is_open()){
-		EV << "Opened CK file\n";
-		std::cout<<"Worker "<<workerId<<" -> PERSISTING: changeKeySent: "<<changeKeySent<<", changeKeyReceived: "<<changeKeyReceived<<"\n";
-		result_file<<changeKeySent<<","<<changeKeyReceived;
-
-		result_file.close();
-		
+void Worker::persistOutbox(){
+	std::string folder = workerFolder(workerId);
+	std::string fileName = folder + "outbox.csv";
+
+	emit(outboxLengthSignal, (long)outbox.size());
+	std::ofstream outbox_file(fileName, std::ofstream::trunc);
+	if(outbox_file.is_open()){
+		// Template: newKey, scheduleStep, value, origin
+		for(const auto& pending : outbox) {
+			outbox_file << pending.newKey << ',' << pending.scheduleStep << ',' << pending.value << ',' << pending.origin << '\n';
+		}
+		outbox_file.close();
 	}else{
-		EV << "Can't open file: " << fileName << "\n";
+		EV_ERROR << "Can't open file: " << fileName << "\n";
 	}
 }
 
 /*
-* Converts the parameters for every operation into lognormal parameters.
-* For an explanation, see the 'calculateDistributionParams'
+* Loads the committed ChangeKeys that were not delivered before a crash.
 */
-void Worker::convertParameters() {
-	// MAP
-	lognormal_params["map"] = calculateDistributionParams(MAP_EXEC_TIME_AVG, MAP_EXEC_TIME_STD);
-
-	// FILTER
-	lognormal_params["filter"] = calculateDistributionParams(FILTER_EXEC_TIME_AVG, FILTER_EXEC_TIME_STD);
+void Worker::loadOutbox(){
+	std::string outbox_filename = workerFolder(workerId) + "outbox.csv";
+	std::ifstream outbox_file(outbox_filename, std::ios::binary);
+	std::string line;
 
-	// CK
-	lognormal_params["changekey"] = calculateDistributionParams(CHANGEKEY_EXEC_TIME_AVG, CHANGEKEY_EXEC_TIME_STD);
+	if(outbox_file.is_open()){
+		while(std::getline(outbox_file, line)){
+			std::istringstream iss(line);
+			std::string part;
+			std::vector<int> parts;
 
-	// REDUCE
-	lognormal_params["reduce"] = calculateDistributionParams(REDUCE_EXEC_TIME_AVG, REDUCE_EXEC_TIME_STD);
+			// Template: newKey, scheduleStep, value, origin
+			while(std::getline(iss, part, ',')){
+				parts.push_back(std::stoi(part));
+			}
 
-	// PING
-	lognormal_params["ping"] = calculateDistributionParams(PING_DELAY_AVG, PING_DELAY_STD);
+			if(parts.size() == 4){
+				outbox.push_back({parts[0], parts[2], parts[1], parts[3]});
+			}
+		}
+		outbox_file.close();
+	}
+	EV_INFO << "Worker " << workerId << " loaded " << outbox.size() << " undelivered ChangeKeys [CRASH RECOVERY]" << "\n";
+}
 
-	// RESTART
-	lognormal_params["restart"] = calculateDistributionParams(RESTART_DELAY_AVG, RESTART_DELAY_STD);
+/*
+* Persists counters for ChangeKeySent and ChangeKeyReceived
+*/
+void Worker::persistCKSentReceived(){
+	std::string folder = workerFolder(workerId);
+	std::string fileName = folder + "CK_sent_received.csv";
 
-	// FINISH
-	lognormal_params["finish"] = calculateDistributionParams(FINISH_EXEC_DELAY_AVG, FINISH_EXEC_DELAY_STD);
+	std::ofstream result_file(fileName);
+	if(result_file.is_open()){
+		EV_DEBUG << "Opened CK file\n";
+		EV_DEBUG << "Worker "<<workerId<<" -> PERSISTING: changeKeySent: "<<changeKeySent<<", changeKeyReceived: "<<changeKeyReceived<<"\n";
+		result_file<<changeKeySent<<","<<changeKeyReceived;
 
-	// LOAD
-	lognormal_params["load"] = calculateDistributionParams(BATCH_LOAD_TIME_AVG, BATCH_LOAD_TIME_STD);
+		result_file.close();
+		
+	}else{
+		EV_ERROR << "Can't open file: " << fileName << "\n";
+	}
 }
 
 /*
-* Given mean, stddev, calculate the corresponding parameters of a lognormal distribution.
-* We need this function because the parameters of a lognormal don't directly define its mean/stddev but they define
-* the underlying normal distrbution's parameters.
+* Sets up the cost model of the operations from the parameters of the worker:
+*	- map, filter, changekey, reduce, load: "<kind>Cost" per invocation, "<kind>ItemCost" per tuple, "<kind>CostCv"
+*	- ping, restart, finish: "<kind>Cost" and "<kind>CostCv"
+* and the speed of the node: speedFactor on every kind, times the factors of speedFactors by kind.
 */
-std::pair<double, double> Worker::calculateDistributionParams(double m, double s) {
-	double mu = log((m * m) / sqrt(s * s + m * m));
-    double sigma = sqrt(log((s * s) / (m * m) + 1));
+void Worker::setupCostModel() {
+	costModel = CostModel();
+	for(const char* kind : {"map", "filter", "changekey", "reduce", "load"}) {
+		std::string name = kind;
+		costModel.set(kind, par((name + "Cost").c_str()).doubleValue(), par((name + "ItemCost").c_str()).doubleValue(), par((name + "CostCv").c_str()).doubleValue());
+	}
+	for(const char* kind : {"ping", "restart", "finish"}) {
+		std::string name = kind;
+		costModel.set(kind, par((name + "Cost").c_str()).doubleValue(), 0, par((name + "CostCv").c_str()).doubleValue());
+	}
 
-    return std::make_pair(mu, sigma);
+	// Heterogeneous node speed
+	costModel.scaleSpeed("*", speedFactor);
+	try {
+		costModel.parseSpeeds(par("speedFactors").stdstringValue());
+	} catch(const std::invalid_argument& e) {
+		throw cRuntimeError("%s", e.what());
+	}
+	chargedStep = -1;
 }
 
 void Worker::printingVector(std::vector<int> vector){
     for(int i=0; i<vector.size(); i++){
-        std::cout<<vector[i]<<" ";
+        EV_DEBUG << vector[i]<<" ";
     }
-    std::cout << "\n";
+    EV_DEBUG << "\n";
 }
 
 void Worker::printScheduledData(std::map<int, std::deque<int>> data){
 	for(int i = 0; i<data.size(); i++){
-		if(data[i].size() > 0) std::cout << "Step " << i << ": ";
+		if(data[i].size() > 0) {
+			EV_DEBUG << "Step " << i << ": ";
+		}
 
 		for(int j = 0; j < data[i].size(); j++){
-			std::cout << data[i][j] << " ";
+			EV_DEBUG << data[i][j] << " ";
 		}
 
-		if(data[i].size() > 0) std::cout << "\n";
+		if(data[i].size() > 0) {
+			EV_DEBUG << "\n";
+		}
 	}
 }
 
 void Worker::printDataInsertMessage(DataInsertMessage* msg, bool recv){
 	if(recv){
-		std::cout << "Worker " << workerId << " received DataInsert:\n";
-		std::cout << "Sender: " << getInboundWorkerID(msg->getArrivalGate()->getIndex()) << "\n";
-	}
-	std::cout << "Dest ID: " << msg->getDestID() << "\n";
-	std::cout << "Req ID: " << msg->getReqID() << "\n";
-	std::cout << "Data: " << msg->getData() << "\n";
-	std::cout << "Schedule step: " << msg->getScheduleStep() << "\n";
-	std::cout << "Ack: " << msg->getAck() << "\n";
+		EV_DEBUG << "Worker " << workerId << " received DataInsert:\n";
+		EV_DEBUG << "Sender: " << addressToWorker(msg->getSrcAddress()) << "\n";
+	}
+	EV_DEBUG << "Dest ID: " << msg->getDestID() << "\n";
+	EV_DEBUG << "Req ID: " << msg->getReqID() << "\n";
+	EV_DEBUG << "Data: " << msg->getData() << "\n";
+	EV_DEBUG << "Schedule step: " << msg->getScheduleStep() << "\n";
+	EV_DEBUG << "Ack: " << msg->getAck() << "\n";
 	return;
 }
 
@@ -1612,73 +3112,148 @@ std::string Worker::getParentOperation(const std::string& op) {
 	if(op == "add" || op == "sub" || op == "mul" || op == "div") {
 		return "map";
 	}
-	if(op == "lt" || op == "gt" || op == "le" || op == "ge") {
+	if(op == "lt" || op == "gt" || op == "le" || op == "ge" || op == "range") {
 		return "filter";
 	}
 	return op;
 }
 
-void Worker::logSimData() {
-    // Write duration to a file
+/*
+* Emits the elaboration time of an operator on the signal of its kind ("mapTime", "filterTime", ...),
+* registered on first use with the recorders of the "operatorTime" statistic template.
+*/
+void Worker::emitOperatorTime(const std::string& operation, simtime_t duration) {
+	std::string op = getParentOperation(operation);
+	auto it = operatorTimeSignals.find(op);
+	if(it == operatorTimeSignals.end()) {
+		std::string name = op + "Time";
+		simsignal_t signal = registerSignal(name.c_str());
+		getEnvir()->addResultRecorders(this, signal, name.c_str(), getProperties()->get("statisticTemplate", "operatorTime"));
+		it = operatorTimeSignals.insert({op, signal}).first;
+	}
+	emit(it->second, duration);
+}
 
-    std::string logDir = "./Logs";
-    fs::path parentDir = fs::path(logDir) / fs::path(EXPERIMENT_NAME);
-	int maxId = -1;
+// Returns the phase of a failure during the elaboration of the current batch (local or ChangeKey batch)
+int Worker::batchPhase() const {
+	return (previousLocal || speculativeBatch) ? PHASE_LOCAL : PHASE_CHANGEKEY;
+}
 
-    // Ensure the parent directory exists
-	if(!fs::exists(logDir)) {
-		fs::create_directory(logDir);
+/*
+* Accounts a failure: the operator executions of the batch in elaboration are lost, and the batch is reloaded
+* and redone after the restart. A failure during the recovery of a previous one extends that recovery.
+*
+* Parameters:
+*	- phase: elaboration in progress (see FailurePhase)
+*/
+void Worker::recordFailure(int phase) {
+	failuresByPhase[phase]++;
+	wastedExecutions[phase] += batchExecutions;
+	lostBatch = batchExecutions > 0 || phase == PHASE_REDUCE;
+	batchExecutions = 0;
+	if(recoveryPhase == -1) {
+		recoveryPhase = phase;
+		failureTime = simTime();
 	}
+}
 
-    if (!fs::exists(parentDir)) {
-        fs::create_directory(parentDir);
-    }
+/*
+* Ends the recovery of a failure once the lost batch is persisted again and the ChangeKeys reloaded from the outbox
+* are delivered: records the time from the failure (s). Until then, the ChangeKeys sent are marked as replays.
+*
+* Parameters:
+*	- now: time the worker is recovered, if it is
+*/
+void Worker::checkRecovered(simtime_t now) {
+	if(recoveryPhase == -1 || failed || redoPending || replayOutbox > 0) {
+		return;
+	}
+	recoveryTimes[recoveryPhase] += SIMTIME_DBL(now - failureTime);
+	emit(recoveryTimeSignal, now - failureTime);
+	recoveryPhase = -1;
+}
 
-    // Scan existing folders to find the max ID
-    for (const auto& entry : fs::directory_iterator(parentDir)) {
-        if (entry.is_directory()) {
-            std::string folderName = entry.path().filename().string();
-            try {
-                int folderId = std::stoi(folderName);
-                maxId = std::max(maxId, folderId);
-            } catch (const std::invalid_argument& e) {
-                // Not a number-named folder, ignore
-            }
-        }
-    }
+// Counts a ChangeKey dropped as a duplicate by the InsertManager (phase: recovery of the sender, -1 if none)
+void Worker::countDuplicate(int phase) {
+	if(phase >= 0 && phase < PHASE_COUNT) {
+		duplicateInserts[phase]++;
+	} else {
+		retransmittedDuplicates++;
+	}
+}
 
-    // Determine the folder name for the new simulation
-    int newFolderId = maxId;
-    fs::path newFolderPath = parentDir / std::to_string(newFolderId);
+// Enters a state of the timeline of the worker (peer: worker waited for)
+void Worker::setState(int state, int peer) {
+	timeline.enter(state, SIMTIME_DBL(simTime()), peer);
+}
 
-    // Assuming folder was already created by leader
+const StateTimeline& Worker::getTimeline() const {
+	return timeline;
+}
 
-    // First: Save per batch, full schedule elaboration times
-    fileName = newFolderPath.string() + "/WRK_" + std::to_string(workerId) + "_fullSched_" + std::to_string(batchSize) + ".log"; 
-    std::ofstream outFile_fs(fileName);
-    if (outFile_fs.is_open()) {
-        for(const auto& entry : per_schedule_exec_times) {
-        	outFile_fs << entry << "\n";
-        }
-        outFile_fs.close();
-    } else {
-        EV << "Error opening file for writing simulation duration.\n";
-    }
+/*
+* Returns the traces of the input tuples of a local batch, read now: every tuple is traced with probability traceSampling.
+*
+* Parameters:
+*	- count: tuples of the batch
+*/
+std::vector<TupleTrace> Worker::traceInput(size_t count) {
+	std::vector<TupleTrace> traces(tracer.isEnabled() ? count : 0);
+	for(TupleTrace& trace : traces) {
+		if(tracer.getSampling() >= 1 || uniform(0, 1, TRACE_RNG) < tracer.getSampling()) {
+			trace.origin = SIMTIME_DBL(simTime());
+			tuplesTraced++;
+		}
+	}
+	return traces;
+}
 
-    // Second: Save per batch, per operation elaboration times
-    for(const auto& op : per_op_exec_times) {
-    	std::string opName = op.first;
-    	std::vector<simtime_t> execTimes = op.second;
-
-    	fileName = newFolderPath.string() + "/WRK_" + std::to_string(workerId) + "_" + opName +"_" + std::to_string(batchSize) + ".log"; 
-    	std::ofstream outFile_op(fileName);
-	    if (outFile_op.is_open()) {
-	        for(const auto& entry : execTimes) {
-	        	outFile_op << entry << "\n";
-	        }
-	        outFile_op.close();
-	    } else {
-	        EV << "Error opening file for writing simulation duration.\n";
-	    }
-    }
+/*
+* Emits the latency of the traced tuples of the persisted batch, from their input to the result (result.csv, or the reduce),
+* on the signal of their path: "tupleLatencyLocal" without ChangeKey hops, "tupleLatency<N>Hops" (registered on first use
+* with the recorders of the "tupleLatency" statistic template).
+*/
+void Worker::recordTraces() {
+	for(const TupleTrace& trace : tracer.takeCompleted()) {
+		auto it = tupleLatencySignals.find(trace.hops);
+		if(it == tupleLatencySignals.end()) {
+			std::string name = "tupleLatency" + (trace.hops == 0 ? std::string("Local") : std::to_string(trace.hops) + (trace.hops == 1 ? "Hop" : "Hops"));
+			simsignal_t signal = registerSignal(name.c_str());
+			getEnvir()->addResultRecorders(this, signal, name.c_str(), getProperties()->get("statisticTemplate", "tupleLatency"));
+			it = tupleLatencySignals.insert({trace.hops, signal}).first;
+		}
+		emit(it->second, SIMTIME_DBL(simTime()) - trace.origin);
+	}
+}
+
+/*
+* Records the scalars of the worker in the result files: tuples, operator executions, message allocations,
+* time-to-first-result and the statistics of the received messages (the distributions are recorded by the @statistics).
+*/
+void Worker::recordStatistics() {
+	recordScalar("tuplesProcessed", tuplesProcessed);
+	recordScalar("operatorExecutions", operatorExecutions);
+	recordScalar("messageAllocations", messageAllocations());
+	recordScalar("messageReuses", messageReuses());
+	recordScalar("allocationsPerTuple", tuplesProcessed > 0 ? (double)messageAllocations() / tuplesProcessed : 0);
+	if(firstResultTime >= 0) {
+		recordScalar("firstResultTime", firstResultTime, "s");
+	}
+	if(tracer.isEnabled()) {
+		recordScalar("tuplesTraced", tuplesTraced);
+	}
+	for(int phase = 0; phase < PHASE_COUNT; phase++) {
+		std::string suffix = std::string(":") + failurePhaseNames[phase];
+		recordScalar(("failures" + suffix).c_str(), failuresByPhase[phase]);
+		recordScalar(("wastedExecutions" + suffix).c_str(), wastedExecutions[phase]);
+		recordScalar(("reloadedTuples" + suffix).c_str(), reloadedTuples[phase]);
+		recordScalar(("duplicateInserts" + suffix).c_str(), duplicateInserts[phase]);
+		recordScalar(("recoveryTime" + suffix).c_str(), recoveryTimes[phase], "s");
+	}
+	recordScalar("duplicateInserts:retransmission", retransmittedDuplicates);
+	std::vector<double> stateTimes = timeline.timeInStates(SIMTIME_DBL(simTime()));
+	for(int state = 0; state < STATE_COUNT; state++) {
+		recordScalar((std::string("stateTime:") + workerStateName(state)).c_str(), stateTimes[state], "s");
+	}
+	messageStats.recordScalars(this);
 }
@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+"""
+Summarizes the runs of a parameter study (e.g. the [Sweep] configuration of omnetpp.ini) from the OMNeT++ scalar
+result files: the completion time and throughput of each combination of the iteration variables, averaged over its
+repetitions, and the scaling curves over the number of workers (throughput, speedup and efficiency).
+
+    python3 scripts/summarize_sweep.py results/ --config Sweep [--scale-var workers] [--out summary] [--plot]
+
+Writes <out>_runs.csv (one row per run), <out>.csv (one row per combination) and <out>_scaling.csv (speedup and
+efficiency relative to the smallest number of workers of each series); with --plot, and matplotlib installed,
+<out>_throughput.png and <out>_speedup.png.
+"""
+
+import argparse
+import csv
+import glob
+import math
+import os
+import shlex
+import statistics
+from collections import defaultdict
+
+LEADER_SCALARS = ["completionTime", "throughput", "duration", "dataSize", "scheduleSize"]
+
+
+def parse_sca(path):
+    """Returns the runs of a scalar file: {"config", "repetition", "itervars", "scalars"} (leader scalars by name)."""
+    runs = []
+    run = None
+    with open(path) as file:
+        for line in file:
+            fields = shlex.split(line)
+            if not fields:
+                continue
+            if fields[0] == "run":
+                run = {"id": fields[1], "config": "", "repetition": 0, "itervars": {}, "scalars": {}}
+                runs.append(run)
+            elif run is None:
+                continue
+            elif fields[0] == "attr" and len(fields) >= 3:
+                if fields[1] == "configname":
+                    run["config"] = fields[2]
+                elif fields[1] == "repetition":
+                    run["repetition"] = int(fields[2])
+                elif fields[1] == "iterationvars" and not run["itervars"]:
+                    # Older result files: "$workers=2, $batchSize=5"
+                    for assignment in fields[2].split(","):
+                        if "=" in assignment:
+                            name, value = assignment.strip().lstrip("$").split("=", 1)
+                            run["itervars"][name] = value
+            elif fields[0] == "itervar" and len(fields) >= 3:
+                run["itervars"][fields[1]] = fields[2]
+            elif fields[0] == "scalar" and len(fields) >= 4 and fields[1].endswith("leader"):
+                try:
+                    run["scalars"][fields[2]] = float(fields[3])
+                except ValueError:
+                    pass
+    return runs
+
+
+def number(value):
+    try:
+        return float(value)
+    except ValueError:
+        return value
+
+
+def mean_std(values):
+    if not values:
+        return math.nan, math.nan
+    if len(values) == 1:
+        return values[0], 0.0
+    return statistics.mean(values), statistics.stdev(values)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Summarize a parameter study from OMNeT++ scalar files")
+    parser.add_argument("results", nargs="?", default="results", help="directory of the .sca files")
+    parser.add_argument("--config", default="Sweep", help="configuration of the runs to summarize")
+    parser.add_argument("--scale-var", default="workers", help="iteration variable of the number of workers")
+    parser.add_argument("--out", default="summary", help="prefix of the output files")
+    parser.add_argument("--plot", action="store_true", help="draw the scaling curves (needs matplotlib)")
+    args = parser.parse_args()
+
+    runs = []
+    for path in sorted(glob.glob(os.path.join(args.results, "*.sca"))):
+        runs += [run for run in parse_sca(path) if run["config"] == args.config]
+    if not runs:
+        raise SystemExit("No runs of configuration '%s' in %s" % (args.config, args.results))
+
+    variables = sorted({name for run in runs for name in run["itervars"]})
+    incomplete = [run["id"] for run in runs if "completionTime" not in run["scalars"]]
+
+    # One row per run
+    with open(args.out + "_runs.csv", "w", newline="") as file:
+        writer = csv.writer(file)
+        writer.writerow(variables + ["repetition"] + LEADER_SCALARS)
+        for run in runs:
+            writer.writerow([run["itervars"].get(name, "") for name in variables] + [run["repetition"]] +
+                            [run["scalars"].get(name, "") for name in LEADER_SCALARS])
+
+    # One row per combination, over its repetitions (runs that did not complete are left out)
+    groups = defaultdict(list)
+    for run in runs:
+        if "completionTime" in run["scalars"]:
+            groups[tuple(run["itervars"].get(name, "") for name in variables)].append(run["scalars"])
+    summary = {}
+    with open(args.out + ".csv", "w", newline="") as file:
+        writer = csv.writer(file)
+        writer.writerow(variables + ["runs", "completionTime", "completionTimeStd", "throughput", "throughputStd"])
+        for key in sorted(groups, key=lambda key: [number(value) for value in key]):
+            completion = mean_std([scalars["completionTime"] for scalars in groups[key]])
+            throughput = mean_std([scalars["throughput"] for scalars in groups[key]])
+            summary[key] = throughput[0]
+            writer.writerow(list(key) + [len(groups[key]), "%.4f" % completion[0], "%.4f" % completion[1],
+                                         "%.4f" % throughput[0], "%.4f" % throughput[1]])
+
+    # Scaling: a series per combination of the other variables, relative to its smallest number of workers
+    series = defaultdict(dict)
+    if args.scale_var in variables:
+        scale = variables.index(args.scale_var)
+        for key, throughput in summary.items():
+            others = key[:scale] + key[scale + 1:]
+            series[others][key[scale]] = throughput
+    others = [name for name in variables if name != args.scale_var]
+    with open(args.out + "_scaling.csv", "w", newline="") as file:
+        writer = csv.writer(file)
+        writer.writerow(others + [args.scale_var, "throughput", "speedup", "efficiency"])
+        for key in sorted(series, key=lambda key: [number(value) for value in key]):
+            base = min(series[key], key=number)
+            for workers in sorted(series[key], key=number):
+                speedup = series[key][workers] / series[key][base] if series[key][base] > 0 else math.nan
+                writer.writerow(list(key) + [workers, "%.4f" % series[key][workers], "%.3f" % speedup,
+                                             "%.3f" % (speedup * number(base) / number(workers))])
+
+    print("%d runs of %s, %d combinations, %d runs without completion" % (len(runs), args.config, len(groups), len(incomplete)))
+    print("Wrote %s_runs.csv, %s.csv, %s_scaling.csv" % (args.out, args.out, args.out))
+
+    if args.plot and series:
+        try:
+            import matplotlib
+            matplotlib.use("Agg")
+            import matplotlib.pyplot as plt
+        except ImportError:
+            print("matplotlib is not installed: no plots")
+            return
+        for metric in ("throughput", "speedup"):
+            figure, axes = plt.subplots(figsize=(8, 5))
+            for key in sorted(series, key=lambda key: [number(value) for value in key]):
+                workers = sorted(series[key], key=number)
+                values = [series[key][w] for w in workers]
+                if metric == "speedup":
+                    values = [value / values[0] if values[0] > 0 else math.nan for value in values]
+                label = ", ".join("%s=%s" % pair for pair in zip(others, key))
+                axes.plot([number(w) for w in workers], values, marker="o", label=label)
+            if metric == "speedup":
+                workers = sorted({number(w) for key in series for w in series[key]})
+                axes.plot(workers, [w / workers[0] for w in workers], linestyle="--", color="grey", label="linear")
+            axes.set_xlabel(args.scale_var)
+            axes.set_ylabel("throughput (values/s)" if metric == "throughput" else "speedup")
+            axes.set_xscale("log", base=2)
+            axes.legend(fontsize="x-small")
+            figure.tight_layout()
+            figure.savefig("%s_%s.png" % (args.out, metric))
+            print("Wrote %s_%s.png" % (args.out, metric))
+
+
+if __name__ == "__main__":
+    main()
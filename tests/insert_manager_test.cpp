@@ -0,0 +1,79 @@
+/*
+* Checks of the InsertManager (modules/Libraries/InsertManager.h): the request IDs of the inserts and the
+* batches committed by speculative execution are separate sequences, also across a partition takeover (absorb)
+* and a reload from the files.
+*
+* Build and run (from the repository root, with the OMNeT++ environment set up):
+*	g++ -std=c++17 -I modules/Libraries -I $(opp_configfilepath | xargs dirname)/include tests/insert_manager_test.cpp \
+*		-L $(opp_configfilepath | xargs dirname)/lib -loppsim -loppenvir -loppcommon -o insert_manager_test
+*	./insert_manager_test
+* The exit status is the number of failed checks.
+*/
+#include <iostream>
+#include <string>
+#include <filesystem>
+
+#include "InsertManager.h"
+
+namespace fs = std::filesystem;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+	if(!condition) {
+		std::cerr << "FAILED: " << what << "\n";
+		failures++;
+	}
+}
+
+// InsertManager over the files of a worker folder
+static InsertManager* openManager(const fs::path& folder) {
+	fs::create_directories(folder);
+	return new InsertManager((folder / "inserted.csv").string(), (folder / "requests_log.csv").string(),
+		(folder / "committed_batches.csv").string(), (folder / "ck_batch.csv").string(), 10);
+}
+
+int main() {
+	const int adopter = 1;
+	fs::path root = fs::temp_directory_path() / "insert_manager_test";
+	fs::remove_all(root);
+
+	// The failed worker received the adopter's ChangeKeys with request IDs 0..5
+	InsertManager* failed = openManager(root / "worker2");
+	for(int reqID = 0; reqID <= 5; reqID++) {
+		check(failed->insertValue(adopter, reqID, 1, 100 + reqID), "insert into the failed worker");
+	}
+
+	// The adopter takes over: the request IDs of its own inserts are not batch commits
+	InsertManager* manager = openManager(root / "worker1");
+	manager->absorb(*failed);
+	for(int batch = 0; batch <= 5; batch++) {
+		check(!manager->isCommitted(adopter, batch), "batch " + std::to_string(batch) + " not committed after absorb");
+	}
+	check(!manager->insertValue(adopter, 5, 1, 105), "insert already received by the failed worker is a duplicate");
+
+	// A committed batch does not drop the following inserts, an insert does not commit batches
+	check(manager->commitBatch(adopter, 3), "first commit of batch 3");
+	check(!manager->commitBatch(adopter, 3), "second commit of batch 3");
+	check(!manager->isCommitted(adopter, 4), "batch 4 not committed");
+	check(manager->insertValue(adopter, 6, 1, 106), "local insert after a commit");
+	check(manager->insertValue(adopter, 20, 2, 120), "local insert with a request ID above the committed batch");
+	check(!manager->isCommitted(adopter, 10), "batch 10 not committed by the inserts");
+
+	InsertManager* fresh = openManager(root / "worker3");
+	check(fresh->commitBatch(adopter, 10), "commit of batch 10");
+	check(fresh->insertValue(adopter, 0, 1, 1), "insert with a request ID below the committed batch");
+
+	// Both sequences survive a reload from the files
+	delete manager;
+	manager = openManager(root / "worker1");
+	check(manager->isCommitted(adopter, 3) && !manager->isCommitted(adopter, 4), "committed batches reloaded");
+	check(manager->getLastRequest(adopter) == 20, "request IDs reloaded");
+
+	delete manager;
+	delete fresh;
+	delete failed;
+	fs::remove_all(root);
+	std::cout << (failures == 0 ? "All checks passed\n" : "Some checks failed\n");
+	return failures;
+}